@@ -0,0 +1,138 @@
+// Benchmark of the scene BVH, built on its own (no window, no GL):
+// g++ -O2 -std=c++17 -Idependencies/include BVHBench.cpp -o BVHBench -lpthread
+// For 10 to 1M random boxes it times the SAH build, the refit after 10% of the objects moved, and
+// batches of sphere, box, frustum and ray queries compared to a linear scan over every object.
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <bvh/BVH.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+
+const unsigned int QUERY_COUNT = 1000;
+
+double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+Bounds randomBox(std::mt19937& rng, float worldSize)
+{
+    std::uniform_real_distribution<float> position(0.0f, worldSize);
+    std::uniform_real_distribution<float> size(0.1f, 1.0f);
+    glm::vec3 center(position(rng), position(rng), position(rng));
+    glm::vec3 half(size(rng), size(rng), size(rng));
+    Bounds b;
+    b.min = center - half;
+    b.max = center + half;
+    b.center = center;
+    b.radius = glm::length(half);
+    return b;
+}
+
+int main()
+{
+    std::cout << std::left << std::setw(10) << "objects" << std::setw(11) << "build ms" << std::setw(11) << "refit ms"
+        << std::setw(12) << "sphere ms" << std::setw(12) << "scan ms" << std::setw(12) << "box ms"
+        << std::setw(12) << "frustum ms" << std::setw(12) << "ray ms" << "nodes" << std::endl;
+
+    for (unsigned int n = 10; n <= 1000000; n *= 10)
+    {
+        std::mt19937 rng(n);
+        // constant density: the world grows with the object count
+        float worldSize = 4.0f * std::cbrt((float)n);
+        std::vector<Bounds> objects(n);
+        BVH bvh;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            objects[i] = randomBox(rng, worldSize);
+            bvh.insert(objects[i]);
+        }
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        bvh.build();
+        double buildTime = millisecondsSince(start);
+
+        // 10% of the objects move by a small amount
+        std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+        for (unsigned int i = 0; i < n; i += 10)
+        {
+            glm::vec3 offset(jitter(rng), jitter(rng), jitter(rng));
+            objects[i].min += offset;
+            objects[i].max += offset;
+            bvh.update(i, objects[i]);
+        }
+        start = std::chrono::high_resolution_clock::now();
+        bvh.refit();
+        double refitTime = millisecondsSince(start);
+
+        std::uniform_real_distribution<float> position(0.0f, worldSize);
+        std::vector<BVHSphere> spheres(QUERY_COUNT);
+        std::vector<BVHBox> boxes(QUERY_COUNT);
+        std::vector<BVHFrustum> frustums(QUERY_COUNT);
+        std::vector<BVHRay> rays(QUERY_COUNT);
+        for (unsigned int q = 0; q < QUERY_COUNT; q++)
+        {
+            glm::vec3 p(position(rng), position(rng), position(rng));
+            spheres[q].center = p;
+            spheres[q].radius = 2.0f;
+            boxes[q].min = p - glm::vec3(2.0f);
+            boxes[q].max = p + glm::vec3(2.0f);
+            glm::vec3 target(position(rng), position(rng), position(rng));
+            glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 20.0f) * glm::lookAt(p, target, glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::mat4 m = glm::transpose(viewProjection);
+            glm::vec4 planes[6] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2] };
+            for (int i = 0; i < 6; i++)
+                frustums[q].planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+            rays[q].origin = p;
+            rays[q].direction = glm::normalize(target - p + glm::vec3(1e-4f));
+            rays[q].maxT = worldSize;
+        }
+
+        std::vector<std::vector<unsigned int> > results;
+        std::vector<std::vector<BVHHit> > hits;
+        start = std::chrono::high_resolution_clock::now();
+        bvh.queryBatch(spheres, results);
+        double sphereTime = millisecondsSince(start);
+
+        // linear scan of the same sphere queries on one thread, the cost every query had before the BVH
+        start = std::chrono::high_resolution_clock::now();
+        unsigned int scanned = 0;
+        unsigned int mismatches = 0;
+        for (unsigned int q = 0; q < QUERY_COUNT; q++)
+        {
+            unsigned int found = 0;
+            for (unsigned int i = 0; i < n; i++)
+            {
+                glm::vec3 d = spheres[q].center - glm::clamp(spheres[q].center, objects[i].min, objects[i].max);
+                found += glm::dot(d, d) <= spheres[q].radius * spheres[q].radius;
+            }
+            scanned += found;
+            mismatches += found != results[q].size();
+        }
+        double scanTime = millisecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        bvh.queryBatch(boxes, results);
+        double boxTime = millisecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        bvh.queryBatch(frustums, results);
+        double frustumTime = millisecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        bvh.queryBatch(rays, hits);
+        double rayTime = millisecondsSince(start);
+
+        std::cout << std::setw(10) << n << std::fixed << std::setprecision(3) << std::setw(11) << buildTime << std::setw(11) << refitTime
+            << std::setw(12) << sphereTime << std::setw(12) << scanTime << std::setw(12) << boxTime
+            << std::setw(12) << frustumTime << std::setw(12) << rayTime << bvh.nodeCount() << std::endl;
+        if (mismatches)
+            std::cout << "BVH sphere query differs from the linear scan on " << mismatches << " queries" << std::endl;
+    }
+    return 0;
+}
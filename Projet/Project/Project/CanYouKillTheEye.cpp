@@ -1,10 +1,12 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "stb_image.h"
+#include <image/stb_image_write.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -13,28 +15,92 @@
 #include <shader/shader_s.h>
 #include <camera/camera.h>
 #include <light/Light.h>
+#include <light/LightSystem.h>
+#include <animation/AnimationSystem.h>
 #include <mesh/mesh.h>
 #include <model/model.h>
+#include <lightmap/LightmapBaker.h>
+#include <sh/SphericalHarmonics.h>
+#include <culling/FrustumCuller.h>
+#include <bvh/BVH.h>
+#include <collision/CollisionWorld.h>
+#include <occlusion/OcclusionQueries.h>
+#include <occlusion/SoftwareOcclusion.h>
+#include <visibility/Portals.h>
+#include <visibility/PVS.h>
+#include <input/InputRecorder.h>
+#include <input/MouseAccumulator.h>
+#include <input/LatencyMonitor.h>
+#include <simulation/FixedTimestep.h>
+#include <render/FramePacket.h>
+#include <render/FramePipeline.h>
+#include <render/GLCounters.h>
+#include <render/FramePacer.h>
+#include <render/DynamicResolution.h>
+#include <render/UploadRing.h>
+#include <render/GLCapture.h>
+#include <jobs/JobSystem.h>
+#include <memory/FrameArena.h>
+#include <profiler/Profiler.h>
 
 #include <iostream>
 #include <list>
+#include <thread>
+#include <algorithm>
+
+// debug builds with FRAME_ALLOCATION_CHECK count the heap allocations of each thread, a frame must make none once
+// warmed up (see FrameAllocationCheck)
+#ifdef FRAME_ALLOCATION_CHECK
+#include <cstdlib>
+
+void* operator new(std::size_t size)
+{
+    heapAllocationCount()++;
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+#endif
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow* window);
-void setupLightSource(Shader lightSourceShader, unsigned int VAO);
-void setupObject(Shader lightObjectShader, glm::vec3 lightPos, glm::vec3 cubePos);
+void processInput(GLFWwindow* window, float dt);
+void simulate(GLFWwindow* window, const Model& eyeModel, glm::vec3 eyePos, float dt);
+void updateEye(glm::vec3 eyePos, int lampIndex);
+void processCursor(double xpos, double ypos);
+void processScroll(double yoffset);
+void processProfilerKeys(GLFWwindow* window);
+void processPacingKeys(GLFWwindow* window);
+void processCaptureKeys(GLFWwindow* window);
+void setupLightSource(Shader& lightSourceShader, unsigned int VAO);
+void setupObject(Shader& lightObjectShader, glm::vec3 lightPos, glm::vec3 cubePos);
 void DrawCube(unsigned int VAO);
-void DrawTerrain(Shader cubeShader, unsigned int VAO, int terrainSize, glm::vec3 rootPos);
-void DrawWall(Shader ObjectShader, glm::vec3 wallPos, glm::mat4 rotation);
-void Draw4Walls(Shader ObjectShader, unsigned int VAO, glm::vec3 wallPos);
-void DrawGround(Shader ObjectShader, unsigned int VAO, glm::vec3 wallPos);
+void DrawTerrain(Shader& cubeShader, unsigned int VAO, int terrainSize, glm::vec3 rootPos);
+void DrawWall(Shader& ObjectShader, unsigned int surface);
+void roomSurfaces(glm::vec3 wallPos, glm::mat4 surfaces[5]);
+void DrawSurface(Shader& ObjectShader, unsigned int VAO, unsigned int surface);
 unsigned int genTextureFromPath(const char* texturePath);
-void setupSkybox(Shader skyboxShader, unsigned int skyboxVAO, unsigned int cubemapTexture);
-unsigned int loadCubemap(std::vector<std::string> faces);
-void DrawEye(Shader eyeShader, Model eyeModel, glm::vec3 eyePos, int lampIndex);
-void DrawObj(Shader eyeShader, Model eyeModel, glm::vec3 eyePos);
+void setupSkybox(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int cubemapTexture);
+unsigned int loadCubemap(std::vector<std::string> faces, SH9* ambient = NULL);
+void DrawObj(Shader& eyeShader, Model& eyeModel, const unsigned char* visible = NULL);
+glm::mat4 objTransform(glm::vec3 objPos);
+glm::mat4 eyeTransform(glm::vec3 eyePos, float angle, float scale);
+Bounds eyeBounds(const Model& eyeModel, glm::vec3 eyePos);
+float eyeScale();
+bool saveFramebuffer(const char* path, int width, int height);
+void reportFrameTimes(std::vector<float>& times);
 
 
 // settings
@@ -43,17 +109,126 @@ const unsigned int SCR_HEIGHT = 720;
 
 // camera
 Camera camera(glm::vec3(5.0f, 0.0f, -3.0f));
-float lastX = SCR_WIDTH / 2.0f;
-float lastY = SCR_HEIGHT / 2.0f;
-bool firstMouse = true;
+// cursor motion summed between two frames, and the time from an input to the end of the frame that used it
+MouseAccumulator mouse;
+LatencyMonitor latency;
+const double LATENCY_REPORT_INTERVAL = 10.0;
+// swap interval and frame limiter: --vsync on|adaptive|off and --fps N, F5 cycles the vsync modes
+FramePacer pacer;
+const double PACING_REPORT_INTERVAL = 10.0;
+// the scene renders at the resolution that holds its GPU time to --gpu-budget ms, then is stretched to the window
+DynamicResolution resolution;
 
 // Lights
-std::vector<Light> lightList;
+LightSystem lights;
+
+// Animation
+AnimationSystem animations(&lights);
+unsigned int spotPulseTrack;
+
+// Lightmap of the static lights on the walls and the ground
+LightmapBaker lightmap;
+const int LIGHTMAP_TEXTURE_UNIT = 1;
+
+// Distance where the corner lights fade out, about the room diagonal
+const float GREEN_LIGHT_RADIUS = 20.0f;
+
+// Image based ambient, scales the spherical harmonics of the active skybox
+const float SH_AMBIENT_STRENGTH = 0.3f;
+
+// frustum culling of the doors, the eye and the room surfaces, rebuilt every frame
+FrustumCuller culler;
+
+// spatial index of the scene objects, for the queries that would otherwise scan every object: its frustum query
+// gives the objects the culler tests
+BVH sceneBVH;
+unsigned int eyeObject;
+// world bounds of the objects of the BVH by id, then per frame the objects in the frustum and their culling result
+std::vector<Bounds> sceneBounds;
+std::vector<unsigned int> frustumCandidates;
+std::vector<unsigned char> sceneVisible;
+
+// walls, ground and doors the camera collides with, and the eye as a dynamic sphere
+CollisionWorld collision;
+unsigned int eyeCollider;
+
+// GPU occlusion queries of the doors and the eye, drawn after the walls that can hide them
+OcclusionQueries occlusion;
+
+// CPU occlusion of the doors and the eye by the walls and the doors, tested before submission
+SoftwareOcclusion softwareOcclusion;
+
+// profiler: F3 toggles the statistics, printed when turned off, F4 a Chrome trace capture written to PROFILE_TRACE_PATH
+const char* PROFILE_TRACE_PATH = "profile.json";
+// draw groups of the GPU profile, by model index of the packets
+const char* RENDER_MODEL_NAMES[] = { "Doors", "Eye" };
+
+// the room and the corridors behind its doors, only the cells seen through open doors are drawn and lit
+PortalSystem portals;
+unsigned int roomCell;
+
+// transient data of the culling, the portal frusta of a frame stay valid during the next one
+DoubleBufferedArena cullingArena;
+
+// precomputed visibility of the static objects and lights from every cell of the room
+PotentiallyVisibleSet pvs;
+const float PVS_CELL_SIZE = 1.0f;
 
 // timing
+// live, recorded or replayed input: --record <file>, --play <file> or --path <file>
+InputRecorder input;
+
+// benchmark without a window: --headless [--frames N] [--scene X] [--output file.png] renders N frames in an offscreen
+// context at a fixed time step, prints the frame times and the GL calls per frame and saves the last frame
+bool headless = false;
+unsigned int headlessFrames = 0;
+std::string headlessOutput = "headless.png";
+// frames of a headless run without --frames nor --scene
+const unsigned int HEADLESS_DEFAULT_FRAMES = 600;
+GLCounters glCounters;
+
+// GL calls of one frame written to GL_CAPTURE_PATH for the GLReplay tool: F6 captures the next frame,
+// --capture-frame N the Nth frame of the run
+const char* GL_CAPTURE_PATH = "frame.gltrace";
+GLCapture glCapture;
+unsigned int captureFrame = 0;
+bool captureRequested = false;
+
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// camera movement, eye tracking and light animation run at a fixed rate, rendering interpolates the last two steps
+FixedTimestep simulation;
+struct SimulationState {
+    glm::vec3 cameraPosition;
+    float eyeAngle;
+    float eyeScale;
+};
+SimulationState simPrevious, simCurrent;
+
+// the main thread simulates and culls frame N + 1 while the render thread, which owns the GL context, submits frame N
+FramePipeline<FramePacket> frames;
+// packet being drawn, only used by the render thread
+FramePacket* renderPacket = NULL;
+// models the draws of a packet refer to
+const unsigned int RENDER_MODEL_DOOR = 0;
+const unsigned int RENDER_MODEL_EYE = 1;
+// uniform blocks of the shaders, written by the render thread in the upload ring (std140 layout)
+UploadRing uploads;
+const GLuint CAMERA_BLOCK_BINDING = 0;
+const GLuint OBJECT_BLOCK_BINDING = 1;
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPos;
+};
+struct ObjectBlock {
+    glm::mat4 model;
+};
+// size of the framebuffer, applied by the render thread
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+
 // lighting
 //glm::vec3 lightPos(1.2f, 1.8f, 2.0f);
 
@@ -68,11 +243,71 @@ float totalAngle = 0.0f;
 float previousAngle = 0.0f;
 
 
-int main()
+int main(int argc, char** argv)
 {
+    bool vsyncOption = false, gpuBudgetOption = false;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--headless") {
+            headless = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cout << "Missing value for option " << option << std::endl;
+            break;
+        }
+        std::string value = argv[++i];
+        if (option == "--record")
+            input.record(value);
+        else if (option == "--play")
+            input.play(value);
+        else if (option == "--path")
+            input.followPath(value);
+        else if (option == "--scene")
+            input.followPath("resources/" + value + ".path");
+        else if (option == "--frames")
+            headlessFrames = (unsigned int)std::max(0, std::atoi(value.c_str()));
+        else if (option == "--output")
+            headlessOutput = value;
+        else if (option == "--vsync") {
+            vsyncOption = true;
+            if (value == "on")
+                pacer.setMode(PACING_VSYNC);
+            else if (value == "adaptive")
+                pacer.setMode(PACING_ADAPTIVE_VSYNC);
+            else if (value == "off")
+                pacer.setMode(PACING_UNCAPPED);
+            else
+                std::cout << "Unknown vsync mode " << value << ", expected on, adaptive or off" << std::endl;
+        }
+        else if (option == "--fps")
+            pacer.setTargetFPS(std::atof(value.c_str()));
+        else if (option == "--capture-frame")
+            captureFrame = (unsigned int)std::max(0, std::atoi(value.c_str()));
+        else if (option == "--gpu-budget") {
+            gpuBudgetOption = true;
+            resolution.setTargetTime(std::atof(value.c_str()));
+        }
+        else
+            std::cout << "Unknown option " << option << std::endl;
+    }
+    // a camera path ends the run by itself
+    if (headless && headlessFrames == 0 && !input.isReplaying())
+        headlessFrames = HEADLESS_DEFAULT_FRAMES;
+    // a benchmark measures the renderer, not the display
+    if (headless && !vsyncOption)
+        pacer.setMode(PACING_UNCAPPED);
+    // and renders the same pixels on every machine
+    if (headless && !gpuBudgetOption)
+        resolution.setTargetTime(0.0);
+
     // glfw: initialize and configure
     // ------------------------------
-    glfwInit();
+    if (!glfwInit())
+    {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -83,7 +318,20 @@ int main()
 
     // glfw window creation
     // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Can You Kill The EYE ?", NULL, NULL);
+    GLFWwindow* window = NULL;
+    if (headless) {
+        // an invisible window whose context renders in memory with Mesa (llvmpipe), no display nor GPU is needed
+        // when GLFW is built for the null platform with OSMesa. EGL is tried next for the drivers without it.
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Can You Kill The EYE ?", NULL, NULL);
+        if (window == NULL) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+            window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Can You Kill The EYE ?", NULL, NULL);
+        }
+    }
+    else
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Can You Kill The EYE ?", NULL, NULL);
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -92,11 +340,17 @@ int main()
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    // the projection follows the framebuffer, which can differ from the window size on high DPI displays
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    camera.SetViewport(framebufferWidth, framebufferHeight);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
 
     // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!headless) {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        MouseAccumulator::enableRawMotion(window);
+    }
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
@@ -105,6 +359,14 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    latency.init();
+    pacer.init();
+    // the jobs making GL calls run on the thread of the context
+    JobSystem::instance().bindGLThread();
+    // every job is a range of the profile
+    Profiler::instance().setThreadName("Main");
+    JobHooks profilerHooks = { Profiler::jobBegin, Profiler::jobEnd, &Profiler::instance() };
+    JobSystem::instance().setHooks(profilerHooks);
 
     // configure global opengl state
     // -----------------------------
@@ -117,6 +379,8 @@ int main()
     Shader wallShader("Wall.vert", "Wall.frag");
     Shader skyboxShader("skybox.vert", "skybox.frag");
     Shader modelShader("model.vert", "model.frag");
+    Shader occlusionShader("OcclusionProxy.vert", "OcclusionProxy.frag");
+    Shader upscaleShader("Upscale.vert", "Upscale.frag");
 
     brickTexture = genTextureFromPath("texture/brick.jpg");
     earthTexture = genTextureFromPath("texture/earth.jpg");
@@ -178,13 +442,13 @@ int main()
     };
 
     float wallVertices[] = {
-        //Position           Normal              TextureCoord
-        0.5f, 0.5f, 0.0f,    0.0f, 0.0f, -1.0f,   5.0f, 3.0f,
-        0.5f, -0.5f, 0.0f,   0.0f, 0.0f, -1.0f,   5.0f, 0.0f,
-        -0.5f, -0.5f, 0.0f,  0.0f, 0.0f, -1.0f,   0.0f, 0.0f,
-        0.5f, 0.5f, 0.0f,    0.0f, 0.0f, -1.0f,   5.0f, 3.0f,
-        -0.5f, -0.5f, 0.0f,  0.0f, 0.0f, -1.0f,   0.0f, 0.0f,
-        -0.5f, 0.5f, 0.0f,   0.0f, 0.0f, -1.0f,   0.0f, 3.0f
+        //Position           Normal              TextureCoord  Lightmap
+        0.5f, 0.5f, 0.0f,    0.0f, 0.0f, -1.0f,   5.0f, 3.0f,   1.0f, 1.0f,
+        0.5f, -0.5f, 0.0f,   0.0f, 0.0f, -1.0f,   5.0f, 0.0f,   1.0f, 0.0f,
+        -0.5f, -0.5f, 0.0f,  0.0f, 0.0f, -1.0f,   0.0f, 0.0f,   0.0f, 0.0f,
+        0.5f, 0.5f, 0.0f,    0.0f, 0.0f, -1.0f,   5.0f, 3.0f,   1.0f, 1.0f,
+        -0.5f, -0.5f, 0.0f,  0.0f, 0.0f, -1.0f,   0.0f, 0.0f,   0.0f, 0.0f,
+        -0.5f, 0.5f, 0.0f,   0.0f, 0.0f, -1.0f,   0.0f, 3.0f,   0.0f, 1.0f
     };
 
     float skyboxVertices[] = {
@@ -273,12 +537,14 @@ int main()
     glBindBuffer(GL_ARRAY_BUFFER, wallVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(wallVertices), wallVertices, GL_STATIC_DRAW);    
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(8 * sizeof(float)));
+    glEnableVertexAttribArray(3);
 
     // skybox VAO
     unsigned int skyboxVAO, skyboxVBO;
@@ -302,7 +568,8 @@ int main()
         "skybox/day/front.jpg",
         "skybox/day/back.jpg"
     };
-    unsigned int cubemapTexture = loadCubemap(faces);
+    SH9 dayAmbient;
+    unsigned int cubemapTexture = loadCubemap(faces, &dayAmbient);
 
     std::vector<std::string> facesNight1
     {
@@ -313,7 +580,8 @@ int main()
         "skybox/nightskybox1/front.jpg",
         "skybox/nightskybox1/back.jpg"
     };
-    unsigned int cubemapTextureNight1 = loadCubemap(facesNight1);
+    SH9 night1Ambient;
+    unsigned int cubemapTextureNight1 = loadCubemap(facesNight1, &night1Ambient);
 
     std::vector<std::string> facesNight2
     {
@@ -324,114 +592,645 @@ int main()
         "skybox/nightskybox2/front.jpg",
         "skybox/nightskybox2/back.jpg"
     };
-    unsigned int cubemapTextureNight2 = loadCubemap(facesNight2);
+    SH9 night2Ambient;
+    unsigned int cubemapTextureNight2 = loadCubemap(facesNight2, &night2Ambient);
+
+    // ambient of the walls comes from the skybox drawn below
+    wallShader.use();
+    night2Ambient.upload(wallShader, "shAmbient");
+    wallShader.setFloat("ambientStrength", SH_AMBIENT_STRENGTH);
 
     
     //Light MainLamp = Light::Light(glm::vec3(7.5, 1.0, -2.5), glm::vec3(1.0,1.0,1.0), 3, 2);
     //lightList.push_back(MainLamp);
 
     Light GreenLight1 = Light::Light(glm::vec3(-0.5, 1.2, 0.5), glm::vec3(0.2, 0.6, 0.1), 1, 3);
-    lightList.push_back(GreenLight1);
+    GreenLight1.setRadius(GREEN_LIGHT_RADIUS);
+    GreenLight1.setStatic(true);
+    lights.add(GreenLight1);
 
     Light GreenLight2 = Light::Light(glm::vec3(-0.5, 1.2, -14.5), glm::vec3(0.2, 0.6, 0.1), 1, 3);
-    lightList.push_back(GreenLight2);
+    GreenLight2.setRadius(GREEN_LIGHT_RADIUS);
+    GreenLight2.setStatic(true);
+    lights.add(GreenLight2);
 
     Light GreenLight3 = Light::Light(glm::vec3(14.5, 1.2, -14.5), glm::vec3(0.2, 0.6, 0.1), 1, 3);
-    lightList.push_back(GreenLight3);
+    GreenLight3.setRadius(GREEN_LIGHT_RADIUS);
+    GreenLight3.setStatic(true);
+    lights.add(GreenLight3);
 
     Light GreenLight4 = Light::Light(glm::vec3(14.5, 1.2, 0.5), glm::vec3(0.2, 0.6, 0.1), 1, 3);
-    lightList.push_back(GreenLight4);
+    GreenLight4.setRadius(GREEN_LIGHT_RADIUS);
+    GreenLight4.setStatic(true);
+    lights.add(GreenLight4);
 
     Light eyeLamp = Light::Light(glm::vec3(7.5, -0.3, -7), glm::vec3(1.0, 0.0, 0.0), 10, 2, glm::vec3(0.0,0.0,-1.0), 10, 7, true);
-    lightList.push_back(eyeLamp);
+    eyeLamp.setRadius(12.0f);
+    lights.add(eyeLamp);
 
     Light SpotLight = Light::Light(glm::vec3(7.5, 4.0f, -7.0), glm::vec3(1.0, 1.0, 1.0), 2.0, 5, glm::vec3(0.0, -1.0, -0.4), 40.0f, 50.0f, true);
-    lightList.push_back(SpotLight);
+    SpotLight.setRadius(15.0f);
+    SpotLight.setStatic(true);
+    lights.add(SpotLight);
+
+    // the main spotlight pulses with |sin(t)|
+    spotPulseTrack = animations.addProcedural(ANIM_ABS_SINE, 1.0f, 1.0f, 0.0f, 0.0f);
+    animations.bindLight(spotPulseTrack, 5, ANIM_LIGHT_STRENGTH);
+
+    // bake the static lights on the walls and the ground, the doors cast shadows
+    glm::mat4 surfaces[5];
+    roomSurfaces(cubePos, surfaces);
+    for (int i = 0; i < 5; i++)
+        lightmap.addSurface(surfaces[i]);
+    glm::vec3 doorPos[] = { glm::vec3(2.5f, -1.5f, -14.5f), glm::vec3(10.5f, -1.5f, -14.5f) };
+    for (int d = 0; d < 2; d++)
+        for (unsigned int i = 0; i < door.meshes.size(); i++)
+            lightmap.addOccluderMesh(door.meshes[i].vertices, door.meshes[i].indices, objTransform(doorPos[d]));
+    lights.update();
+    lightmap.bake(lights, "resources/room.lmap");
+
+    // local bounds of the unit quad the walls and the ground are drawn with
+    glm::vec3 quadCorners[] = { glm::vec3(-0.5f, -0.5f, 0.0f), glm::vec3(0.5f, 0.5f, 0.0f) };
+    Bounds quadBounds = computeBounds(quadCorners, 2);
+    glm::vec3 eyePos = glm::vec3(7.5f, -0.5f, -7.0f);
+
+    // the doors, the eye and the room surfaces in the scene BVH, only the eye moves afterwards
+    auto addSceneObject = [](const Bounds& bounds) {
+        unsigned int id = sceneBVH.insert(bounds);
+        if (id >= sceneBounds.size())
+            sceneBounds.resize(id + 1);
+        sceneBounds[id] = bounds;
+        return id;
+    };
+    // the meshes of a door have consecutive ids
+    unsigned int doorObject[2], surfaceObject = 0;
+    for (int d = 0; d < 2; d++)
+        for (unsigned int i = 0; i < door.meshes.size(); i++) {
+            unsigned int id = addSceneObject(transformBounds(door.meshes[i].bounds, objTransform(doorPos[d])));
+            if (i == 0)
+                doorObject[d] = id;
+        }
+    eyeObject = addSceneObject(eyeBounds(eyeModel, eyePos));
+    for (int i = 0; i < 5; i++) {
+        unsigned int id = addSceneObject(transformBounds(quadBounds, surfaces[i]));
+        if (i == 0)
+            surfaceObject = id;
+    }
+    sceneBVH.build();
+    frustumCandidates.reserve(sceneBounds.size());
+    sceneVisible.assign(sceneBounds.size(), 0);
+    culler.reserve((unsigned int)sceneBounds.size());
+
+    for (int i = 0; i < 5; i++)
+        collision.addQuad(surfaces[i]);
+    for (int d = 0; d < 2; d++)
+        for (unsigned int i = 0; i < door.meshes.size(); i++)
+            collision.addMesh(door.meshes[i].vertices, door.meshes[i].indices, objTransform(doorPos[d]));
+    eyeCollider = collision.addDynamic(eyeBounds(eyeModel, eyePos));
+    camera.World = &collision;
+
+    occlusion.init(occlusionShader);
+    unsigned int doorOcclusion[2];
+    Bounds doorWorld[2];
+    for (int d = 0; d < 2; d++) {
+        doorOcclusion[d] = occlusion.add();
+        for (unsigned int i = 0; i < door.meshes.size(); i++) {
+            Bounds b = transformBounds(door.meshes[i].bounds, objTransform(doorPos[d]));
+            doorWorld[d].min = i == 0 ? b.min : glm::min(doorWorld[d].min, b.min);
+            doorWorld[d].max = i == 0 ? b.max : glm::max(doorWorld[d].max, b.max);
+        }
+        doorWorld[d].center = (doorWorld[d].min + doorWorld[d].max) * 0.5f;
+        doorWorld[d].radius = glm::length(doorWorld[d].max - doorWorld[d].center);
+    }
+    unsigned int eyeOcclusion = occlusion.add();
+
+    for (int i = 0; i < 4; i++)
+        softwareOcclusion.addOccluderQuad(surfaces[i]);
+    for (int d = 0; d < 2; d++)
+        softwareOcclusion.addOccluderBox(doorWorld[d]);
+
+    // each door is a portal in the back wall to a corridor, closed while the door is
+    roomCell = portals.addCell(glm::vec3(-0.5f, -1.5f, -14.5f), glm::vec3(14.5f, 2.5f, 0.5f));
+    for (int d = 0; d < 2; d++) {
+        unsigned int corridor = portals.addCell(glm::vec3(doorPos[d].x - 1.5f, -1.5f, -24.5f), glm::vec3(doorPos[d].x + 1.5f, 2.5f, -14.5f));
+        glm::vec3 corners[4] = {
+            glm::vec3(doorWorld[d].min.x, doorWorld[d].min.y, -14.5f),
+            glm::vec3(doorWorld[d].max.x, doorWorld[d].min.y, -14.5f),
+            glm::vec3(doorWorld[d].max.x, doorWorld[d].max.y, -14.5f),
+            glm::vec3(doorWorld[d].min.x, doorWorld[d].max.y, -14.5f)
+        };
+        portals.addPortal(roomCell, corridor, corners, false);
+    }
 
+    // targets: the doors, the eye at its largest, the room surfaces, then the influence box of every light
+    pvs.setLevel(glm::vec3(-0.5f, -1.5f, -14.5f), glm::vec3(14.5f, 2.5f, 0.5f), PVS_CELL_SIZE);
+    for (int i = 0; i < 4; i++)
+        pvs.addOccluderQuad(surfaces[i]);
+    for (int d = 0; d < 2; d++)
+        for (unsigned int i = 0; i < door.meshes.size(); i++)
+            pvs.addOccluderMesh(door.meshes[i].vertices, door.meshes[i].indices, objTransform(doorPos[d]));
+    unsigned int doorTarget[2];
+    for (int d = 0; d < 2; d++)
+        doorTarget[d] = pvs.addTarget(doorWorld[d]);
+    unsigned int eyeTarget = pvs.addTarget(eyeBounds(eyeModel, eyePos));
+    unsigned int surfaceTarget = 0;
+    for (int i = 0; i < 5; i++) {
+        unsigned int target = pvs.addTarget(transformBounds(quadBounds, surfaces[i]));
+        if (i == 0)
+            surfaceTarget = target;
+    }
+    unsigned int lightTarget = pvs.targetCount();
+    for (unsigned int i = 0; i < lights.size(); i++) {
+        LightSphere sphere = lights.boundingSphere(i);
+        pvs.addTarget(sphere.center - glm::vec3(sphere.radius), sphere.center + glm::vec3(sphere.radius));
+    }
+    pvs.bake("resources/room.pvs");
+
+    simCurrent.cameraPosition = camera.Position;
+    simCurrent.eyeAngle = previousAngle;
+    simCurrent.eyeScale = eyeScale();
+    simPrevious = simCurrent;
+
+    // render thread
+    // -------------
+    // the context moves to the render thread, every GL call of the frames is made there
+    glfwMakeContextCurrent(NULL);
+    std::thread renderThread([&]() {
+        glfwMakeContextCurrent(window);
+        JobSystem::instance().bindGLThread();
+        Profiler::instance().setThreadName("Render");
+        Model* models[] = { &door, &eyeModel };
+        // glfwSwapInterval applies to the context of the calling thread
+        int swapInterval = 0;
+        bool swapIntervalSet = false;
+        double lastReport = glfwGetTime();
+        FrameAllocationCheck renderAllocations("render");
+        // time between the swaps of the headless frames
+        std::vector<float> frameTimes;
+        double lastSwap = glfwGetTime();
+        resolution.init();
+        uploads.init();
+        // blocks of the draws of a packet, in the order of the draw list: at most the 5 surfaces, the 2 doors and the eye
+        std::vector<UploadRange> drawBlocks;
+        drawBlocks.reserve(5 + 2 + 1);
+        if (headless) {
+            frameTimes.reserve(headlessFrames);
+            glCounters.install();
+        }
+        while ((renderPacket = frames.beginRead()) != NULL) {
+            const FramePacket& packet = *renderPacket;
+            // uploads left by loaders running on other threads
+            JobSystem::instance().runGLJobs();
+            renderAllocations.beginFrame();
+            // the trace starts after the uploads of the loaders and ends with the frame drawn, before the swap
+            if (packet.capture && glCapture.begin(GL_CAPTURE_PATH, packet.framebufferWidth, packet.framebufferHeight))
+                renderAllocations.skipFrame();
+            if (Profiler::instance().isEnabled())
+                renderAllocations.skipFrame();
+            ProfileScope renderScope("Render");
+            Profiler::instance().gpuBeginFrame();
+            GpuProfileScope gpuFrame("Frame");
+            // the scene goes to the offscreen target, which also sets the viewport
+            resolution.begin(packet.framebufferWidth, packet.framebufferHeight);
+            if (!swapIntervalSet || packet.swapInterval != swapInterval) {
+                swapInterval = packet.swapInterval;
+                swapIntervalSet = true;
+                glfwSwapInterval(swapInterval);
+            }
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // the data of the frame and of each draw is written before the first draw, the blocks are then bound
+            uploads.beginFrame();
+            CameraBlock cameraBlock = { packet.projection, packet.view, glm::vec4(packet.viewPos, 1.0f) };
+            UploadRange cameraRange = uploads.push(&cameraBlock, sizeof(cameraBlock));
+            drawBlocks.resize(packet.draws.size());
+            for (unsigned int i = 0; i < packet.draws.size(); i++) {
+                ObjectBlock objectBlock = { packet.draws[i].model };
+                drawBlocks[i] = uploads.push(&objectBlock, sizeof(objectBlock));
+            }
+            uploads.endWrites();
+            uploads.bind(CAMERA_BLOCK_BINDING, cameraRange);
+
+            // Draw the lamp object
+            setupLightSource(lightCubeShader, lightCubeVAO);
+
+            // the surfaces and the models share the wall shader, its light arrays are sent once per frame
+            wallShader.use();
+            renderPacket->lights.upload(wallShader);
+
+            // Draw Walls and Ground
+            {
+                GpuProfileScope gpuPass("Surfaces");
+                for (unsigned int i = 0; i < packet.draws.size(); i++) {
+                    const PacketDraw& draw = packet.draws[i];
+                    if (draw.kind != PACKET_SURFACE)
+                        continue;
+                    glBindTexture(GL_TEXTURE_2D, draw.texture);
+                    uploads.bind(OBJECT_BLOCK_BINDING, drawBlocks[i]);
+                    DrawSurface(wallShader, wallVAO, draw.index);
+                }
+            }
+
+            // the doors and the eye go through the occlusion queries, after the walls filled the depth buffer
+            {
+                GpuProfileScope gpuPass("Models");
+                occlusion.beginFrame();
+                occlusionShader.use();
+                for (unsigned int i = 0; i < packet.draws.size(); i++) {
+                    const PacketDraw& draw = packet.draws[i];
+                    if (draw.kind != PACKET_MODEL)
+                        continue;
+                    GpuProfileScope gpuGroup(RENDER_MODEL_NAMES[draw.index]);
+                    occlusion.draw(draw.occlusion, draw.bounds, packet.viewPos, [&]() {
+                        if (!draw.visible)
+                            return;
+                        uploads.bind(OBJECT_BLOCK_BINDING, drawBlocks[i]);
+                        DrawObj(wallShader, *models[draw.index], &packet.meshVisible[draw.meshFirst]);
+                    });
+                }
+            }
+
+            // Draw skybox
+            {
+                GpuProfileScope gpuPass("Skybox");
+                setupSkybox(skyboxShader, skyboxVAO, cubemapTextureNight2);
+            }
+            uploads.endFrame();
+
+            // scene to the window
+            {
+                GpuProfileScope gpuPass("Upscale");
+                resolution.present(upscaleShader);
+            }
+            glCapture.end();
+
+            renderAllocations.endFrame();
+            if (packet.screenshot)
+                saveFramebuffer(headlessOutput.c_str(), packet.framebufferWidth, packet.framebufferHeight);
+            renderScope.next("Swap");
+            glfwSwapBuffers(window);
+            latency.endFrame(packet.inputTime);
+            if (headless) {
+                glCounters.endFrame();
+                double swap = glfwGetTime();
+                frameTimes.push_back((float)(swap - lastSwap));
+                lastSwap = swap;
+            }
+            frames.endRead();
+            if (glfwGetTime() - lastReport > LATENCY_REPORT_INTERVAL) {
+                latency.report();
+                resolution.report();
+                lastReport = glfwGetTime();
+            }
+        }
+        renderPacket = NULL;
+        latency.report();
+        latency.release();
+        occlusion.release();
+        resolution.report();
+        resolution.release();
+        uploads.report();
+        uploads.release();
+        if (headless) {
+            glCounters.uninstall();
+            reportFrameTimes(frameTimes);
+            glCounters.report();
+        }
+        Profiler::instance().releaseGpu();
+        glfwMakeContextCurrent(NULL);
+    });
 
     // render loop
     // -----------
+    // the recorder keeps its history outside of the checked part of the frame
+    FrameAllocationCheck simulationAllocations("simulation");
+    unsigned int frameCount = 0;
+    double lastPacingReport = glfwGetTime();
     while (!glfwWindowShouldClose(window))
     {
         // per-frame time logic
         // --------------------
+        // the limiter waits before the input is sampled, so the frame uses the most recent input
+        pacer.wait();
+        if (glfwGetTime() - lastPacingReport > PACING_REPORT_INTERVAL) {
+            pacer.report();
+            lastPacingReport = glfwGetTime();
+        }
+        Profiler::instance().beginFrame();
+        ProfileScope frameScope("Frame");
+        ProfileScope section("Input");
         float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
+        deltaTime = input.beginFrame(currentFrame - lastFrame);
         lastFrame = currentFrame;
+        // a headless run simulates the same frames whatever the speed of the machine
+        if (headless && !input.isReplaying())
+            deltaTime = SIMULATION_STEP;
 
         // input
         // -----
-        processInput(window);
-
-        // render
-        // ------
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // Draw the lamp object
-        setupLightSource(lightCubeShader, lightCubeVAO);
-
-        
-
-        // Draw Terrain
-        //DrawTerrain(lightingShader, cubeVAO, 15, cubePos);
-        /*
-        wallShader.use();
-        // render the loaded model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(7.5f, -0.5f, -7.0f));
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-        model = glm::rotate(model, 30 * glm::radians((float)glfwGetTime()), glm::vec3(0.0, 1.0, 0.0));
-        wallShader.setMat4("model", model);
-        eyeModel.Draw(wallShader);
-        */
-        //Door1
-        DrawObj(wallShader, door, glm::vec3(2.5f, -1.5f, -14.5f));
-        DrawObj(wallShader, door, glm::vec3(10.5f, -1.5f, -14.5f));
-
-        DrawEye(wallShader, eyeModel, glm::vec3(7.5f, -0.5f, -7.0f), 4);
-
-        // Draw Walls
-        glBindTexture(GL_TEXTURE_2D, 1);
-        Draw4Walls(wallShader, wallVAO, cubePos);
-
-        // Draw Ground
-        glBindTexture(GL_TEXTURE_2D, 4);
-        DrawGround(wallShader, wallVAO, cubePos);   
-
-        // Draw skybox
-        setupSkybox(skyboxShader, skyboxVAO, cubemapTextureNight2);
-
-        
-
-        glfwSwapBuffers(window);
+        // sampled as late as possible: right before the simulation and the camera use it
         glfwPollEvents();
+        const std::vector<InputEvent>& events = input.frameEvents();
+        for (unsigned int i = 0; i < events.size(); i++) {
+            if (events[i].type == INPUT_CURSOR)
+                processCursor(events[i].x, events[i].y);
+            else
+                processScroll(events[i].y);
+        }
+        float xoffset, yoffset;
+        double inputTime;
+        if (mouse.consume(xoffset, yoffset, inputTime))
+            camera.ProcessMouseMovement(xoffset, yoffset);
+        if (input.getMode() == INPUT_PATH) {
+            float yaw, pitch;
+            input.samplePath(simCurrent.cameraPosition, yaw, pitch);
+            simPrevious.cameraPosition = simCurrent.cameraPosition;
+            camera.SetOrientation(yaw, pitch);
+        }
+        processInput(window, 0.0f);
+        processProfilerKeys(window);
+        processPacingKeys(window);
+        processCaptureKeys(window);
+        simulationAllocations.beginFrame();
+        // the profiler keeps its statistics and traces on the heap, the frames it measures are not checked
+        if (Profiler::instance().isEnabled())
+            simulationAllocations.skipFrame();
+
+        // simulation
+        // ----------
+        section.next("Simulation");
+        // the camera holds the simulated position while stepping and the interpolated one while rendering
+        camera.Position = simCurrent.cameraPosition;
+        unsigned int steps = simulation.advance(deltaTime);
+        for (unsigned int i = 0; i < steps; i++) {
+            simPrevious = simCurrent;
+            simulate(window, eyeModel, eyePos, simulation.step);
+        }
+        float alpha = simulation.alpha();
+        camera.Position = glm::mix(simPrevious.cameraPosition, simCurrent.cameraPosition, alpha);
+        // shortest way between the two angles, atan2 wraps around
+        float eyeTurn = simCurrent.eyeAngle - simPrevious.eyeAngle;
+        eyeTurn -= glm::two_pi<float>() * std::floor(eyeTurn / glm::two_pi<float>() + 0.5f);
+        float eyeAngle = simPrevious.eyeAngle + eyeTurn * alpha;
+        float eyeRenderScale = glm::mix(simPrevious.eyeScale, simCurrent.eyeScale, alpha);
+        Bounds eye = eyeBounds(eyeModel, eyePos);
+
+        // culling
+        // -------
+        section.next("Culling");
+        FrameArena& frameArena = cullingArena.beginFrame();
+        camera.Update();
+        // the BVH skips the subtrees outside the frustum, the culler then tests the spheres and boxes of what is left
+        sceneBounds[eyeObject] = eye;
+        BVHFrustum frustum;
+        for (int p = 0; p < 6; p++)
+            frustum.planes[p] = camera.FrustumPlanes[p];
+        sceneBVH.query(frustum, frustumCandidates);
+        culler.begin();
+        for (unsigned int i = 0; i < frustumCandidates.size(); i++)
+            culler.add(sceneBounds[frustumCandidates[i]]);
+        culler.cull(camera.FrustumPlanes);
+        std::fill(sceneVisible.begin(), sceneVisible.end(), (unsigned char)0);
+        for (unsigned int i = 0; i < frustumCandidates.size(); i++)
+            sceneVisible[frustumCandidates[i]] = culler.isVisible(i) ? 1 : 0;
+
+        // cells reachable through the open portals, lights that reach none of them or that the PVS of the camera
+        // cell excludes are switched off
+        const uint64_t* pvsSet = pvs.lookup(camera.Position);
+        portals.update(camera.Position, camera.FrustumPlanes, &frameArena);
+        for (unsigned int i = 0; i < lights.size(); i++) {
+            LightSphere sphere = lights.boundingSphere(i);
+            lights.setActive(i, !lights.isBounded(i) || (PotentiallyVisibleSet::isVisible(pvsSet, lightTarget + i)
+                && portals.touchesVisibleCell(sphere.center, sphere.radius)));
+        }
+        bool roomVisible = portals.isCellVisible(roomCell);
+        unsigned char surfaceVisible[5];
+        for (int i = 0; i < 5; i++)
+            surfaceVisible[i] = sceneVisible[surfaceObject + i] && PotentiallyVisibleSet::isVisible(pvsSet, surfaceTarget + i);
+
+        softwareOcclusion.render(camera.GetViewProjectionMatrix());
+        bool doorVisible[2];
+        for (int d = 0; d < 2; d++) {
+            bool doorInFrustum = false;
+            for (unsigned int i = 0; i < door.meshes.size(); i++)
+                doorInFrustum = doorInFrustum || sceneVisible[doorObject[d] + i];
+            doorVisible[d] = PotentiallyVisibleSet::isVisible(pvsSet, doorTarget[d]) && doorInFrustum
+                && portals.isSphereVisible(roomCell, doorWorld[d].center, doorWorld[d].radius)
+                && !softwareOcclusion.isOccluded(doorWorld[d], camera.GetViewProjectionMatrix());
+        }
+        bool eyeVisible = PotentiallyVisibleSet::isVisible(pvsSet, eyeTarget) && sceneVisible[eyeObject] && portals.isSphereVisible(roomCell, eye.center, eye.radius)
+            && !softwareOcclusion.isOccluded(eye, camera.GetViewProjectionMatrix());
+
+        // frame packet
+        // ------------
+        section.next("Frame packet");
+        // everything the render thread needs is copied, the simulation can go on with the next frame
+        FramePacket* packet = frames.beginWrite();
+        if (!packet)
+            break;
+        packet->clear();
+        packet->view = camera.GetViewMatrix();
+        packet->projection = camera.GetProjectionMatrix();
+        packet->viewPos = camera.Position;
+        packet->framebufferWidth = framebufferWidth;
+        packet->framebufferHeight = framebufferHeight;
+        packet->inputTime = inputTime;
+        packet->swapInterval = pacer.swapInterval();
+        frameCount++;
+        packet->capture = captureRequested || frameCount == captureFrame;
+        captureRequested = false;
+        if (headless && frameCount == headlessFrames)
+            glfwSetWindowShouldClose(window, true);
+        // the last frame of a headless run, ended by its frame count or by its camera path
+        packet->screenshot = headless && glfwWindowShouldClose(window);
+        lights.update();
+        packet->lights.assign(lights);
+
+        if (roomVisible) {
+            for (unsigned int i = 0; i < 5; i++) {
+                if (!surfaceVisible[i])
+                    continue;
+                PacketDraw draw = {};
+                draw.kind = PACKET_SURFACE;
+                draw.index = i;
+                draw.texture = i < 4 ? 1 : 4;
+                draw.model = surfaces[i];
+                packet->draws.push_back(draw);
+            }
+        }
+        for (int d = 0; d < 2; d++) {
+            if (!doorVisible[d])
+                continue;
+            PacketDraw draw = {};
+            draw.kind = PACKET_MODEL;
+            draw.index = RENDER_MODEL_DOOR;
+            draw.model = objTransform(doorPos[d]);
+            draw.bounds = doorWorld[d];
+            draw.occlusion = doorOcclusion[d];
+            draw.meshFirst = (unsigned int)packet->meshVisible.size();
+            draw.visible = true;
+            const unsigned char* meshVisible = &sceneVisible[doorObject[d]];
+            packet->meshVisible.insert(packet->meshVisible.end(), meshVisible, meshVisible + door.meshes.size());
+            packet->draws.push_back(draw);
+        }
+        // the eye logic runs in the simulation, only its draw calls are conditional
+        if (totalAngle <= 4 * glm::radians(360.0f)) {
+            PacketDraw draw = {};
+            draw.kind = PACKET_MODEL;
+            draw.index = RENDER_MODEL_EYE;
+            draw.model = eyeTransform(eyePos, eyeAngle, eyeRenderScale);
+            draw.bounds = eye;
+            draw.occlusion = eyeOcclusion;
+            draw.meshFirst = (unsigned int)packet->meshVisible.size();
+            draw.visible = eyeVisible;
+            packet->meshVisible.insert(packet->meshVisible.end(), eyeModel.meshes.size(), (unsigned char)1);
+            packet->draws.push_back(draw);
+        }
+        simulationAllocations.endFrame();
+        frames.endWrite();
+        input.endFrame();
     }
+    frames.close();
+    renderThread.join();
+    glfwMakeContextCurrent(window);
+    JobSystem::instance().bindGLThread();
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &lightCubeVAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &wallVAO);
 
 
+    input.close();
+    pacer.report();
+    if (Profiler::instance().isCapturing())
+        Profiler::instance().stopCapture(PROFILE_TRACE_PATH);
+    if (Profiler::instance().isEnabled())
+        Profiler::instance().report();
+    JobSystem::instance().shutdown();
     glfwTerminate();
     return 0;
 }
 
+// one fixed step of the simulation: camera movement, eye tracking, light animation and the eye collider
+void simulate(GLFWwindow* window, const Model& eyeModel, glm::vec3 eyePos, float dt)
+{
+    processInput(window, dt);
+    updateEye(eyePos, 4);
+    animations.evaluate(simulation.time());
+
+    // the eye shrinks or grows as the camera turns around it, refit only moves the nodes above it
+    Bounds eye = eyeBounds(eyeModel, eyePos);
+    sceneBVH.update(eyeObject, eye);
+    sceneBVH.refit();
+    collision.updateDynamic(eyeCollider, eye);
+
+    simCurrent.cameraPosition = camera.Position;
+    simCurrent.eyeAngle = previousAngle;
+    simCurrent.eyeScale = eyeScale();
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// dt is the time the movement keys apply to, 0 only checks the window keys
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow* window)
+void processInput(GLFWwindow* window, float dt)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+    // a replay ends by itself after its last frame
+    if (input.finished())
+        glfwSetWindowShouldClose(window, true);
+
+    if (dt <= 0.0f)
+        return;
+
+    // movement keys go through the recorder so a playback sees the recorded state
+    if (input.keyDown(window, GLFW_KEY_W))
+        camera.ProcessKeyboard(FORWARD, dt);
+    if (input.keyDown(window, GLFW_KEY_S))
+        camera.ProcessKeyboard(BACKWARD, dt);
+    if (input.keyDown(window, GLFW_KEY_A))
+        camera.ProcessKeyboard(LEFT, dt);
+    if (input.keyDown(window, GLFW_KEY_D))
+        camera.ProcessKeyboard(RIGHT, dt);
+}
+
+// writes the back buffer to a PNG, from the thread that owns the context
+bool saveFramebuffer(const char* path, int width, int height)
+{
+    std::vector<unsigned char> pixels(width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+    // GL rows go up from the bottom, PNG rows down from the top
+    for (int y = 0; y < height / 2; y++)
+        std::swap_ranges(pixels.begin() + y * width * 3, pixels.begin() + (y + 1) * width * 3,
+            pixels.begin() + (height - 1 - y) * width * 3);
+    if (!stbi_write_png(path, width, height, 3, &pixels[0], width * 3))
+    {
+        std::cout << "Failed to write " << path << std::endl;
+        return false;
+    }
+    std::cout << "Saved the last frame to " << path << std::endl;
+    return true;
+}
+
+// percentiles of the frame times of a headless run
+void reportFrameTimes(std::vector<float>& times)
+{
+    if (times.empty())
+        return;
+    std::sort(times.begin(), times.end());
+    double total = 0.0;
+    for (unsigned int i = 0; i < times.size(); i++)
+        total += times[i];
+    unsigned int last = (unsigned int)times.size() - 1;
+    std::cout << "Rendered " << times.size() << " frames: average " << 1000.0 * total / times.size()
+        << " ms, 50th percentile " << 1000.0f * times[last / 2] << " ms, 95th percentile " << 1000.0f * times[last * 95 / 100]
+        << " ms, 99th percentile " << 1000.0f * times[last * 99 / 100] << " ms, max " << 1000.0f * times[last] << " ms" << std::endl;
+}
+
+// F3 and F4 act when pressed, not while held
+void processProfilerKeys(GLFWwindow* window)
+{
+    static bool statisticsHeld = false, captureHeld = false;
+    Profiler& profiler = Profiler::instance();
+    bool statistics = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+    if (statistics && !statisticsHeld) {
+        profiler.setEnabled(!profiler.isEnabled());
+        if (!profiler.isEnabled())
+            profiler.report();
+    }
+    statisticsHeld = statistics;
+    bool capture = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+    if (capture && !captureHeld) {
+        if (profiler.isCapturing())
+            profiler.stopCapture(PROFILE_TRACE_PATH);
+        else
+            profiler.startCapture();
+    }
+    captureHeld = capture;
+}
+
+// F5 cycles vsync, adaptive vsync and uncapped
+void processPacingKeys(GLFWwindow* window)
+{
+    static bool modeHeld = false;
+    bool mode = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+    if (mode && !modeHeld)
+        pacer.nextMode();
+    modeHeld = mode;
+}
+
+// F6 captures the GL calls of the next frame
+void processCaptureKeys(GLFWwindow* window)
+{
+    static bool captureHeld = false;
+    bool capture = glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS;
+    if (capture && !captureHeld)
+        captureRequested = true;
+    captureHeld = capture;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -440,7 +1239,12 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // the viewport itself is set by the render thread, which owns the context
+    if (width > 0 && height > 0) {
+        framebufferWidth = width;
+        framebufferHeight = height;
+    }
+    camera.SetViewport(width, height);
 }
 
 
@@ -448,43 +1252,36 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
-    float xpos = static_cast<float>(xposIn);
-    float ypos = static_cast<float>(yposIn);
-
-    if (firstMouse)
-    {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
-    }
-
-    float xoffset = xpos - lastX;
-    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
-
-    lastX = xpos;
-    lastY = ypos;
+    if (input.cursor(xposIn, yposIn))
+        processCursor(xposIn, yposIn);
+}
 
-    camera.ProcessMouseMovement(xoffset, yoffset);
+// adds a cursor position, from GLFW or from a recording. The camera turns once per frame with the sum of the motion.
+void processCursor(double xposIn, double yposIn)
+{
+    mouse.cursor(xposIn, yposIn, glfwGetTime());
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    if (input.scroll(xoffset, yoffset))
+        processScroll(yoffset);
+}
+
+void processScroll(double yoffset)
 {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-void setupLightSource(Shader lightSourceShader, unsigned int VAO) {
+void setupLightSource(Shader& lightSourceShader, unsigned int VAO) {
+    const LightSystem& lights = renderPacket->lights;
     lightSourceShader.use();
-    lightList[5].setStrength(abs(sin(glfwGetTime())));
-    for (int i = 0; i < lightList.size(); i++) {
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        glUniformMatrix4fv(glGetUniformLocation(lightSourceShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(lightSourceShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        lightSourceShader.setVec3("lightCubeColor", lightList[i].lightColor);
+    for (unsigned int i = 0; i < lights.size(); i++) {
+        lightSourceShader.setVec3("lightCubeColor", lights.color(i));
         glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, lightList[i].lightPos);
+        model = glm::translate(model, lights.position(i));
         model = glm::scale(model, glm::vec3(0.1f));
         glUniformMatrix4fv(glGetUniformLocation(lightSourceShader.ID, "model"), 1, GL_FALSE, glm::value_ptr(model));        
         //DrawCube(VAO);
@@ -492,18 +1289,13 @@ void setupLightSource(Shader lightSourceShader, unsigned int VAO) {
 }
 
 
-void setupObject(Shader ObjectShader, glm::vec3 lightPos, glm::vec3 cubePos) {
+void setupObject(Shader& ObjectShader, glm::vec3 lightPos, glm::vec3 cubePos) {
     ObjectShader.use();
     glUniform3f(glGetUniformLocation(ObjectShader.ID, "objectColor"), 0.33f, 0.01f, 0.45f);
     glUniform3f(glGetUniformLocation(ObjectShader.ID, "lightColor"), 1.0f, 1.0f, 1.0f);
     glUniform3fv(glGetUniformLocation(ObjectShader.ID, "lightPos"), 1, glm::value_ptr(lightPos));
-    glUniform3fv(glGetUniformLocation(ObjectShader.ID, "viewPos"), 1, glm::value_ptr(camera.Position));
     
-    // view/projection transformations
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 view = camera.GetViewMatrix();
-    glUniformMatrix4fv(glGetUniformLocation(ObjectShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glUniformMatrix4fv(glGetUniformLocation(ObjectShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    // view/projection transformations and viewPos come from the camera block
     // world transformation
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, cubePos);
@@ -515,7 +1307,7 @@ void DrawCube(unsigned int VAO) {
     glDrawArrays(GL_TRIANGLES, 0, 36);
 }
 
-void DrawTerrain(Shader cubeShader, unsigned int VAO, int terrainSize, glm::vec3 rootPos) {
+void DrawTerrain(Shader& cubeShader, unsigned int VAO, int terrainSize, glm::vec3 rootPos) {
 
     for (unsigned int i = 0; i < terrainSize; i++) {
         for (unsigned int j = 0; j < terrainSize; j++) {
@@ -526,74 +1318,43 @@ void DrawTerrain(Shader cubeShader, unsigned int VAO, int terrainSize, glm::vec3
     }
 }
 
-void DrawWall(Shader ObjectShader, glm::vec3 wallPos, glm::mat4 rotation) {
-    std::string number;
-    for (int i = 0; i < lightList.size(); i++) {
-        number = std::to_string(i);
-        ObjectShader.use();
-        glUniform3fv(glGetUniformLocation(ObjectShader.ID, ("lightColor[" + number + "]").c_str()), 1, glm::value_ptr(lightList[i].lightColor));
-        glUniform3fv(glGetUniformLocation(ObjectShader.ID, ("lightPos[" + number + "]").c_str()), 1, glm::value_ptr(lightList[i].lightPos));
-        glUniform3fv(glGetUniformLocation(ObjectShader.ID, "viewPos"), 1, glm::value_ptr(camera.Position));
-        glUniform1f(glGetUniformLocation(ObjectShader.ID, ("strength[" + number + "]").c_str()), lightList[i].strength);
-        glUniform1f(glGetUniformLocation(ObjectShader.ID, ("range[" + number + "]").c_str()), lightList[i].range);
-        glUniform3fv(glGetUniformLocation(ObjectShader.ID, ("spotDir[" + number + "]").c_str()), 1, glm::value_ptr(lightList[i].spotDir));
-        glUniform1f(glGetUniformLocation(ObjectShader.ID, ("cutOff[" + number + "]").c_str()), glm::cos(glm::radians(lightList[i].cutOff)));
-        glUniform1f(glGetUniformLocation(ObjectShader.ID, ("outerCutOff[" + number + "]").c_str()), glm::cos(glm::radians(lightList[i].outerCutOff)));
-        ObjectShader.setBool(("isSpot[" + number + "]").c_str(), lightList[i].isSpot);
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        glUniformMatrix4fv(glGetUniformLocation(ObjectShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(ObjectShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, wallPos);
-        model = glm::scale(model, glm::vec3(15, 5, 15));
-        model = model * rotation;
-        glUniformMatrix4fv(glGetUniformLocation(ObjectShader.ID, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    }    
+// the camera and object blocks of the draw must be bound, the lights uploaded for the frame
+void DrawWall(Shader& ObjectShader, unsigned int surface) {
+    ObjectShader.use();
+    lightmap.apply(ObjectShader, renderPacket->lights, surface, LIGHTMAP_TEXTURE_UNIT);
 }
 
-void Draw4Walls(Shader ObjectShader, unsigned int VAO, glm::vec3 wallPos) {
-    glm::vec3 pos = wallPos;
-    
+// model matrices of the 4 walls then the ground, in drawing order
+void roomSurfaces(glm::vec3 wallPos, glm::mat4 surfaces[5]) {
+    glm::vec3 pos[5];
+    glm::mat4 rotation[5];
     //Wall 1
-    glm::vec3 pos1 = glm::vec3(wallPos.x + 7.0f, wallPos.y + 2.0f, wallPos.z + 0.5f);
-    DrawWall(ObjectShader, pos1, glm::mat4(1.0f));
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
+    pos[0] = glm::vec3(wallPos.x + 7.0f, wallPos.y + 2.0f, wallPos.z + 0.5f);
+    rotation[0] = glm::mat4(1.0f);
     //Wall 2
-    glm::mat4 rotation = glm::mat4(1.0f);
-    rotation = glm::rotate(rotation, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
-    glm::vec3 pos2 = glm::vec3(wallPos.x -0.5f, wallPos.y + 2.0f, wallPos.z - 7.0f);
-    DrawWall(ObjectShader, pos2, rotation);
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
+    pos[1] = glm::vec3(wallPos.x - 0.5f, wallPos.y + 2.0f, wallPos.z - 7.0f);
+    rotation[1] = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
     //Wall 3
-    glm::vec3 pos3 = glm::vec3(wallPos.x + 7.0f, wallPos.y + 2.0f, wallPos.z -14.5f);
-    rotation = glm::mat4(1.0f);
-    rotation = glm::rotate(rotation, glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
-    DrawWall(ObjectShader, pos3, rotation);
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
+    pos[2] = glm::vec3(wallPos.x + 7.0f, wallPos.y + 2.0f, wallPos.z - 14.5f);
+    rotation[2] = glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
     //Wall 4
-    rotation = glm::rotate(rotation, glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
-    glm::vec3 pos4 = glm::vec3(wallPos.x +14.5f, wallPos.y + 2.0f, wallPos.z - 7.0f);
-    DrawWall(ObjectShader, pos4, rotation);
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-        
+    pos[3] = glm::vec3(wallPos.x + 14.5f, wallPos.y + 2.0f, wallPos.z - 7.0f);
+    rotation[3] = glm::rotate(rotation[2], glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
+    //Ground
+    pos[4] = glm::vec3(wallPos.x + 7.0f, wallPos.y + 0.5, wallPos.z - 7.0f);
+    rotation[4] = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0, 0.0, 0.0));
+
+    for (int i = 0; i < 5; i++) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, pos[i]);
+        model = glm::scale(model, glm::vec3(15, 5, 15));
+        surfaces[i] = model * rotation[i];
+    }
 }
 
-void DrawGround(Shader ObjectShader, unsigned int VAO, glm::vec3 wallPos) {
-    glm::mat4 rotation = glm::mat4(1.0f);
-    rotation = glm::rotate(rotation, glm::radians(90.0f), glm::vec3(1.0, 0.0, 0.0));
-    //rotation = glm::rotate(rotation, glm::radians(180.0f), glm::vec3(0.0, 1.0, 0.0));
-    glm::vec3 pos5 = glm::vec3(wallPos.x + 7.0f, wallPos.y + 0.5, wallPos.z - 7.0f);
-    DrawWall(ObjectShader, pos5, rotation);
+// surface is the index in roomSurfaces, its model matrix is in the object block
+void DrawSurface(Shader& ObjectShader, unsigned int VAO, unsigned int surface) {
+    DrawWall(ObjectShader, surface);
     glBindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
@@ -625,13 +1386,9 @@ unsigned int genTextureFromPath(const char* texturePath) {
     return texture;
 }
 
-void setupSkybox(Shader skyboxShader, unsigned int skyboxVAO, unsigned int cubemapTexture) {
+void setupSkybox(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int cubemapTexture) {
     glDepthFunc(GL_LEQUAL);
     skyboxShader.use();
-    glm::mat4 view = glm::mat4(glm::mat3(camera.GetViewMatrix()));
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    skyboxShader.setMat4("view", view);
-    skyboxShader.setMat4("projection", projection);
     glBindVertexArray(skyboxVAO);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
@@ -640,19 +1397,38 @@ void setupSkybox(Shader skyboxShader, unsigned int skyboxVAO, unsigned int cubem
     glDepthFunc(GL_LESS);
 }
 
-unsigned int loadCubemap(std::vector<std::string> faces)
+// when ambient is given, also returns the spherical harmonics of the cubemap, cached in sh9.txt beside the faces
+unsigned int loadCubemap(std::vector<std::string> faces, SH9* ambient)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-    int width, height, nrChannels;
+    // the faces are decoded in parallel, then uploaded here
+    std::vector<unsigned char*> decoded(faces.size());
+    std::vector<glm::ivec3> sizes(faces.size());
+    JobSystem::instance().parallelFor((unsigned int)faces.size(), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+            decoded[i] = stbi_load(faces[i].c_str(), &sizes[i].x, &sizes[i].y, &sizes[i].z, 0);
+    }, "Cubemap decode");
+
+    int width = 0, height = 0, nrChannels = 0;
+    SHFace shFaces[6] = {};
     for (unsigned int i = 0; i < faces.size(); i++)
     {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+        unsigned char* data = decoded[i];
+        width = sizes[i].x;
+        height = sizes[i].y;
+        nrChannels = sizes[i].z;
         if (data)
         {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            // faces are kept until the projection is done
+            if (ambient && i < 6) {
+                SHFace face = { data, width, height, nrChannels };
+                shFaces[i] = face;
+                continue;
+            }
             stbi_image_free(data);
         }
         else
@@ -661,6 +1437,16 @@ unsigned int loadCubemap(std::vector<std::string> faces)
             stbi_image_free(data);
         }
     }
+    if (ambient) {
+        std::string cachePath = SphericalHarmonics::cachePath(faces);
+        std::string key = SphericalHarmonics::faceKey(faces, width, height);
+        if (!SphericalHarmonics::load(cachePath, key, *ambient)) {
+            *ambient = SphericalHarmonics::project(shFaces);
+            SphericalHarmonics::save(cachePath, key, *ambient);
+        }
+        for (int i = 0; i < 6; i++)
+            stbi_image_free((void*)shFaces[i].data);
+    }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -670,55 +1456,78 @@ unsigned int loadCubemap(std::vector<std::string> faces)
     return textureID;
 }
 
-void DrawEye(Shader eyeShader, Model eyeModel, glm::vec3 eyePos, int lampIndex) {
-    eyeShader.use();
-    // render the loaded model
+// the eye follows the camera and counts the turns made around it, after 4 turns it dies and the room lights up
+void updateEye(glm::vec3 eyePos, int lampIndex) {
     if (totalAngle > 4 * glm::radians(360.0f)) {
         for (int i = 0; i < 4; i++) {
-            lightList[i].setStrength(5);
+            lights.setStrength(i, 5);
         }
-        lightList[lampIndex].setStrength(0);
-        lightList[5].setStrength(0);
+        lights.setStrength(lampIndex, 0);
+        animations.setEnabled(spotPulseTrack, false);
+        lights.setStrength(5, 0);
         return;
     }
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 view = camera.GetViewMatrix();
-    eyeShader.setMat4("projection", projection);
-    eyeShader.setMat4("view", view);
-    glm::mat4 model = glm::mat4(1.0f);
     glm::vec3 posCam = camera.getPosition();
-    float angle;
-    float scale;
-    model = glm::translate(model, eyePos);
-    angle = atan2f(eyePos.x - posCam.x, eyePos.z - posCam.z) + glm::radians(180.0f);
+    float angle = atan2f(eyePos.x - posCam.x, eyePos.z - posCam.z) + glm::radians(180.0f);
     if (abs(angle - previousAngle) < glm::radians(300.0f)) {        
         totalAngle += angle - previousAngle;        
     }
     previousAngle = angle;   
+    lights.setSpotDirection(lampIndex, glm::vec3(posCam.x - eyePos.x, 0.0, posCam.z - eyePos.z));
+}
 
-    scale = 1 - (totalAngle / (4 * glm::radians(360.0f)));
+// angle and scale are interpolated between the last two simulation steps
+glm::mat4 eyeTransform(glm::vec3 eyePos, float angle, float scale) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, eyePos);
     model = glm::scale(model, glm::vec3(scale, scale, scale));       
-    
-    lightList[lampIndex].setAngle(glm::vec3(posCam.x - eyePos.x, 0.0, posCam.z - eyePos.z));
     model = glm::rotate(model, angle, glm::vec3(0, 1, 0));
-    glUniformMatrix4fv(glGetUniformLocation(eyeShader.ID, "model"), 1, GL_FALSE, glm::value_ptr(model));
-
-    eyeModel.Draw(eyeShader);
+    return model;
 }
 
-void DrawObj(Shader eyeShader, Model eyeModel,glm::vec3 objPos) {
+// the camera and object blocks of the draw must be bound
+void DrawObj(Shader& eyeShader, Model& eyeModel, const unsigned char* visible) {
+    // visible, when given, has the culling result of each mesh: nothing to set up if they are all culled
+    if (visible) {
+        bool anyVisible = false;
+        for (unsigned int i = 0; i < eyeModel.meshes.size(); i++)
+            anyVisible = anyVisible || visible[i];
+        if (!anyVisible)
+            return;
+    }
     eyeShader.use();
     // render the loaded model
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 view = camera.GetViewMatrix();
-    eyeShader.setMat4("projection", projection);
-    eyeShader.setMat4("view", view);
+    LightmapBaker::disable(eyeShader);
+
+    if (visible)
+        eyeModel.Draw(eyeShader, visible);
+    else
+        eyeModel.Draw(eyeShader);
+}
+
+glm::mat4 objTransform(glm::vec3 objPos) {
     glm::mat4 model = glm::mat4(1.0f);
-    glm::vec3 posCam = camera.getPosition();
     model = glm::translate(model, objPos);
     model = glm::scale(model, glm::vec3(0.0165f, 0.014f, 0.015f));
     model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1, 0, 0));
-    glUniformMatrix4fv(glGetUniformLocation(eyeShader.ID, "model"), 1, GL_FALSE, glm::value_ptr(model));
+    return model;
+}
+
+// the eye rotates every frame: its bound is a sphere around eyePos holding every mesh at any angle and the current scale
+Bounds eyeBounds(const Model& eyeModel, glm::vec3 eyePos) {
+    float radius = 0.0f;
+    for (unsigned int i = 0; i < eyeModel.meshes.size(); i++)
+        radius = glm::max(radius, glm::length(eyeModel.meshes[i].bounds.center) + eyeModel.meshes[i].bounds.radius);
+    radius *= eyeScale();
+    Bounds b;
+    b.center = eyePos;
+    b.radius = radius;
+    b.min = eyePos - glm::vec3(radius);
+    b.max = eyePos + glm::vec3(radius);
+    return b;
+}
 
-    eyeModel.Draw(eyeShader);
-}
\ No newline at end of file
+// scale of the eye, 0 once the camera turned 4 times around it
+float eyeScale() {
+    return glm::max(0.0f, 1 - (totalAngle / (4 * glm::radians(360.0f))));
+}
@@ -0,0 +1,795 @@
+// Replay of a frame captured by the game (F6 or --capture-frame N, see render/GLCapture.h), in a hidden window:
+// g++ -O2 -std=c++17 -Idependencies/include GLReplay.cpp glad.c -o GLReplay -lglfw -ldl -lpthread
+// GLReplay frame.gltrace [--loops N] [--calls first last] [--list]
+// The objects of the trace are created once, then its calls are issued N times and the CPU time of the submission
+// and the GPU time of each loop are printed. --calls only issues a range of the calls, to bisect the cost of a frame,
+// and --list prints the index of every call.
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <render/GLCapture.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+
+const unsigned int REPLAY_DEFAULT_LOOPS = 1000;
+// loops before the timed ones, the driver compiles the shader variants and uploads the objects in the first ones
+const unsigned int REPLAY_WARMUP_LOOPS = 10;
+
+// one call of the trace, with the names of the replay context
+struct ReplayCall {
+    unsigned int op;
+    uint32_t v[5];
+    float f[4];
+    uint64_t offset, size;
+    size_t payload, payloadSize; // in ReplayTrace::payloads
+};
+
+struct ReplayState {
+    unsigned char capabilities[GL_TRACE_CAPABILITY_COUNT];
+    GLenum depthFunction;
+    GLboolean depthWrite, colorWrite[4];
+    GLfloat clearValue[4];
+    GLint viewport[4];
+    GLenum activeTexture;
+    GLuint program, vertexArray, framebuffer;
+};
+
+struct ReplayTrace {
+    int width, height;
+    ReplayState state;
+    std::vector<ReplayCall> calls;
+    std::vector<unsigned char> payloads;
+    std::map<GLuint, GLuint> programs, buffers, textures, vertexArrays, framebuffers, queries;
+};
+
+// reads the records of the trace file
+class TraceReader
+{
+public:
+    TraceReader(const std::vector<char>& _data) : data(_data), pos(0), failed(false)
+    {
+    }
+
+    bool ok() const
+    {
+        return !failed;
+    }
+
+    uint8_t u8() { uint8_t v = 0; read(&v, sizeof(v)); return v; }
+    uint16_t u16() { uint16_t v = 0; read(&v, sizeof(v)); return v; }
+    uint32_t u32() { uint32_t v = 0; read(&v, sizeof(v)); return v; }
+    int32_t i32() { int32_t v = 0; read(&v, sizeof(v)); return v; }
+    uint64_t u64() { uint64_t v = 0; read(&v, sizeof(v)); return v; }
+    float f32() { float v = 0.0f; read(&v, sizeof(v)); return v; }
+
+    // size then bytes, the pointer stays valid as long as the file data
+    const char* bytes(uint32_t& size)
+    {
+        size = u32();
+        if (failed || pos + size > data.size())
+        {
+            failed = true;
+            size = 0;
+            return NULL;
+        }
+        const char* p = size > 0 ? &data[pos] : NULL;
+        pos += size;
+        return p;
+    }
+
+    std::string text()
+    {
+        uint32_t size = 0;
+        const char* p = bytes(size);
+        return p ? std::string(p, size) : std::string();
+    }
+
+private:
+    const std::vector<char>& data;
+    size_t pos;
+    bool failed;
+
+    void read(void* v, size_t size)
+    {
+        if (failed || pos + size > data.size())
+        {
+            failed = true;
+            return;
+        }
+        std::memcpy(v, &data[pos], size);
+        pos += size;
+    }
+};
+
+GLuint mapName(const std::map<GLuint, GLuint>& names, GLuint name)
+{
+    std::map<GLuint, GLuint>::const_iterator it = names.find(name);
+    return it != names.end() ? it->second : 0;
+}
+
+bool isDepthFormat(GLenum format, bool& stencil)
+{
+    stencil = format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8 || format == GL_DEPTH_STENCIL;
+    return stencil || format == GL_DEPTH_COMPONENT || format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24
+        || format == GL_DEPTH_COMPONENT32 || format == GL_DEPTH_COMPONENT32F;
+}
+
+GLuint compileProgram(const std::vector<GLenum>& types, const std::vector<std::string>& sources, GLuint captured)
+{
+    GLuint program = glCreateProgram();
+    std::vector<GLuint> shaders;
+    for (unsigned int i = 0; i < sources.size(); i++)
+    {
+        GLuint shader = glCreateShader(types[i]);
+        const char* source = sources[i].c_str();
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        GLint success = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            char log[1024];
+            glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+            std::cout << "ERROR::GL_REPLAY:: Shader of program " << captured << " does not compile\n" << log << std::endl;
+        }
+        glAttachShader(program, shader);
+        shaders.push_back(shader);
+    }
+    glLinkProgram(program);
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        std::cout << "ERROR::GL_REPLAY:: Program " << captured << " does not link\n" << log << std::endl;
+    }
+    for (unsigned int i = 0; i < shaders.size(); i++)
+        glDeleteShader(shaders[i]);
+    return program;
+}
+
+void setUniform(GLint location, GLenum type, const char* values)
+{
+    const GLfloat* f = (const GLfloat*)values;
+    const GLint* i = (const GLint*)values;
+    bool isInteger = false;
+    unsigned int components = traceUniformComponents(type, isInteger);
+    if (type == GL_FLOAT_MAT2)
+        glUniformMatrix2fv(location, 1, GL_FALSE, f);
+    else if (type == GL_FLOAT_MAT3)
+        glUniformMatrix3fv(location, 1, GL_FALSE, f);
+    else if (type == GL_FLOAT_MAT4)
+        glUniformMatrix4fv(location, 1, GL_FALSE, f);
+    else if (isInteger)
+    {
+        if (components == 1) glUniform1iv(location, 1, i);
+        else if (components == 2) glUniform2iv(location, 1, i);
+        else if (components == 3) glUniform3iv(location, 1, i);
+        else if (components == 4) glUniform4iv(location, 1, i);
+    }
+    else
+    {
+        if (components == 1) glUniform1fv(location, 1, f);
+        else if (components == 2) glUniform2fv(location, 1, f);
+        else if (components == 3) glUniform3fv(location, 1, f);
+        else if (components == 4) glUniform4fv(location, 1, f);
+    }
+}
+
+void defineProgram(TraceReader& in, ReplayTrace& trace)
+{
+    GLuint captured = in.u32();
+    uint32_t shaderCount = in.u32();
+    std::vector<GLenum> types;
+    std::vector<std::string> sources;
+    for (uint32_t i = 0; i < shaderCount && in.ok(); i++)
+    {
+        types.push_back(in.u32());
+        sources.push_back(in.text());
+    }
+    GLuint program = compileProgram(types, sources, captured);
+    trace.programs[captured] = program;
+    glUseProgram(program);
+    uint32_t uniformCount = in.u32();
+    for (uint32_t i = 0; i < uniformCount && in.ok(); i++)
+    {
+        std::string name = in.text();
+        GLenum type = in.u32();
+        uint32_t size = 0;
+        const char* values = in.bytes(size);
+        GLint location = glGetUniformLocation(program, name.c_str());
+        if (location >= 0 && values)
+            setUniform(location, type, values);
+    }
+    glUseProgram(0);
+}
+
+void defineBuffer(TraceReader& in, ReplayTrace& trace)
+{
+    GLuint captured = in.u32();
+    uint32_t size = in.u32(), dataSize = 0;
+    const char* data = in.bytes(dataSize);
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, dataSize == size ? data : NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    trace.buffers[captured] = buffer;
+}
+
+void defineTexture(TraceReader& in, ReplayTrace& trace)
+{
+    GLuint captured = in.u32();
+    GLenum target = in.u32();
+    GLenum internalFormat = in.u32();
+    GLint width = in.i32(), height = in.i32(), depth = in.i32();
+    GLenum type = in.u32();
+    GLint minFilter = in.i32(), magFilter = in.i32(), wrapS = in.i32(), wrapT = in.i32(), wrapR = in.i32();
+    uint32_t faces = in.u32();
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    trace.textures[captured] = texture;
+    glBindTexture(target, texture);
+    // the textures without contents, depth ones, are allocated with a format matching their internal format
+    bool stencil = false;
+    GLenum format = GL_RGBA;
+    if (isDepthFormat(internalFormat, stencil))
+    {
+        format = stencil ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT;
+        type = stencil ? GL_UNSIGNED_INT_24_8 : GL_FLOAT;
+    }
+    for (uint32_t f = 0; f < faces && in.ok(); f++)
+    {
+        uint32_t size = 0;
+        const char* data = in.bytes(size);
+        if (width <= 0 || height <= 0)
+            continue;
+        if (target == GL_TEXTURE_2D_ARRAY)
+            glTexImage3D(target, 0, internalFormat, width, height, depth, 0, format, type, data);
+        else
+            glTexImage2D(target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + f : target, 0, internalFormat,
+                width, height, 0, format, type, data);
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, magFilter);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, wrapS);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, wrapT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, wrapR);
+    // only level 0 is in the trace
+    if (width > 0 && height > 0 && minFilter != GL_LINEAR && minFilter != GL_NEAREST)
+        glGenerateMipmap(target);
+    glBindTexture(target, 0);
+}
+
+void defineVertexArray(TraceReader& in, ReplayTrace& trace)
+{
+    GLuint captured = in.u32();
+    GLuint elements = mapName(trace.buffers, in.u32());
+    uint32_t attributeCount = in.u32();
+    GLuint vertexArray = 0;
+    glGenVertexArrays(1, &vertexArray);
+    trace.vertexArrays[captured] = vertexArray;
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elements);
+    for (uint32_t i = 0; i < attributeCount && in.ok(); i++)
+    {
+        GLuint index = in.u32();
+        GLint size = in.i32();
+        GLenum type = in.u32();
+        GLboolean normalized = in.u8();
+        bool integer = in.u8() != 0;
+        GLsizei stride = in.i32();
+        GLuint buffer = mapName(trace.buffers, in.u32());
+        const void* offset = (const void*)(uintptr_t)in.u64();
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (integer)
+            glVertexAttribIPointer(index, size, type, stride, offset);
+        else
+            glVertexAttribPointer(index, size, type, normalized, stride, offset);
+        glEnableVertexAttribArray(index);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void defineFramebuffer(TraceReader& in, ReplayTrace& trace)
+{
+    GLuint captured = in.u32();
+    GLuint color = mapName(trace.textures, in.u32());
+    GLenum depthFormat = in.u32();
+    GLint depthWidth = in.i32(), depthHeight = in.i32();
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    trace.framebuffers[captured] = framebuffer;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (color)
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    if (depthFormat)
+    {
+        bool stencil = false;
+        isDepthFormat(depthFormat, stencil);
+        GLuint depth = 0;
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, depthFormat, depthWidth, depthHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::GL_REPLAY:: Framebuffer " << captured << " is not complete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void readState(TraceReader& in, ReplayState& state)
+{
+    for (unsigned int i = 0; i < GL_TRACE_CAPABILITY_COUNT; i++)
+        state.capabilities[i] = in.u8();
+    state.depthFunction = in.u32();
+    state.depthWrite = in.u8();
+    for (int i = 0; i < 4; i++)
+        state.colorWrite[i] = in.u8();
+    for (int i = 0; i < 4; i++)
+        state.clearValue[i] = in.f32();
+    for (int i = 0; i < 4; i++)
+        state.viewport[i] = in.i32();
+    state.activeTexture = in.u32();
+    state.program = in.u32();
+    state.vertexArray = in.u32();
+    state.framebuffer = in.u32();
+}
+
+size_t storePayload(ReplayTrace& trace, const char* data, size_t size)
+{
+    size_t offset = trace.payloads.size();
+    trace.payloads.insert(trace.payloads.end(), data, data + size);
+    return offset;
+}
+
+// the file and the size of its default framebuffer, before there is a context
+bool readTrace(const char* path, std::vector<char>& data, ReplayTrace& trace)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::GL_REPLAY:: Cannot read " << path << std::endl;
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    TraceReader in(data);
+    if (in.u32() != GL_TRACE_MAGIC || in.u32() != GL_TRACE_VERSION)
+    {
+        std::cout << "ERROR::GL_REPLAY:: " << path << " is not a trace of this version" << std::endl;
+        return false;
+    }
+    trace.width = std::max(1, (int)in.i32());
+    trace.height = std::max(1, (int)in.i32());
+    return in.ok();
+}
+
+// creates the objects of the trace and decodes its calls with the names of this context
+bool loadTrace(const char* path, const std::vector<char>& data, ReplayTrace& trace)
+{
+    TraceReader in(data);
+    // header, read by readTrace
+    for (int i = 0; i < 4; i++)
+        in.u32();
+    std::memset(&trace.state, 0, sizeof(trace.state));
+
+    // uniform locations the frame looked up, by program, to map the locations of its glUniform* calls
+    std::map<std::pair<GLuint, GLint>, GLint> locations;
+    GLuint program = 0;
+    unsigned int op = TRACE_END;
+    while (in.ok() && (op = in.u16()) != TRACE_END)
+    {
+        ReplayCall c;
+        std::memset(&c, 0, sizeof(c));
+        c.op = op;
+        uint32_t size = 0;
+        const char* bytes = NULL;
+        switch (op)
+        {
+        case TRACE_DEF_STATE:
+            readState(in, trace.state);
+            trace.state.program = mapName(trace.programs, trace.state.program);
+            trace.state.vertexArray = mapName(trace.vertexArrays, trace.state.vertexArray);
+            trace.state.framebuffer = mapName(trace.framebuffers, trace.state.framebuffer);
+            continue;
+        case TRACE_DEF_PROGRAM: defineProgram(in, trace); continue;
+        case TRACE_DEF_BUFFER: defineBuffer(in, trace); continue;
+        case TRACE_DEF_TEXTURE: defineTexture(in, trace); continue;
+        case TRACE_DEF_VERTEX_ARRAY: defineVertexArray(in, trace); continue;
+        case TRACE_DEF_FRAMEBUFFER: defineFramebuffer(in, trace); continue;
+        case TRACE_DEF_QUERY:
+        {
+            GLuint captured = in.u32(), query = 0;
+            glGenQueries(1, &query);
+            trace.queries[captured] = query;
+            continue;
+        }
+        case TRACE_USE_PROGRAM:
+            program = c.v[0] = mapName(trace.programs, in.u32());
+            break;
+        case TRACE_GET_UNIFORM_LOCATION:
+        {
+            c.v[0] = mapName(trace.programs, in.u32());
+            std::string name = in.text();
+            GLint captured = in.i32();
+            locations[std::make_pair((GLuint)c.v[0], captured)] = glGetUniformLocation(c.v[0], name.c_str());
+            c.payload = storePayload(trace, name.c_str(), name.size() + 1);
+            c.payloadSize = name.size() + 1;
+            break;
+        }
+        case TRACE_UNIFORM:
+        {
+            c.v[0] = in.u8();
+            GLint location = in.i32();
+            // the locations never looked up are assumed the same, both contexts compiled the same sources
+            std::map<std::pair<GLuint, GLint>, GLint>::const_iterator it = locations.find(std::make_pair(program, location));
+            c.v[1] = (uint32_t)(it != locations.end() ? it->second : location);
+            c.v[2] = (uint32_t)in.i32();
+            c.v[3] = in.u8();
+            bytes = in.bytes(size);
+            break;
+        }
+        case TRACE_ACTIVE_TEXTURE: c.v[0] = in.u32(); break;
+        case TRACE_BIND_TEXTURE:
+            c.v[0] = in.u32();
+            c.v[1] = mapName(trace.textures, in.u32());
+            break;
+        case TRACE_BIND_VERTEX_ARRAY: c.v[0] = mapName(trace.vertexArrays, in.u32()); break;
+        case TRACE_BIND_BUFFER:
+            c.v[0] = in.u32();
+            c.v[1] = mapName(trace.buffers, in.u32());
+            break;
+        case TRACE_BIND_BUFFER_RANGE:
+            c.v[0] = in.u32();
+            c.v[1] = in.u32();
+            c.v[2] = mapName(trace.buffers, in.u32());
+            c.offset = in.u64();
+            c.size = in.u64();
+            break;
+        case TRACE_BUFFER_DATA:
+            c.v[0] = mapName(trace.buffers, in.u32());
+            c.size = in.u64();
+            c.v[1] = in.u32();
+            bytes = in.bytes(size);
+            break;
+        case TRACE_BUFFER_SUB_DATA:
+            c.v[0] = in.u32();
+            c.v[1] = mapName(trace.buffers, in.u32());
+            c.offset = in.u64();
+            bytes = in.bytes(size);
+            break;
+        case TRACE_BIND_FRAMEBUFFER:
+            c.v[0] = in.u32();
+            c.v[1] = mapName(trace.framebuffers, in.u32());
+            break;
+        case TRACE_VIEWPORT:
+            for (int i = 0; i < 4; i++)
+                c.v[i] = (uint32_t)in.i32();
+            break;
+        case TRACE_CLEAR_COLOR:
+            for (int i = 0; i < 4; i++)
+                c.f[i] = in.f32();
+            break;
+        case TRACE_CLEAR: case TRACE_ENABLE: case TRACE_DISABLE: case TRACE_DEPTH_FUNC: case TRACE_END_QUERY:
+            c.v[0] = in.u32();
+            break;
+        case TRACE_DEPTH_MASK: c.v[0] = in.u8(); break;
+        case TRACE_COLOR_MASK:
+            for (int i = 0; i < 4; i++)
+                c.v[i] = in.u8();
+            break;
+        case TRACE_DRAW_ARRAYS:
+            c.v[0] = in.u32();
+            c.v[1] = (uint32_t)in.i32();
+            c.v[2] = (uint32_t)in.i32();
+            break;
+        case TRACE_DRAW_ELEMENTS:
+            c.v[0] = in.u32();
+            c.v[1] = (uint32_t)in.i32();
+            c.v[2] = in.u32();
+            c.offset = in.u64();
+            break;
+        case TRACE_BEGIN_QUERY:
+            c.v[0] = in.u32();
+            c.v[1] = mapName(trace.queries, in.u32());
+            break;
+        case TRACE_QUERY_COUNTER:
+        case TRACE_BEGIN_CONDITIONAL_RENDER:
+            c.v[0] = mapName(trace.queries, in.u32());
+            c.v[1] = in.u32();
+            break;
+        case TRACE_END_CONDITIONAL_RENDER:
+            break;
+        default:
+            std::cout << "ERROR::GL_REPLAY:: Unknown record " << op << " in " << path << std::endl;
+            return false;
+        }
+        if (bytes)
+        {
+            c.payload = storePayload(trace, bytes, size);
+            c.payloadSize = size;
+        }
+        trace.calls.push_back(c);
+    }
+    if (!in.ok())
+    {
+        std::cout << "ERROR::GL_REPLAY:: " << path << " is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// the state the frame started from, the previous loop changed it
+void applyState(const ReplayState& state)
+{
+    for (unsigned int i = 0; i < GL_TRACE_CAPABILITY_COUNT; i++)
+    {
+        if (state.capabilities[i])
+            glEnable(GL_TRACE_CAPABILITIES[i]);
+        else
+            glDisable(GL_TRACE_CAPABILITIES[i]);
+    }
+    glDepthFunc(state.depthFunction);
+    glDepthMask(state.depthWrite);
+    glColorMask(state.colorWrite[0], state.colorWrite[1], state.colorWrite[2], state.colorWrite[3]);
+    glClearColor(state.clearValue[0], state.clearValue[1], state.clearValue[2], state.clearValue[3]);
+    glViewport(state.viewport[0], state.viewport[1], state.viewport[2], state.viewport[3]);
+    glActiveTexture(state.activeTexture);
+    glUseProgram(state.program);
+    glBindVertexArray(state.vertexArray);
+    glBindFramebuffer(GL_FRAMEBUFFER, state.framebuffer);
+}
+
+void uniform(const ReplayCall& c, const unsigned char* payload)
+{
+    GLint location = (GLint)c.v[1];
+    GLsizei count = (GLsizei)c.v[2];
+    GLboolean transpose = (GLboolean)c.v[3];
+    const GLfloat* f = (const GLfloat*)payload;
+    const GLint* i = (const GLint*)payload;
+    switch (c.v[0])
+    {
+    case TRACE_UNIFORM_1I: glUniform1i(location, i[0]); break;
+    case TRACE_UNIFORM_1F: glUniform1f(location, f[0]); break;
+    case TRACE_UNIFORM_2F: glUniform2f(location, f[0], f[1]); break;
+    case TRACE_UNIFORM_3F: glUniform3f(location, f[0], f[1], f[2]); break;
+    case TRACE_UNIFORM_4F: glUniform4f(location, f[0], f[1], f[2], f[3]); break;
+    case TRACE_UNIFORM_1IV: glUniform1iv(location, count, i); break;
+    case TRACE_UNIFORM_1FV: glUniform1fv(location, count, f); break;
+    case TRACE_UNIFORM_2FV: glUniform2fv(location, count, f); break;
+    case TRACE_UNIFORM_3FV: glUniform3fv(location, count, f); break;
+    case TRACE_UNIFORM_4FV: glUniform4fv(location, count, f); break;
+    case TRACE_UNIFORM_MATRIX_2FV: glUniformMatrix2fv(location, count, transpose, f); break;
+    case TRACE_UNIFORM_MATRIX_3FV: glUniformMatrix3fv(location, count, transpose, f); break;
+    case TRACE_UNIFORM_MATRIX_4FV: glUniformMatrix4fv(location, count, transpose, f); break;
+    default: break;
+    }
+}
+
+void issue(const ReplayCall& c, const std::vector<unsigned char>& payloads)
+{
+    const unsigned char* payload = c.payloadSize > 0 ? &payloads[c.payload] : NULL;
+    switch (c.op)
+    {
+    case TRACE_USE_PROGRAM: glUseProgram(c.v[0]); break;
+    case TRACE_GET_UNIFORM_LOCATION: glGetUniformLocation(c.v[0], (const GLchar*)payload); break;
+    case TRACE_UNIFORM: uniform(c, payload); break;
+    case TRACE_ACTIVE_TEXTURE: glActiveTexture(c.v[0]); break;
+    case TRACE_BIND_TEXTURE: glBindTexture(c.v[0], c.v[1]); break;
+    case TRACE_BIND_VERTEX_ARRAY: glBindVertexArray(c.v[0]); break;
+    case TRACE_BIND_BUFFER: glBindBuffer(c.v[0], c.v[1]); break;
+    case TRACE_BIND_BUFFER_RANGE: glBindBufferRange(c.v[0], c.v[1], c.v[2], (GLintptr)c.offset, (GLsizeiptr)c.size); break;
+    // the buffer contents go through GL_COPY_WRITE_BUFFER, the frame does not use it
+    case TRACE_BUFFER_DATA:
+        glBindBuffer(GL_COPY_WRITE_BUFFER, c.v[0]);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)c.size, payload, c.v[1]);
+        break;
+    case TRACE_BUFFER_SUB_DATA:
+        glBindBuffer(GL_COPY_WRITE_BUFFER, c.v[1]);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)c.offset, (GLsizeiptr)c.payloadSize, payload);
+        break;
+    case TRACE_BIND_FRAMEBUFFER: glBindFramebuffer(c.v[0], c.v[1]); break;
+    case TRACE_VIEWPORT: glViewport((GLint)c.v[0], (GLint)c.v[1], (GLsizei)c.v[2], (GLsizei)c.v[3]); break;
+    case TRACE_CLEAR_COLOR: glClearColor(c.f[0], c.f[1], c.f[2], c.f[3]); break;
+    case TRACE_CLEAR: glClear(c.v[0]); break;
+    case TRACE_ENABLE: glEnable(c.v[0]); break;
+    case TRACE_DISABLE: glDisable(c.v[0]); break;
+    case TRACE_DEPTH_FUNC: glDepthFunc(c.v[0]); break;
+    case TRACE_DEPTH_MASK: glDepthMask((GLboolean)c.v[0]); break;
+    case TRACE_COLOR_MASK: glColorMask((GLboolean)c.v[0], (GLboolean)c.v[1], (GLboolean)c.v[2], (GLboolean)c.v[3]); break;
+    case TRACE_DRAW_ARRAYS: glDrawArrays(c.v[0], (GLint)c.v[1], (GLsizei)c.v[2]); break;
+    case TRACE_DRAW_ELEMENTS: glDrawElements(c.v[0], (GLsizei)c.v[1], c.v[2], (const void*)(uintptr_t)c.offset); break;
+    case TRACE_BEGIN_QUERY: glBeginQuery(c.v[0], c.v[1]); break;
+    case TRACE_END_QUERY: glEndQuery(c.v[0]); break;
+    case TRACE_QUERY_COUNTER: glQueryCounter(c.v[0], c.v[1]); break;
+    case TRACE_BEGIN_CONDITIONAL_RENDER: glBeginConditionalRender(c.v[0], c.v[1]); break;
+    case TRACE_END_CONDITIONAL_RENDER: glEndConditionalRender(); break;
+    default: break;
+    }
+}
+
+// mean, 50th and 99th percentiles and max of the times in ms
+void reportTimes(const char* name, std::vector<double>& times)
+{
+    if (times.empty())
+        return;
+    std::sort(times.begin(), times.end());
+    double total = 0.0;
+    for (unsigned int i = 0; i < times.size(); i++)
+        total += times[i];
+    size_t last = times.size() - 1;
+    std::cout << std::setw(12) << name << std::fixed << std::setprecision(3) << "mean " << total / times.size()
+        << " ms, 50th percentile " << times[last / 2] << " ms, 99th percentile " << times[last * 99 / 100]
+        << " ms, max " << times[last] << " ms" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: GLReplay <trace> [--loops N] [--calls first last] [--list]" << std::endl;
+        return -1;
+    }
+    const char* path = argv[1];
+    unsigned int loops = REPLAY_DEFAULT_LOOPS;
+    long first = 0, last = -1;
+    bool list = false;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (option == "--list")
+            list = true;
+        else if (option == "--loops" && i + 1 < argc)
+            loops = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (option == "--calls" && i + 2 < argc)
+        {
+            first = std::atol(argv[++i]);
+            last = std::atol(argv[++i]);
+        }
+        else
+            std::cout << "Unknown option " << option << std::endl;
+    }
+
+    ReplayTrace trace;
+    std::vector<char> data;
+    if (!readTrace(path, data, trace))
+        return -1;
+
+    // a hidden window of the captured size, rendering in memory with OSMesa or EGL when there is no display, like a headless run
+    if (!glfwInit())
+    {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(trace.width, trace.height, "GLReplay", NULL, NULL);
+    if (window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        window = glfwCreateWindow(trace.width, trace.height, "GLReplay", NULL, NULL);
+    }
+    if (window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+        window = glfwCreateWindow(trace.width, trace.height, "GLReplay", NULL, NULL);
+    }
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    glfwSwapInterval(0);
+
+    std::chrono::high_resolution_clock::time_point loadStart = std::chrono::high_resolution_clock::now();
+    if (!loadTrace(path, data, trace))
+    {
+        glfwTerminate();
+        return -1;
+    }
+    glFinish();
+    double loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+
+    long callCount = (long)trace.calls.size();
+    if (last < 0 || last >= callCount)
+        last = callCount - 1;
+    first = std::max(0L, std::min(first, last));
+    if (list)
+        for (long i = first; i <= last; i++)
+            std::cout << i << " " << traceOpName(trace.calls[i].op) << std::endl;
+
+    unsigned long long counts[TRACE_OP_COUNT] = {};
+    unsigned long long draws = 0, primitives = 0;
+    for (long i = first; i <= last; i++)
+    {
+        const ReplayCall& c = trace.calls[i];
+        counts[c.op]++;
+        if (c.op == TRACE_DRAW_ARRAYS || c.op == TRACE_DRAW_ELEMENTS)
+        {
+            draws++;
+            primitives += c.op == TRACE_DRAW_ARRAYS ? c.v[2] : c.v[1];
+        }
+    }
+    std::cout << path << ": " << trace.width << "x" << trace.height << ", " << callCount << " calls, "
+        << trace.programs.size() << " programs, " << trace.buffers.size() << " buffers, " << trace.textures.size()
+        << " textures, loaded in " << loadTime << " ms" << std::endl;
+    std::cout << "Calls " << first << " to " << last << ": " << draws << " draws of " << primitives << " vertices" << std::endl;
+    for (unsigned int op = TRACE_USE_PROGRAM; op < TRACE_OP_COUNT; op++)
+        if (counts[op] > 0)
+            std::cout << "  " << traceOpName(op) << ": " << counts[op] << std::endl;
+
+    // each loop is timed on the CPU around the submission and on the GPU with a pair of timestamps
+    std::vector<GLuint> timers(2 * loops);
+    glGenQueries((GLsizei)timers.size(), &timers[0]);
+    std::vector<double> cpuTimes, gpuTimes;
+    cpuTimes.reserve(loops);
+    gpuTimes.reserve(loops);
+    std::chrono::high_resolution_clock::time_point runStart;
+    for (unsigned int l = 0; l < REPLAY_WARMUP_LOOPS + loops; l++)
+    {
+        if (l == REPLAY_WARMUP_LOOPS)
+        {
+            glFinish();
+            runStart = std::chrono::high_resolution_clock::now();
+        }
+        bool timed = l >= REPLAY_WARMUP_LOOPS;
+        unsigned int t = l - REPLAY_WARMUP_LOOPS;
+        applyState(trace.state);
+        if (timed)
+            glQueryCounter(timers[2 * t], GL_TIMESTAMP);
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        for (long i = first; i <= last; i++)
+            issue(trace.calls[i], trace.payloads);
+        if (timed)
+        {
+            cpuTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+            glQueryCounter(timers[2 * t + 1], GL_TIMESTAMP);
+        }
+        glfwSwapBuffers(window);
+    }
+    glFinish();
+    double runTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - runStart).count();
+    for (unsigned int t = 0; t < loops; t++)
+    {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(timers[2 * t], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(timers[2 * t + 1], GL_QUERY_RESULT, &end);
+        gpuTimes.push_back(end > begin ? (end - begin) * 1e-6 : 0.0);
+    }
+    glDeleteQueries((GLsizei)timers.size(), &timers[0]);
+
+    std::cout << "Replayed " << loops << " times, " << runTime / loops << " ms per loop with the swap" << std::endl;
+    std::cout << std::left;
+    reportTimes("CPU submit:", cpuTimes);
+    reportTimes("GPU:", gpuTimes);
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR)
+        std::cout << "ERROR::GL_REPLAY:: GL error 0x" << std::hex << error << " during the replay" << std::endl;
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,6 @@
+#version 420 core
+
+// only the depth test matters for the occlusion query, color and depth writes are off
+void main()
+{
+}
@@ -0,0 +1,17 @@
+#version 420 core
+layout (location = 0) in vec3 aPos;
+
+// per frame, from the upload ring
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+// unit cube moved onto the bounding box of the tested object
+uniform mat4 model;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
@@ -1,2 +1,4 @@
 #define STB_IMAGE_IMPLEMENTATION
-#include <image/stb_image.h>
\ No newline at end of file
+#include <image/stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <image/stb_image_write.h>
\ No newline at end of file
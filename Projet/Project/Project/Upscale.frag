@@ -0,0 +1,15 @@
+#version 420 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// scene rendered at a lower resolution in the lower left part of the texture
+uniform sampler2D scene;
+uniform vec2 uvScale;
+uniform vec2 uvMax;
+
+void main()
+{
+    FragColor = texture(scene, min(TexCoords * uvScale, uvMax));
+}
@@ -4,12 +4,14 @@
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TextCoord;
+in vec2 LightmapCoord;
 out vec4 FragColor;
 //Light obj
 uniform vec3 lightColor[NBLamp];
 uniform vec3 lightPos[NBLamp];
 uniform float range[NBLamp];
 uniform float strength[NBLamp];
+uniform float radius[NBLamp]; //Distance ou la lampe s'eteint, 0 = attenuation sans limite
 
 //Spotlight
 uniform vec3 spotDir[NBLamp]; //Direction du spot
@@ -17,14 +19,44 @@ uniform float cutOff[NBLamp]; //Angle d'
 uniform float outerCutOff[NBLamp];
 uniform bool isSpot[NBLamp];
 
+//Lightmap
+uniform sampler2DArray lightmap; //Une couche par lampe statique, force 1
+uniform bool useLightmap;
+uniform int bakedLayer[NBLamp]; //-1 si la lampe est dynamique
 
-uniform vec3 viewPos;
+// per frame, from the upload ring
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 uniform sampler2D ourTexture;
 
+//Ambient : harmoniques spheriques de la skybox
+uniform vec3 shAmbient[9];
+uniform float ambientStrength;
+
+//Inverse carre fenetre : exactement 0 a partir de radius
+float attenuation(int i, float dist)
+{
+    if(radius[i] <= 0.0)
+        return min(range[i] / dist, 1.0);
+    float ratio = dist / radius[i];
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return min(range[i] * range[i] / (dist * dist), 1.0) * window * window;
+}
+
+vec3 skyAmbient(vec3 n)
+{
+    return shAmbient[0] + shAmbient[1] * n.y + shAmbient[2] * n.z + shAmbient[3] * n.x
+        + shAmbient[4] * (n.x * n.y) + shAmbient[5] * (n.y * n.z) + shAmbient[6] * (3.0 * n.z * n.z - 1.0)
+        + shAmbient[7] * (n.x * n.z) + shAmbient[8] * (n.x * n.x - n.y * n.y);
+}
+
 void main()
 {
-    float ambientStrength = 0.02f;
-    vec4 ambient = ambientStrength * vec4(1.0,1.0,1.0,1.0);
+    vec4 ambient = vec4(ambientStrength * max(skyAmbient(normalize(Normal)), 0.0), ambientStrength);
     vec3 result = vec3(0.0);
     vec3 norm;
     vec3 lightDir;
@@ -43,9 +75,15 @@ void main()
     float intensity;
 
     for(int i = 0; i < NBLamp; i++){
+        if(useLightmap && bakedLayer[i] >= 0){
+            result += strength[i] * texture(lightmap, vec3(LightmapCoord, bakedLayer[i])).rgb;
+            continue;
+        }
         norm = normalize(Normal);
         lightDir = normalize(lightPos[i] - FragPos);
         dist = abs(distance(lightPos[i], FragPos));
+        if(radius[i] > 0.0 && dist >= radius[i])
+            continue;
 
 
         theta = dot(lightDir, normalize(-spotDir[i]));
@@ -62,7 +100,7 @@ void main()
             spec = pow(max(dot(viewDir, reflectDir), 0.0), 256);
             specular = specularStrength * spec * lightColor[i];
 
-            result += strength[i] * (1 - intensity) * min((range[i]/dist),1.0) * (diffuse + specular);
+            result += strength[i] * (1 - intensity) * attenuation(i, dist) * (diffuse + specular);
         }
         if(!isSpot[i]){
             diff = max(dot(norm, lightDir), 0.0);
@@ -74,7 +112,7 @@ void main()
             spec = pow(max(dot(viewDir, reflectDir), 0.0), 256);
             specular = specularStrength * spec * lightColor[i];
 
-            result += strength[i] * min((range[i]/dist),1.0) * (diffuse + specular);
+            result += strength[i] * attenuation(i, dist) * (diffuse + specular);
         }
 
         
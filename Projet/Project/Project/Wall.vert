@@ -2,14 +2,26 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexture;
+layout (location = 3) in vec2 aLightmap;
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TextCoord;
+out vec2 LightmapCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per frame, from the upload ring
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+// per draw, from the upload ring
+layout (std140, binding = 1) uniform Object
+{
+    mat4 model;
+};
+uniform vec4 lightmapRect; //Scale xy, offset zw du chart dans l'atlas
 
 
 void main()
@@ -18,4 +30,5 @@ void main()
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
     TextCoord = aTexture;
+    LightmapCoord = lightmapRect.zw + aLightmap * lightmapRect.xy;
 } 
\ No newline at end of file
@@ -0,0 +1,278 @@
+#ifndef ANIMATION_SYSTEM_H
+#define ANIMATION_SYSTEM_H
+
+#include <glm/glm.hpp>
+
+#include <light/LightSystem.h>
+#include <jobs/JobSystem.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// Shape of a procedural curve: value = offset + amplitude * f(frequency * t + phase)
+enum Anim_Curve {
+    ANIM_SINE,
+    ANIM_ABS_SINE,
+    ANIM_SQUARE,
+    ANIM_SAWTOOTH
+};
+
+// Property a track writes to
+enum Anim_Property {
+    ANIM_LIGHT_STRENGTH,
+    ANIM_LIGHT_RANGE,
+    ANIM_LIGHT_POS_X,
+    ANIM_LIGHT_POS_Y,
+    ANIM_LIGHT_POS_Z,
+    ANIM_LIGHT_COLOR_R,
+    ANIM_LIGHT_COLOR_G,
+    ANIM_LIGHT_COLOR_B,
+    ANIM_FLOAT // raw float, e.g. a component of a transform
+};
+
+// below this many tracks the evaluation stays on the calling thread
+const unsigned int ANIM_PARALLEL_THRESHOLD = 4096;
+const unsigned int ANIM_MIN_CHUNK = 1024;
+
+// Evaluates every animation track of the scene in one batched pass.
+// Procedural and keyframed tracks are stored as separate structure-of-arrays so each kind is evaluated by a tight
+// branch-free loop; the pass is split in chunks across worker threads when there are enough tracks. Results are
+// then written back on the calling thread, and only for the properties whose value actually changed.
+class AnimationSystem
+{
+public:
+    AnimationSystem(LightSystem* _lights = NULL) : lights(_lights)
+    {
+    }
+
+    // procedural track, returns the track id
+    unsigned int addProcedural(Anim_Curve curve, float amplitude, float frequency, float phase, float offset)
+    {
+        unsigned int id = addTrack(TRACK_PROCEDURAL, (unsigned int)procCurve.size());
+        procCurve.push_back((int)curve);
+        procAmplitude.push_back(amplitude);
+        procFrequency.push_back(frequency);
+        procPhase.push_back(phase);
+        procOffset.push_back(offset);
+        procValue.push_back(0.0f);
+        return id;
+    }
+
+    // keyframed track with linear interpolation, times must be increasing. Loops over the last key time when loop is set.
+    unsigned int addKeyframed(const std::vector<float>& times, const std::vector<float>& values, bool loop)
+    {
+        unsigned int id = addTrack(TRACK_KEYFRAMED, (unsigned int)keyStart.size());
+        keyStart.push_back((unsigned int)keyTimes.size());
+        keyCount.push_back((unsigned int)std::min(times.size(), values.size()));
+        keyLoop.push_back(loop ? 1 : 0);
+        keyTimes.insert(keyTimes.end(), times.begin(), times.begin() + keyCount.back());
+        keyValues.insert(keyValues.end(), values.begin(), values.begin() + keyCount.back());
+        keyValue.push_back(0.0f);
+        return id;
+    }
+
+    // binds a track to a light property
+    void bindLight(unsigned int track, unsigned int lightIndex, Anim_Property property)
+    {
+        targetProperty[track] = (int)property;
+        targetIndex[track] = lightIndex;
+        targetFloat[track] = NULL;
+    }
+
+    // binds a track to any float that outlives the animation system
+    void bindFloat(unsigned int track, float* target)
+    {
+        targetProperty[track] = (int)ANIM_FLOAT;
+        targetIndex[track] = 0;
+        targetFloat[track] = target;
+    }
+
+    void setEnabled(unsigned int track, bool enabled)
+    {
+        trackEnabled[track] = enabled ? 1 : 0;
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)trackKind.size();
+    }
+
+    // evaluates all tracks at time t and writes the changed values to their targets, returns the number of writes
+    unsigned int evaluate(double t)
+    {
+        float time = (float)t;
+        parallelRange((unsigned int)procCurve.size(), [this, time](unsigned int begin, unsigned int end) {
+            evaluateProcedural(time, begin, end);
+        });
+        parallelRange((unsigned int)keyStart.size(), [this, time](unsigned int begin, unsigned int end) {
+            evaluateKeyframed(time, begin, end);
+        });
+        return apply();
+    }
+
+private:
+    enum Track_Kind {
+        TRACK_PROCEDURAL,
+        TRACK_KEYFRAMED
+    };
+
+    LightSystem* lights;
+
+    // per track
+    std::vector<int> trackKind;
+    std::vector<unsigned int> trackSlot; // index in the procedural or keyframed arrays
+    std::vector<uint8_t> trackEnabled;
+    std::vector<int> targetProperty;
+    std::vector<unsigned int> targetIndex;
+    std::vector<float*> targetFloat;
+    std::vector<float> lastWritten;
+    std::vector<uint8_t> hasWritten;
+
+    // procedural tracks
+    std::vector<int> procCurve;
+    std::vector<float> procAmplitude, procFrequency, procPhase, procOffset;
+    std::vector<float> procValue;
+
+    // keyframed tracks
+    std::vector<unsigned int> keyStart, keyCount;
+    std::vector<uint8_t> keyLoop;
+    std::vector<float> keyTimes, keyValues;
+    std::vector<float> keyValue;
+
+    unsigned int addTrack(Track_Kind kind, unsigned int slot)
+    {
+        trackKind.push_back((int)kind);
+        trackSlot.push_back(slot);
+        trackEnabled.push_back(1);
+        targetProperty.push_back((int)ANIM_FLOAT);
+        targetIndex.push_back(0);
+        targetFloat.push_back(NULL);
+        lastWritten.push_back(0.0f);
+        hasWritten.push_back(0);
+        return (unsigned int)trackKind.size() - 1;
+    }
+
+    // runs kernel(begin, end) over [0, n), in chunks on the job system when n is large enough
+    template <typename Kernel>
+    void parallelRange(unsigned int n, Kernel kernel)
+    {
+        if (n < ANIM_PARALLEL_THRESHOLD)
+        {
+            kernel(0, n);
+            return;
+        }
+        JobSystem::instance().parallelFor(n, ANIM_MIN_CHUNK, kernel, "Animation");
+    }
+
+    void evaluateProcedural(float t, unsigned int begin, unsigned int end)
+    {
+        const int* curve = procCurve.data();
+        const float* amplitude = procAmplitude.data();
+        const float* frequency = procFrequency.data();
+        const float* phase = procPhase.data();
+        const float* offset = procOffset.data();
+        float* value = procValue.data();
+        // every shape is computed and selected arithmetically so the loop has no branches and vectorizes
+        for (unsigned int i = begin; i < end; i++)
+        {
+            float x = frequency[i] * t + phase[i];
+            float s = std::sin(x);
+            float square = s >= 0.0f ? 1.0f : -1.0f;
+            float cycles = x * 0.15915494f; // 1 / (2 pi)
+            float saw = 2.0f * (cycles - std::floor(cycles)) - 1.0f;
+            float shape = (curve[i] == ANIM_SINE) * s + (curve[i] == ANIM_ABS_SINE) * std::fabs(s)
+                + (curve[i] == ANIM_SQUARE) * square + (curve[i] == ANIM_SAWTOOTH) * saw;
+            value[i] = offset[i] + amplitude[i] * shape;
+        }
+    }
+
+    void evaluateKeyframed(float t, unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            unsigned int n = keyCount[i];
+            if (n == 0)
+            {
+                keyValue[i] = 0.0f;
+                continue;
+            }
+            const float* times = &keyTimes[keyStart[i]];
+            const float* values = &keyValues[keyStart[i]];
+            float local = t;
+            if (keyLoop[i] && times[n - 1] > 0.0f)
+                local = std::fmod(t, times[n - 1]);
+            if (local <= times[0])
+            {
+                keyValue[i] = values[0];
+                continue;
+            }
+            if (local >= times[n - 1])
+            {
+                keyValue[i] = values[n - 1];
+                continue;
+            }
+            unsigned int k = (unsigned int)(std::upper_bound(times, times + n, local) - times);
+            float span = times[k] - times[k - 1];
+            float f = span > 0.0f ? (local - times[k - 1]) / span : 0.0f;
+            keyValue[i] = values[k - 1] + f * (values[k] - values[k - 1]);
+        }
+    }
+
+    // writes back the values that changed since the last evaluation
+    unsigned int apply()
+    {
+        unsigned int writes = 0;
+        for (unsigned int track = 0; track < trackKind.size(); track++)
+        {
+            if (!trackEnabled[track])
+                continue;
+            float value = trackKind[track] == TRACK_PROCEDURAL ? procValue[trackSlot[track]] : keyValue[trackSlot[track]];
+            if (hasWritten[track] && lastWritten[track] == value)
+                continue;
+            lastWritten[track] = value;
+            hasWritten[track] = 1;
+            write(track, value);
+            writes++;
+        }
+        return writes;
+    }
+
+    void write(unsigned int track, float value)
+    {
+        unsigned int i = targetIndex[track];
+        switch (targetProperty[track])
+        {
+        case ANIM_FLOAT:
+            if (targetFloat[track])
+                *targetFloat[track] = value;
+            return;
+        case ANIM_LIGHT_STRENGTH:
+            lights->setStrength(i, value);
+            return;
+        case ANIM_LIGHT_RANGE:
+            lights->setRange(i, value);
+            return;
+        case ANIM_LIGHT_POS_X:
+        case ANIM_LIGHT_POS_Y:
+        case ANIM_LIGHT_POS_Z:
+        {
+            glm::vec3 position = lights->position(i);
+            position[targetProperty[track] - ANIM_LIGHT_POS_X] = value;
+            lights->setPosition(i, position);
+            return;
+        }
+        case ANIM_LIGHT_COLOR_R:
+        case ANIM_LIGHT_COLOR_G:
+        case ANIM_LIGHT_COLOR_B:
+        {
+            glm::vec3 color = lights->color(i);
+            color[targetProperty[track] - ANIM_LIGHT_COLOR_R] = value;
+            lights->setColor(i, color);
+            return;
+        }
+        }
+    }
+};
+#endif
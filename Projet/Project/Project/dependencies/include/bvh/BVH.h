@@ -0,0 +1,557 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <mesh/mesh.h>
+#include <jobs/JobSystem.h>
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+// leaves hold at most this many objects
+const unsigned int BVH_LEAF_SIZE = 4;
+// refit keeps the tree until its SAH cost grew by this factor since the last build, then rebuilds
+const float BVH_REBUILD_RATIO = 2.0f;
+// batches smaller than this are queried on the calling thread
+const unsigned int BVH_PARALLEL_THRESHOLD = 64;
+// nodes the traversal stack holds in place, deeper trees spill to the heap
+const unsigned int BVH_STACK_SIZE = 128;
+const unsigned int BVH_NO_NODE = 0xffffffffu;
+
+struct BVHBox {
+    glm::vec3 min, max;
+};
+
+struct BVHSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// planes a, b, c, d with the normal pointing inside, as Camera::FrustumPlanes
+struct BVHFrustum {
+    glm::vec4 planes[6];
+};
+
+struct BVHRay {
+    glm::vec3 origin, direction;
+    float maxT;
+};
+
+// object whose box a ray enters at distance t
+struct BVHHit {
+    unsigned int object;
+    float t;
+};
+
+// stack of the nodes left to visit by a traversal
+class BVHStack
+{
+public:
+    BVHStack() : top(0)
+    {
+    }
+
+    bool empty() const
+    {
+        return top == 0 && spill.empty();
+    }
+
+    void push(unsigned int node)
+    {
+        if (top < BVH_STACK_SIZE)
+            nodes[top++] = node;
+        else
+            spill.push_back(node);
+    }
+
+    // the spilled nodes are the most recent ones
+    unsigned int pop()
+    {
+        if (!spill.empty())
+        {
+            unsigned int node = spill.back();
+            spill.pop_back();
+            return node;
+        }
+        return nodes[--top];
+    }
+
+private:
+    unsigned int nodes[BVH_STACK_SIZE];
+    unsigned int top;
+    std::vector<unsigned int> spill;
+};
+
+// Dynamic bounding volume hierarchy over the boxes of scene objects.
+// Built top down with a binned surface area heuristic. Moving objects only mark their leaf, refit() then updates
+// the boxes bottom up from those leaves and stops as soon as a box does not change; the tree is rebuilt when inserts,
+// removals or accumulated refits made it too loose. Queries do not modify the tree and can run from several threads
+// at once, as long as no update or refit runs at the same time.
+class BVH
+{
+public:
+    BVH() : dirtyStructure(false), builtCost(0.0f), cost(0.0f)
+    {
+    }
+
+    // adds an object, returns its id. The tree is rebuilt on the next refit.
+    unsigned int insert(const Bounds& bounds)
+    {
+        unsigned int id;
+        if (!freeIds.empty())
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        else
+        {
+            id = (unsigned int)boxes.size();
+            boxes.push_back(BVHBox());
+            leafOf.push_back(BVH_NO_NODE);
+            alive.push_back(0);
+        }
+        boxes[id].min = bounds.min;
+        boxes[id].max = bounds.max;
+        alive[id] = 1;
+        dirtyStructure = true;
+        return id;
+    }
+
+    void remove(unsigned int id)
+    {
+        alive[id] = 0;
+        freeIds.push_back(id);
+        dirtyStructure = true;
+    }
+
+    // new bounds of a moving object, applied to the tree by the next refit
+    void update(unsigned int id, const Bounds& bounds)
+    {
+        boxes[id].min = bounds.min;
+        boxes[id].max = bounds.max;
+        unsigned int leaf = leafOf[id];
+        if (leaf != BVH_NO_NODE && !nodeDirty[leaf])
+        {
+            nodeDirty[leaf] = 1;
+            dirtyLeaves.push_back(leaf);
+        }
+    }
+
+    // applies the updates since the last call, returns true when the tree had to be rebuilt
+    bool refit()
+    {
+        if (dirtyStructure || nodes.empty())
+        {
+            build();
+            return true;
+        }
+        for (unsigned int k = 0; k < dirtyLeaves.size(); k++)
+        {
+            unsigned int index = dirtyLeaves[k];
+            nodeDirty[index] = 0;
+            if (!fitLeaf(index))
+                continue;
+            // walk up while the boxes keep changing
+            for (unsigned int p = parents[index]; p != BVH_NO_NODE; p = parents[p])
+                if (!fitInner(p))
+                    break;
+        }
+        dirtyLeaves.clear();
+        if (cost > builtCost * BVH_REBUILD_RATIO)
+        {
+            build();
+            return true;
+        }
+        return false;
+    }
+
+    // full top down rebuild
+    void build()
+    {
+        nodes.clear();
+        parents.clear();
+        order.clear();
+        centroids.resize(boxes.size());
+        for (unsigned int i = 0; i < boxes.size(); i++)
+        {
+            leafOf[i] = BVH_NO_NODE;
+            if (!alive[i])
+                continue;
+            order.push_back(i);
+            centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+        }
+        dirtyLeaves.clear();
+        dirtyStructure = false;
+        cost = 0.0f;
+        if (!order.empty())
+        {
+            nodes.reserve(order.size() * 2 / BVH_LEAF_SIZE + 1);
+            nodes.push_back(Node());
+            parents.push_back(BVH_NO_NODE);
+            nodes[0].first = 0;
+            nodes[0].count = (unsigned int)order.size();
+            subdivide(0);
+        }
+        nodeDirty.assign(nodes.size(), 0);
+        builtCost = cost;
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)order.size();
+    }
+
+    unsigned int nodeCount() const
+    {
+        return (unsigned int)nodes.size();
+    }
+
+    const BVHBox& box(unsigned int id) const
+    {
+        return boxes[id];
+    }
+
+    // objects whose box overlaps the box
+    void query(const BVHBox& q, std::vector<unsigned int>& out) const
+    {
+        traverse(out, [&q](glm::vec3 bmin, glm::vec3 bmax) {
+            return overlap(bmin, bmax, q.min, q.max) ? 1 : 0;
+        });
+    }
+
+    // objects whose box overlaps the sphere
+    void query(const BVHSphere& q, std::vector<unsigned int>& out) const
+    {
+        float r2 = q.radius * q.radius;
+        traverse(out, [&q, r2](glm::vec3 bmin, glm::vec3 bmax) {
+            glm::vec3 d = q.center - glm::clamp(q.center, bmin, bmax);
+            return glm::dot(d, d) <= r2 ? 1 : 0;
+        });
+    }
+
+    // objects whose box is inside or intersects the frustum, subtrees fully inside are taken without further tests
+    void query(const BVHFrustum& q, std::vector<unsigned int>& out) const
+    {
+        traverse(out, [&q](glm::vec3 bmin, glm::vec3 bmax) {
+            int result = 2;
+            for (int p = 0; p < 6; p++)
+            {
+                glm::vec3 n = glm::vec3(q.planes[p]);
+                // corners furthest along and against the normal
+                glm::vec3 positive = glm::mix(bmin, bmax, glm::vec3(glm::greaterThan(n, glm::vec3(0.0f))));
+                glm::vec3 negative = glm::mix(bmax, bmin, glm::vec3(glm::greaterThan(n, glm::vec3(0.0f))));
+                if (glm::dot(n, positive) + q.planes[p].w < 0.0f)
+                    return 0;
+                if (glm::dot(n, negative) + q.planes[p].w < 0.0f)
+                    result = 1;
+            }
+            return result;
+        });
+    }
+
+    // objects whose box the ray enters before maxT, sorted by distance
+    void query(const BVHRay& q, std::vector<BVHHit>& out) const
+    {
+        out.clear();
+        if (nodes.empty())
+            return;
+        glm::vec3 invDir = 1.0f / q.direction;
+        BVHStack stack;
+        stack.push(0);
+        while (!stack.empty())
+        {
+            const Node& node = nodes[stack.pop()];
+            float t;
+            if (!hitBox(node.bmin, node.bmax, q.origin, invDir, q.maxT, t))
+                continue;
+            if (node.count > 0)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                {
+                    const BVHBox& b = boxes[order[i]];
+                    if (hitBox(b.min, b.max, q.origin, invDir, q.maxT, t))
+                    {
+                        BVHHit hit = { order[i], t };
+                        out.push_back(hit);
+                    }
+                }
+            }
+            else
+            {
+                stack.push(node.first);
+                stack.push(node.first + 1);
+            }
+        }
+        std::sort(out.begin(), out.end(), [](const BVHHit& a, const BVHHit& b) { return a.t < b.t; });
+    }
+
+    // runs many queries of one kind, split across the job system when the batch is large enough
+    template <typename Query, typename Result>
+    void queryBatch(const std::vector<Query>& queries, std::vector<std::vector<Result> >& results) const
+    {
+        unsigned int n = (unsigned int)queries.size();
+        results.resize(n);
+        auto kernel = [this, &queries, &results](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+                query(queries[i], results[i]);
+        };
+        if (n < BVH_PARALLEL_THRESHOLD)
+        {
+            kernel(0, n);
+            return;
+        }
+        JobSystem::instance().parallelFor(n, 1, kernel, "BVH queries");
+    }
+
+private:
+    struct Node {
+        glm::vec3 bmin, bmax;
+        unsigned int first; // first entry of order for leaves, left child for inner nodes
+        unsigned int count; // 0 for inner nodes
+    };
+
+    // per object id
+    std::vector<BVHBox> boxes;
+    std::vector<unsigned int> leafOf;
+    std::vector<unsigned char> alive;
+    std::vector<glm::vec3> centroids;
+    std::vector<unsigned int> freeIds;
+
+    // tree
+    std::vector<Node> nodes;
+    std::vector<unsigned int> parents;
+    std::vector<unsigned int> order;
+    std::vector<unsigned char> nodeDirty;
+    std::vector<unsigned int> dirtyLeaves;
+    bool dirtyStructure;
+    // sum of the inner node areas, kept up to date by refit
+    float builtCost;
+    float cost;
+
+    static float area(glm::vec3 bmin, glm::vec3 bmax)
+    {
+        glm::vec3 e = bmax - bmin;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    static bool overlap(glm::vec3 amin, glm::vec3 amax, glm::vec3 bmin, glm::vec3 bmax)
+    {
+        return amin.x <= bmax.x && amax.x >= bmin.x && amin.y <= bmax.y && amax.y >= bmin.y && amin.z <= bmax.z && amax.z >= bmin.z;
+    }
+
+    static bool hitBox(glm::vec3 bmin, glm::vec3 bmax, glm::vec3 origin, glm::vec3 invDir, float tMax, float& enter)
+    {
+        glm::vec3 t0 = (bmin - origin) * invDir;
+        glm::vec3 t1 = (bmax - origin) * invDir;
+        glm::vec3 tmin = glm::min(t0, t1), tmax = glm::max(t0, t1);
+        enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+        float exit = std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, tMax));
+        return enter <= exit;
+    }
+
+    // test(bmin, bmax) returns 0 to skip a node, 1 to keep testing below it, 2 to take its whole subtree
+    template <typename Test>
+    void traverse(std::vector<unsigned int>& out, Test test) const
+    {
+        out.clear();
+        if (nodes.empty())
+            return;
+        BVHStack stack;
+        stack.push(0);
+        while (!stack.empty())
+        {
+            unsigned int index = stack.pop();
+            const Node& node = nodes[index];
+            int result = test(node.bmin, node.bmax);
+            if (result == 0)
+                continue;
+            if (result == 2)
+            {
+                collect(index, out);
+                continue;
+            }
+            if (node.count > 0)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                {
+                    const BVHBox& b = boxes[order[i]];
+                    if (test(b.min, b.max) != 0)
+                        out.push_back(order[i]);
+                }
+            }
+            else
+            {
+                stack.push(node.first);
+                stack.push(node.first + 1);
+            }
+        }
+    }
+
+    // every object below a node
+    void collect(unsigned int index, std::vector<unsigned int>& out) const
+    {
+        BVHStack stack;
+        stack.push(index);
+        while (!stack.empty())
+        {
+            const Node& node = nodes[stack.pop()];
+            if (node.count > 0)
+                out.insert(out.end(), order.begin() + node.first, order.begin() + node.first + node.count);
+            else
+            {
+                stack.push(node.first);
+                stack.push(node.first + 1);
+            }
+        }
+    }
+
+    // recomputes a leaf box from its objects, returns true if it changed
+    bool fitLeaf(unsigned int index)
+    {
+        Node& node = nodes[index];
+        glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX);
+        for (unsigned int i = node.first; i < node.first + node.count; i++)
+        {
+            bmin = glm::min(bmin, boxes[order[i]].min);
+            bmax = glm::max(bmax, boxes[order[i]].max);
+        }
+        if (bmin == node.bmin && bmax == node.bmax)
+            return false;
+        node.bmin = bmin;
+        node.bmax = bmax;
+        return true;
+    }
+
+    // recomputes an inner node box from its children, returns true if it changed
+    bool fitInner(unsigned int index)
+    {
+        Node& node = nodes[index];
+        const Node& left = nodes[node.first];
+        const Node& right = nodes[node.first + 1];
+        glm::vec3 bmin = glm::min(left.bmin, right.bmin);
+        glm::vec3 bmax = glm::max(left.bmax, right.bmax);
+        if (bmin == node.bmin && bmax == node.bmax)
+            return false;
+        cost += area(bmin, bmax) - area(node.bmin, node.bmax);
+        node.bmin = bmin;
+        node.bmax = bmax;
+        return true;
+    }
+
+    void makeLeaf(unsigned int index)
+    {
+        const Node& node = nodes[index];
+        for (unsigned int i = node.first; i < node.first + node.count; i++)
+            leafOf[order[i]] = index;
+    }
+
+    void subdivide(unsigned int index)
+    {
+        const int BINS = 12;
+        Node& node = nodes[index];
+        node.bmin = glm::vec3(FLT_MAX);
+        node.bmax = glm::vec3(-FLT_MAX);
+        glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+        for (unsigned int i = node.first; i < node.first + node.count; i++)
+        {
+            const BVHBox& b = boxes[order[i]];
+            node.bmin = glm::min(node.bmin, b.min);
+            node.bmax = glm::max(node.bmax, b.max);
+            cmin = glm::min(cmin, centroids[order[i]]);
+            cmax = glm::max(cmax, centroids[order[i]]);
+        }
+        if (node.count <= BVH_LEAF_SIZE)
+        {
+            makeLeaf(index);
+            return;
+        }
+
+        // evaluate the SAH on a few bins along every axis, with prefix and suffix sweeps over the bins
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        float bestSplit = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = cmax[axis] - cmin[axis];
+            if (extent <= 0.0f)
+                continue;
+            glm::vec3 binMin[BINS], binMax[BINS];
+            unsigned int binCount[BINS] = { 0 };
+            for (int b = 0; b < BINS; b++)
+            {
+                binMin[b] = glm::vec3(FLT_MAX);
+                binMax[b] = glm::vec3(-FLT_MAX);
+            }
+            float scale = BINS / extent;
+            for (unsigned int i = node.first; i < node.first + node.count; i++)
+            {
+                const BVHBox& box = boxes[order[i]];
+                int b = std::min(BINS - 1, (int)((centroids[order[i]][axis] - cmin[axis]) * scale));
+                binCount[b]++;
+                binMin[b] = glm::min(binMin[b], box.min);
+                binMax[b] = glm::max(binMax[b], box.max);
+            }
+            float leftArea[BINS];
+            unsigned int leftCount[BINS];
+            glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX);
+            unsigned int lcount = 0;
+            for (int b = 0; b < BINS - 1; b++)
+            {
+                lmin = glm::min(lmin, binMin[b]);
+                lmax = glm::max(lmax, binMax[b]);
+                lcount += binCount[b];
+                leftArea[b] = lcount ? area(lmin, lmax) : 0.0f;
+                leftCount[b] = lcount;
+            }
+            glm::vec3 rmin(FLT_MAX), rmax(-FLT_MAX);
+            unsigned int rcount = 0;
+            for (int b = BINS - 1; b > 0; b--)
+            {
+                rmin = glm::min(rmin, binMin[b]);
+                rmax = glm::max(rmax, binMax[b]);
+                rcount += binCount[b];
+                if (leftCount[b - 1] == 0 || rcount == 0)
+                    continue;
+                float splitCost = leftArea[b - 1] * leftCount[b - 1] + area(rmin, rmax) * rcount;
+                if (splitCost < bestCost)
+                {
+                    bestCost = splitCost;
+                    bestAxis = axis;
+                    bestSplit = cmin[axis] + b / scale;
+                }
+            }
+        }
+
+        unsigned int leftCount = 0;
+        if (bestAxis >= 0)
+        {
+            unsigned int* begin = &order[node.first];
+            unsigned int* middle = std::partition(begin, begin + node.count,
+                [this, bestAxis, bestSplit](unsigned int o) { return centroids[o][bestAxis] < bestSplit; });
+            leftCount = (unsigned int)(middle - begin);
+        }
+        // all centroids in one point or one bin: split in the middle so leaves stay small
+        if (leftCount == 0 || leftCount == node.count)
+            leftCount = node.count / 2;
+
+        cost += area(node.bmin, node.bmax);
+        unsigned int left = (unsigned int)nodes.size();
+        Node child;
+        child.first = node.first;
+        child.count = leftCount;
+        nodes.push_back(child);
+        child.first = nodes[index].first + leftCount;
+        child.count = nodes[index].count - leftCount;
+        nodes.push_back(child);
+        parents.push_back(index);
+        parents.push_back(index);
+        // push_back may have moved the nodes, do not use the node reference anymore
+        nodes[index].first = left;
+        nodes[index].count = 0;
+        subdivide(left);
+        subdivide(left + 1);
+    }
+};
+#endif
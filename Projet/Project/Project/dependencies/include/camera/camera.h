@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <collision/CollisionWorld.h>
+
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -21,6 +23,11 @@ const float PITCH = 0.0f;
 const float SPEED = 10.0f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+// collision capsule hanging below the eye
+const float CAPSULE_RADIUS = 0.5f;
+const float CAPSULE_HEIGHT = 0.8f;
 
 
 // An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
@@ -40,10 +47,17 @@ public:
     float MovementSpeed;
     float MouseSensitivity;
     float Zoom;
+    // frustum planes of the cached view-projection (a, b, c, d with a normal pointing inside)
+    glm::vec4 FrustumPlanes[6];
+    // geometry the camera collides with, moves freely when NULL
+    CollisionWorld* World;
+    CollisionCapsule Capsule;
 
     // constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), World(NULL), Aspect(1.0f), version(0), viewValid(false), projectionValid(false)
     {
+        Capsule.radius = CAPSULE_RADIUS;
+        Capsule.height = CAPSULE_HEIGHT;
         Position = position;
         WorldUp = up;
         Yaw = yaw;
@@ -51,8 +65,10 @@ public:
         updateCameraVectors();
     }
     // constructor with scalar values
-    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), World(NULL), Aspect(1.0f), version(0), viewValid(false), projectionValid(false)
     {
+        Capsule.radius = CAPSULE_RADIUS;
+        Capsule.height = CAPSULE_HEIGHT;
         Position = glm::vec3(posX, posY, posZ);
         WorldUp = glm::vec3(upX, upY, upZ);
         Yaw = yaw;
@@ -60,10 +76,93 @@ public:
         updateCameraVectors();
     }
 
+    // the matrices below are cached: they are only recomputed when Position, the orientation, Zoom or the viewport
+    // changed since they were last computed, and every recomputation increments the version
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    const glm::mat4& GetViewMatrix()
+    {
+        Update();
+        return view;
+    }
+
+    // returns the perspective projection used by every shader
+    const glm::mat4& GetProjectionMatrix()
+    {
+        Update();
+        return projection;
+    }
+
+    const glm::mat4& GetViewProjectionMatrix()
+    {
+        Update();
+        return viewProjection;
+    }
+
+    const glm::mat4& GetInverseViewMatrix()
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        Update();
+        return inverseView;
+    }
+
+    const glm::mat4& GetInverseProjectionMatrix()
+    {
+        Update();
+        return inverseProjection;
+    }
+
+    const glm::mat4& GetInverseViewProjectionMatrix()
+    {
+        Update();
+        return inverseViewProjection;
+    }
+
+    // changes when any cached matrix or the frustum planes changed, for the caches built on them
+    unsigned int GetVersion()
+    {
+        Update();
+        return version;
+    }
+
+    // aspect ratio of the framebuffer, a minimized window (0 height) keeps the previous one
+    void SetViewport(int width, int height)
+    {
+        if (width > 0 && height > 0)
+            Aspect = (float)width / (float)height;
+    }
+
+    float GetAspect() const
+    {
+        return Aspect;
+    }
+
+    // recomputes the cached matrices and the frustum planes if their inputs changed
+    void Update()
+    {
+        bool viewChanged = !viewValid || Position != cachedPosition || Front != cachedFront || Up != cachedUp;
+        bool projectionChanged = !projectionValid || Zoom != cachedZoom || Aspect != cachedAspect;
+        if (!viewChanged && !projectionChanged)
+            return;
+        if (viewChanged)
+        {
+            view = glm::lookAt(Position, Position + Front, Up);
+            inverseView = glm::inverse(view);
+            cachedPosition = Position;
+            cachedFront = Front;
+            cachedUp = Up;
+            viewValid = true;
+        }
+        if (projectionChanged)
+        {
+            projection = glm::perspective(glm::radians(Zoom), Aspect, NEAR_PLANE, FAR_PLANE);
+            inverseProjection = glm::inverse(projection);
+            cachedZoom = Zoom;
+            cachedAspect = Aspect;
+            projectionValid = true;
+        }
+        viewProjection = projection * view;
+        inverseViewProjection = inverseView * inverseProjection;
+        updateFrustumPlanes();
+        version++;
     }
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -81,20 +180,12 @@ public:
             tempPosition += Right;
 
         tempPosition.y = 0.0f;
-        tempPosition = velocity * glm::normalize(tempPosition) + Position;
+        glm::vec3 displacement = velocity * glm::normalize(tempPosition);
 
-        
-        if (tempPosition.x < 14.0 && tempPosition.x > 0.0f) {
-            if ((tempPosition.x < 5.8 || tempPosition.x > 8.7f) || (tempPosition.z > -5.3 || tempPosition.z < -8.2f)) {
-                Position.x = tempPosition.x;
-            }            
-        }
-        if (tempPosition.z < 0 && tempPosition.z > -14.0f) {
-            if ((tempPosition.x < 5.8 || tempPosition.x > 8.7f) || (tempPosition.z > -5.3 || tempPosition.z < -8.2f)) {
-                Position.z = tempPosition.z;
-            }
-        }
-        
+        if (World)
+            Position = World->move(Capsule, Position, displacement);
+        else
+            Position += displacement;
     }
 
     glm::vec3 getPosition() {
@@ -123,6 +214,14 @@ public:
         updateCameraVectors();
     }
 
+    // points the camera with Euler angles in degrees, e.g. from a camera path
+    void SetOrientation(float yaw, float pitch)
+    {
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
@@ -134,6 +233,30 @@ public:
     }
 
 private:
+    float Aspect;
+
+    // cached matrices and the inputs they were computed from
+    glm::mat4 view, projection, viewProjection;
+    glm::mat4 inverseView, inverseProjection, inverseViewProjection;
+    glm::vec3 cachedPosition, cachedFront, cachedUp;
+    float cachedZoom, cachedAspect;
+    unsigned int version;
+    bool viewValid, projectionValid;
+
+    // extracts the 6 frustum planes from the view-projection matrix (Gribb-Hartmann)
+    void updateFrustumPlanes()
+    {
+        glm::mat4 m = glm::transpose(viewProjection);
+        FrustumPlanes[0] = m[3] + m[0]; // left
+        FrustumPlanes[1] = m[3] - m[0]; // right
+        FrustumPlanes[2] = m[3] + m[1]; // bottom
+        FrustumPlanes[3] = m[3] - m[1]; // top
+        FrustumPlanes[4] = m[3] + m[2]; // near
+        FrustumPlanes[5] = m[3] - m[2]; // far
+        for (int i = 0; i < 6; i++)
+            FrustumPlanes[i] /= glm::length(glm::vec3(FrustumPlanes[i]));
+    }
+
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
     {
@@ -0,0 +1,401 @@
+#ifndef COLLISION_WORLD_H
+#define COLLISION_WORLD_H
+
+#include <glm/glm.hpp>
+
+#include <mesh/mesh.h>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// size of a broadphase cell, about the size of the camera capsule
+const float COLLISION_CELL_SIZE = 2.0f;
+// push-out passes per substep, a corner needs 2
+const int COLLISION_ITERATIONS = 4;
+// distance kept between the capsule and the geometry
+const float COLLISION_SKIN = 0.001f;
+
+struct CollisionTriangle {
+    glm::vec3 v0, v1, v2;
+    glm::vec3 normal;
+};
+
+// Vertical capsule: the segment from base to base + height * up, inflated by radius
+struct CollisionCapsule {
+    float radius;
+    float height;
+};
+
+// Uniform grid hashed on the cell coordinates, so only the cells that hold something use memory
+// and the cost of a query only depends on the size of the queried box, not on the size of the world.
+class CollisionGrid
+{
+public:
+    CollisionGrid() : entries(0)
+    {
+    }
+
+    void insert(unsigned int id, glm::vec3 bmin, glm::vec3 bmax)
+    {
+        forCells(bmin, bmax, [this, id](int64_t key) {
+            cells[key].push_back(id);
+            entries++;
+        });
+    }
+
+    void remove(unsigned int id, glm::vec3 bmin, glm::vec3 bmax)
+    {
+        forCells(bmin, bmax, [this, id](int64_t key) {
+            std::unordered_map<int64_t, std::vector<unsigned int> >::iterator cell = cells.find(key);
+            if (cell == cells.end())
+                return;
+            std::vector<unsigned int>& ids = cell->second;
+            std::vector<unsigned int>::iterator removed = std::remove(ids.begin(), ids.end(), id);
+            entries -= ids.end() - removed;
+            ids.erase(removed, ids.end());
+            if (ids.empty())
+                cells.erase(cell);
+        });
+    }
+
+    // appends the ids of the cells overlapping the box, an id can appear several times
+    void query(glm::vec3 bmin, glm::vec3 bmax, std::vector<unsigned int>& out) const
+    {
+        forCells(bmin, bmax, [this, &out](int64_t key) {
+            std::unordered_map<int64_t, std::vector<unsigned int> >::const_iterator cell = cells.find(key);
+            if (cell != cells.end())
+                out.insert(out.end(), cell->second.begin(), cell->second.end());
+        });
+    }
+
+    // ids in all the cells, the most a query can return
+    size_t size() const
+    {
+        return entries;
+    }
+
+private:
+    std::unordered_map<int64_t, std::vector<unsigned int> > cells;
+    size_t entries;
+
+    // 21 bits per axis
+    static int64_t key(int x, int y, int z)
+    {
+        return ((int64_t)(x & 0x1fffff) << 42) | ((int64_t)(y & 0x1fffff) << 21) | (int64_t)(z & 0x1fffff);
+    }
+
+    template <typename Visit>
+    void forCells(glm::vec3 bmin, glm::vec3 bmax, Visit visit) const
+    {
+        glm::ivec3 cmin = glm::ivec3(glm::floor(bmin / COLLISION_CELL_SIZE));
+        glm::ivec3 cmax = glm::ivec3(glm::floor(bmax / COLLISION_CELL_SIZE));
+        for (int x = cmin.x; x <= cmax.x; x++)
+            for (int y = cmin.y; y <= cmax.y; y++)
+                for (int z = cmin.z; z <= cmax.z; z++)
+                    visit(key(x, y, z));
+    }
+};
+
+// Collision geometry of the scene: static triangles (walls, doors) and dynamic spheres (moving objects),
+// each kind in its own broadphase grid. A capsule is moved through it by substeps shorter than its radius,
+// each followed by a push out of the geometry along the contact normals, which makes it slide along walls.
+class CollisionWorld
+{
+public:
+    CollisionWorld() : stamp(0)
+    {
+    }
+
+    // adds every triangle of an indexed mesh transformed by model
+    template <typename VertexT>
+    void addMesh(const std::vector<VertexT>& vertices, const std::vector<unsigned int>& indices, const glm::mat4& model)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            addTriangle(glm::vec3(model * glm::vec4(vertices[indices[i]].Position, 1.0f)),
+                glm::vec3(model * glm::vec4(vertices[indices[i + 1]].Position, 1.0f)),
+                glm::vec3(model * glm::vec4(vertices[indices[i + 2]].Position, 1.0f)));
+        }
+    }
+
+    // adds the unit quad [-0.5, 0.5]^2 (z = 0) the walls and the ground are drawn with, moved by model
+    void addQuad(const glm::mat4& model)
+    {
+        glm::vec3 a = glm::vec3(model * glm::vec4(-0.5f, -0.5f, 0.0f, 1.0f));
+        glm::vec3 b = glm::vec3(model * glm::vec4(0.5f, -0.5f, 0.0f, 1.0f));
+        glm::vec3 c = glm::vec3(model * glm::vec4(0.5f, 0.5f, 0.0f, 1.0f));
+        glm::vec3 d = glm::vec3(model * glm::vec4(-0.5f, 0.5f, 0.0f, 1.0f));
+        addTriangle(a, b, c);
+        addTriangle(a, c, d);
+    }
+
+    void addTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+    {
+        CollisionTriangle t;
+        t.v0 = v0;
+        t.v1 = v1;
+        t.v2 = v2;
+        glm::vec3 n = glm::cross(v1 - v0, v2 - v0);
+        float length = glm::length(n);
+        if (length <= 0.0f)
+            return;
+        t.normal = n / length;
+        unsigned int id = (unsigned int)triangles.size();
+        triangles.push_back(t);
+        triangleStamp.push_back(0);
+        staticGrid.insert(id, glm::min(v0, glm::min(v1, v2)), glm::max(v0, glm::max(v1, v2)));
+        reserveCandidates();
+    }
+
+    // dynamic object collided as its bounding sphere, returns its id
+    unsigned int addDynamic(const Bounds& bounds)
+    {
+        unsigned int id = (unsigned int)spheres.size();
+        spheres.push_back(glm::vec4(bounds.center, bounds.radius));
+        sphereStamp.push_back(0);
+        dynamicGrid.insert(id, bounds.center - glm::vec3(bounds.radius), bounds.center + glm::vec3(bounds.radius));
+        reserveCandidates();
+        return id;
+    }
+
+    void updateDynamic(unsigned int id, const Bounds& bounds)
+    {
+        glm::vec4 old = spheres[id];
+        if (old == glm::vec4(bounds.center, bounds.radius))
+            return;
+        dynamicGrid.remove(id, glm::vec3(old) - glm::vec3(old.w), glm::vec3(old) + glm::vec3(old.w));
+        spheres[id] = glm::vec4(bounds.center, bounds.radius);
+        dynamicGrid.insert(id, bounds.center - glm::vec3(bounds.radius), bounds.center + glm::vec3(bounds.radius));
+        reserveCandidates();
+    }
+
+    // moves the capsule whose top is at position by displacement, returns where it stops
+    glm::vec3 move(const CollisionCapsule& capsule, glm::vec3 position, glm::vec3 displacement)
+    {
+        float length = glm::length(displacement);
+        // a substep never moves more than half the radius, the capsule cannot cross a thin wall between two substeps
+        int steps = std::max(1, (int)std::ceil(length / (capsule.radius * 0.5f)));
+        glm::vec3 step = displacement / (float)steps;
+        for (int s = 0; s < steps; s++)
+            position = resolve(capsule, position + step);
+        return position;
+    }
+
+    // pushes the capsule whose top is at position out of the geometry
+    glm::vec3 resolve(const CollisionCapsule& capsule, glm::vec3 position)
+    {
+        for (int iteration = 0; iteration < COLLISION_ITERATIONS; iteration++)
+        {
+            glm::vec3 top = position;
+            glm::vec3 base = position - glm::vec3(0.0f, capsule.height, 0.0f);
+            glm::vec3 bmin = glm::min(base, top) - glm::vec3(capsule.radius);
+            glm::vec3 bmax = glm::max(base, top) + glm::vec3(capsule.radius);
+
+            // deepest contact of this pass
+            float depth = 0.0f;
+            glm::vec3 normal(0.0f);
+
+            candidates.clear();
+            staticGrid.query(bmin, bmax, candidates);
+            stamp++;
+            for (unsigned int k = 0; k < candidates.size(); k++)
+            {
+                unsigned int id = candidates[k];
+                if (triangleStamp[id] == stamp)
+                    continue;
+                triangleStamp[id] = stamp;
+                const CollisionTriangle& t = triangles[id];
+                glm::vec3 onSegment, onTriangle;
+                closestSegmentTriangle(base, top, t, onSegment, onTriangle);
+                glm::vec3 d = onSegment - onTriangle;
+                float dist = glm::length(d);
+                if (dist >= capsule.radius)
+                    continue;
+                // the segment touches the triangle: push out on the side of the capsule's top
+                glm::vec3 n = dist > 1e-6f ? d / dist : (glm::dot(top - t.v0, t.normal) >= 0.0f ? t.normal : -t.normal);
+                if (capsule.radius - dist > depth)
+                {
+                    depth = capsule.radius - dist;
+                    normal = n;
+                }
+            }
+
+            candidates.clear();
+            dynamicGrid.query(bmin, bmax, candidates);
+            for (unsigned int k = 0; k < candidates.size(); k++)
+            {
+                unsigned int id = candidates[k];
+                if (sphereStamp[id] == stamp)
+                    continue;
+                sphereStamp[id] = stamp;
+                glm::vec3 center = glm::vec3(spheres[id]);
+                glm::vec3 d = closestOnSegment(base, top, center) - center;
+                float dist = glm::length(d);
+                float reach = capsule.radius + spheres[id].w;
+                // a radius of 0 disables the object
+                if (spheres[id].w <= 0.0f || dist >= reach || dist <= 1e-6f)
+                    continue;
+                if (reach - dist > depth)
+                {
+                    depth = reach - dist;
+                    normal = d / dist;
+                }
+            }
+
+            if (depth <= 0.0f)
+                break;
+            position += normal * (depth + COLLISION_SKIN);
+        }
+        return position;
+    }
+
+    unsigned int triangleCount() const
+    {
+        return (unsigned int)triangles.size();
+    }
+
+private:
+    std::vector<CollisionTriangle> triangles;
+    std::vector<glm::vec4> spheres; // center, radius
+    CollisionGrid staticGrid;
+    CollisionGrid dynamicGrid;
+    // a grid query returns an object once per cell, the stamps keep only the first
+    std::vector<unsigned int> triangleStamp;
+    std::vector<unsigned int> sphereStamp;
+    unsigned int stamp;
+    std::vector<unsigned int> candidates;
+
+    // a query returns at most every id of a grid: with that much room, moving never allocates
+    void reserveCandidates()
+    {
+        size_t needed = std::max(staticGrid.size(), dynamicGrid.size());
+        if (needed > candidates.capacity())
+            candidates.reserve(std::max(needed, candidates.capacity() * 2));
+    }
+
+    static glm::vec3 closestOnSegment(glm::vec3 a, glm::vec3 b, glm::vec3 p)
+    {
+        glm::vec3 ab = b - a;
+        float length2 = glm::dot(ab, ab);
+        float t = length2 > 0.0f ? glm::clamp(glm::dot(p - a, ab) / length2, 0.0f, 1.0f) : 0.0f;
+        return a + ab * t;
+    }
+
+    // closest point of a triangle to p (Ericson, Real-Time Collision Detection 5.1.5)
+    static glm::vec3 closestOnTriangle(glm::vec3 p, const CollisionTriangle& t)
+    {
+        glm::vec3 ab = t.v1 - t.v0, ac = t.v2 - t.v0, ap = p - t.v0;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return t.v0;
+        glm::vec3 bp = p - t.v1;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return t.v1;
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return t.v0 + ab * (d1 / (d1 - d3));
+        glm::vec3 cp = p - t.v2;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return t.v2;
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return t.v0 + ac * (d2 / (d2 - d6));
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return t.v1 + (t.v2 - t.v1) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        float denom = 1.0f / (va + vb + vc);
+        return t.v0 + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    // closest points of the segments p1 q1 and p2 q2
+    static void closestSegmentSegment(glm::vec3 p1, glm::vec3 q1, glm::vec3 p2, glm::vec3 q2, glm::vec3& c1, glm::vec3& c2)
+    {
+        glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+        float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+        float s = 0.0f, t = 0.0f;
+        if (a <= 1e-12f && e <= 1e-12f)
+        {
+            c1 = p1;
+            c2 = p2;
+            return;
+        }
+        if (a <= 1e-12f)
+            t = glm::clamp(f / e, 0.0f, 1.0f);
+        else
+        {
+            float c = glm::dot(d1, r);
+            if (e <= 1e-12f)
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            else
+            {
+                float b = glm::dot(d1, d2);
+                float denom = a * e - b * b;
+                s = denom != 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+                t = (b * s + f) / e;
+                if (t < 0.0f)
+                {
+                    t = 0.0f;
+                    s = glm::clamp(-c / a, 0.0f, 1.0f);
+                }
+                else if (t > 1.0f)
+                {
+                    t = 1.0f;
+                    s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+                }
+            }
+        }
+        c1 = p1 + d1 * s;
+        c2 = p2 + d2 * t;
+    }
+
+    // closest points of the segment a b and a triangle
+    static void closestSegmentTriangle(glm::vec3 a, glm::vec3 b, const CollisionTriangle& t, glm::vec3& onSegment, glm::vec3& onTriangle)
+    {
+        // segment crossing the triangle
+        float da = glm::dot(a - t.v0, t.normal);
+        float db = glm::dot(b - t.v0, t.normal);
+        if ((da <= 0.0f && db >= 0.0f) || (da >= 0.0f && db <= 0.0f))
+        {
+            float f = da != db ? da / (da - db) : 0.0f;
+            glm::vec3 p = a + (b - a) * f;
+            glm::vec3 q = closestOnTriangle(p, t);
+            if (glm::dot(p - q, p - q) <= 1e-12f)
+            {
+                onSegment = p;
+                onTriangle = q;
+                return;
+            }
+        }
+        // otherwise the closest points are on an end of the segment or on an edge of the triangle
+        onSegment = a;
+        onTriangle = closestOnTriangle(a, t);
+        float best = glm::dot(onSegment - onTriangle, onSegment - onTriangle);
+        glm::vec3 q = closestOnTriangle(b, t);
+        float dist = glm::dot(b - q, b - q);
+        if (dist < best)
+        {
+            best = dist;
+            onSegment = b;
+            onTriangle = q;
+        }
+        const glm::vec3 edges[3][2] = { { t.v0, t.v1 }, { t.v1, t.v2 }, { t.v2, t.v0 } };
+        for (int e = 0; e < 3; e++)
+        {
+            glm::vec3 c1, c2;
+            closestSegmentSegment(a, b, edges[e][0], edges[e][1], c1, c2);
+            dist = glm::dot(c1 - c2, c1 - c2);
+            if (dist < best)
+            {
+                best = dist;
+                onSegment = c1;
+                onTriangle = c2;
+            }
+        }
+    }
+};
+#endif
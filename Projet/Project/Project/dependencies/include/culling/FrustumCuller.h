@@ -0,0 +1,205 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <mesh/mesh.h>
+#include <model/model.h>
+
+#include <vector>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE 1
+#endif
+
+// Frustum culling of every object submitted in a frame.
+// Objects are gathered as structure-of-arrays of world-space spheres and boxes, then culled 4 at a time:
+// the sphere test rejects or fully accepts most objects, only the ones straddling a plane get the tighter box test.
+class FrustumCuller
+{
+public:
+    // counters of the last cull()
+    unsigned int tested;
+    unsigned int culled;
+    unsigned int drawn;
+
+    FrustumCuller() : tested(0), culled(0), drawn(0), count(0)
+    {
+    }
+
+    // makes room for n objects per frame, so the frames never grow the arrays
+    void reserve(unsigned int n)
+    {
+        unsigned int padded = (n + 3) & ~3u;
+        if (padded > sphereX.size())
+            resize(padded);
+        visible.reserve(padded);
+        straddling.reserve(padded);
+    }
+
+    // clears the objects of the previous frame
+    void begin()
+    {
+        count = 0;
+    }
+
+    // adds an object by its world-space bounds, returns its index in the visibility array
+    unsigned int add(const Bounds& world)
+    {
+        unsigned int i = count++;
+        if (count > sphereX.size())
+            resize((count + 3) & ~3u);
+        sphereX[i] = world.center.x; sphereY[i] = world.center.y; sphereZ[i] = world.center.z;
+        sphereR[i] = world.radius;
+        minX[i] = world.min.x; minY[i] = world.min.y; minZ[i] = world.min.z;
+        maxX[i] = world.max.x; maxY[i] = world.max.y; maxZ[i] = world.max.z;
+        return i;
+    }
+
+    // adds every mesh of a model instance, returns the index of the first mesh
+    unsigned int addModel(const Model& model, const glm::mat4& transform)
+    {
+        unsigned int first = count;
+        for (unsigned int i = 0; i < model.meshes.size(); i++)
+            add(transformBounds(model.meshes[i].bounds, transform));
+        return first;
+    }
+
+    // culls all the objects added since begin() against planes pointing inside the frustum
+    void cull(const glm::vec4 planes[6])
+    {
+        unsigned int padded = (count + 3) & ~3u;
+        visible.assign(padded, 0);
+        straddling.assign(padded, 0);
+        for (unsigned int block = 0; block < padded; block += 4)
+            cullSpheres(planes, block);
+        for (unsigned int block = 0; block < padded; block += 4)
+        {
+            if (straddling[block] | straddling[block + 1] | straddling[block + 2] | straddling[block + 3])
+                cullBoxes(planes, block);
+        }
+
+        tested = count;
+        drawn = 0;
+        for (unsigned int i = 0; i < count; i++)
+            drawn += visible[i];
+        culled = tested - drawn;
+    }
+
+    bool isVisible(unsigned int i) const
+    {
+        return visible[i] != 0;
+    }
+
+    // visibility of the objects starting at first, e.g. for Model::Draw(shader, visible)
+    const unsigned char* visibility(unsigned int first) const
+    {
+        return &visible[first];
+    }
+
+    // true if any of the n objects starting at first is visible
+    bool anyVisible(unsigned int first, unsigned int n) const
+    {
+        for (unsigned int i = first; i < first + n; i++)
+            if (visible[i])
+                return true;
+        return false;
+    }
+
+private:
+    unsigned int count;
+    std::vector<float> sphereX, sphereY, sphereZ, sphereR;
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<unsigned char> visible;
+    std::vector<unsigned char> straddling;
+
+    void resize(unsigned int n)
+    {
+        std::vector<float>* arrays[] = { &sphereX, &sphereY, &sphereZ, &sphereR, &minX, &minY, &minZ, &maxX, &maxY, &maxZ };
+        for (std::vector<float>* a : arrays)
+            a->resize(n, 0.0f);
+    }
+
+    // visible = inside or intersecting every plane, straddling = intersecting at least one
+    void cullSpheres(const glm::vec4 planes[6], unsigned int block)
+    {
+#ifdef FRUSTUM_CULLER_SSE
+        __m128 x = _mm_loadu_ps(&sphereX[block]);
+        __m128 y = _mm_loadu_ps(&sphereY[block]);
+        __m128 z = _mm_loadu_ps(&sphereZ[block]);
+        __m128 r = _mm_loadu_ps(&sphereR[block]);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+        __m128 outside = _mm_setzero_ps();
+        __m128 cut = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p].x)), _mm_mul_ps(y, _mm_set1_ps(planes[p].y))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(planes[p].z)), _mm_set1_ps(planes[p].w)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negR));
+            cut = _mm_or_ps(cut, _mm_cmplt_ps(d, r));
+        }
+        int outsideMask = _mm_movemask_ps(outside);
+        int cutMask = _mm_movemask_ps(cut);
+        for (int k = 0; k < 4; k++)
+        {
+            visible[block + k] = (outsideMask >> k) & 1 ? 0 : 1;
+            straddling[block + k] = visible[block + k] && ((cutMask >> k) & 1);
+        }
+#else
+        for (unsigned int i = block; i < block + 4; i++)
+        {
+            bool outside = false, cut = false;
+            for (int p = 0; p < 6; p++)
+            {
+                float d = planes[p].x * sphereX[i] + planes[p].y * sphereY[i] + planes[p].z * sphereZ[i] + planes[p].w;
+                outside = outside || d < -sphereR[i];
+                cut = cut || d < sphereR[i];
+            }
+            visible[i] = outside ? 0 : 1;
+            straddling[i] = !outside && cut;
+        }
+#endif
+    }
+
+    // box test of the straddling objects: outside when the corner furthest along a plane normal is behind it
+    void cullBoxes(const glm::vec4 planes[6], unsigned int block)
+    {
+#ifdef FRUSTUM_CULLER_SSE
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            // the corner only depends on the sign of the normal, so the selection is per plane, not per object
+            __m128 px = _mm_loadu_ps(planes[p].x > 0.0f ? &maxX[block] : &minX[block]);
+            __m128 py = _mm_loadu_ps(planes[p].y > 0.0f ? &maxY[block] : &minY[block]);
+            __m128 pz = _mm_loadu_ps(planes[p].z > 0.0f ? &maxZ[block] : &minZ[block]);
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(planes[p].x)), _mm_mul_ps(py, _mm_set1_ps(planes[p].y))),
+                _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(planes[p].z)), _mm_set1_ps(planes[p].w)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+        }
+        int outsideMask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; k++)
+            if (straddling[block + k] && ((outsideMask >> k) & 1))
+                visible[block + k] = 0;
+#else
+        for (unsigned int i = block; i < block + 4; i++)
+        {
+            if (!straddling[i])
+                continue;
+            for (int p = 0; p < 6; p++)
+            {
+                float px = planes[p].x > 0.0f ? maxX[i] : minX[i];
+                float py = planes[p].y > 0.0f ? maxY[i] : minY[i];
+                float pz = planes[p].z > 0.0f ? maxZ[i] : minZ[i];
+                if (planes[p].x * px + planes[p].y * py + planes[p].z * pz + planes[p].w < 0.0f)
+                {
+                    visible[i] = 0;
+                    break;
+                }
+            }
+        }
+#endif
+    }
+};
+#endif
@@ -0,0 +1,381 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+
+const uint32_t INPUT_FILE_MAGIC = 0x54555049; // "IPUT"
+const uint32_t INPUT_FILE_VERSION = 1;
+// camera paths are sampled at this step, whatever the real frame time
+const float INPUT_PATH_TIMESTEP = 1.0f / 60.0f;
+// keys are stored as one bit each in a frame
+const unsigned int INPUT_MAX_KEYS = 32;
+
+// What drives the frames
+enum Input_Mode {
+    INPUT_LIVE,     // GLFW, nothing recorded
+    INPUT_RECORD,   // GLFW, every frame written to a file
+    INPUT_PLAYBACK, // frames read back from a recording
+    INPUT_PATH      // camera following an authored spline
+};
+
+enum Input_Event_Type {
+    INPUT_CURSOR,
+    INPUT_SCROLL
+};
+
+struct InputEvent {
+    uint8_t type;
+    double x, y;
+};
+
+// control point of a camera path
+struct CameraKey {
+    float time;
+    glm::vec3 position;
+    float yaw, pitch;
+};
+
+// Records and replays the input of every frame so benchmarks run on exactly the same frames.
+// A frame stores its time, its deltaTime, the state of the keys polled during it and the cursor and scroll events
+// GLFW delivered since the end of the previous frame. Playback feeds all of this back instead of GLFW, so the simulation sees the same
+// values whatever the real frame time is. A camera path replaces the input with a Catmull-Rom spline sampled at a
+// fixed step. In both replay modes the real frame times are collected and summarized when the replay ends.
+class InputRecorder
+{
+public:
+    InputRecorder() : mode(INPUT_LIVE), frame(0), pathTime(0.0f)
+    {
+    }
+
+    ~InputRecorder()
+    {
+        close();
+    }
+
+    bool record(const std::string& _path)
+    {
+        path = _path;
+        mode = INPUT_RECORD;
+        return true;
+    }
+
+    bool play(const std::string& _path)
+    {
+        std::ifstream file(_path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            std::cout << "Input recording not found: " << _path << std::endl;
+            return false;
+        }
+        file.seekg(0, std::ios::end);
+        uint64_t fileSize = (uint64_t)file.tellg();
+        file.seekg(0, std::ios::beg);
+        uint32_t header[4];
+        file.read((char*)header, sizeof(header));
+        if (!file || header[0] != INPUT_FILE_MAGIC || header[1] != INPUT_FILE_VERSION || header[2] > INPUT_MAX_KEYS)
+        {
+            std::cout << "Invalid input recording: " << _path << std::endl;
+            return false;
+        }
+        keys.resize(header[2]);
+        if (!keys.empty())
+            file.read((char*)keys.data(), keys.size() * sizeof(int));
+        // the counts come from the file: nothing is allocated for more records than the rest of it can hold
+        const uint64_t frameBytes = sizeof(double) + sizeof(float) + 2 * sizeof(uint32_t);
+        const uint64_t eventBytes = sizeof(uint8_t) + 2 * sizeof(double);
+        bool truncated = !file || header[3] * frameBytes > fileSize - (uint64_t)file.tellg();
+        if (!truncated)
+            frames.resize(header[3]);
+        for (unsigned int f = 0; f < frames.size() && file; f++)
+        {
+            uint32_t count;
+            file.read((char*)&frames[f].time, sizeof(double));
+            file.read((char*)&frames[f].deltaTime, sizeof(float));
+            file.read((char*)&frames[f].keys, sizeof(uint32_t));
+            file.read((char*)&count, sizeof(count));
+            if (!file || count * eventBytes > fileSize - (uint64_t)file.tellg())
+            {
+                truncated = true;
+                break;
+            }
+            frames[f].events.resize(count);
+            for (unsigned int e = 0; e < count && file; e++)
+            {
+                file.read((char*)&frames[f].events[e].type, sizeof(uint8_t));
+                file.read((char*)&frames[f].events[e].x, sizeof(double));
+                file.read((char*)&frames[f].events[e].y, sizeof(double));
+            }
+        }
+        if (truncated || !file)
+        {
+            std::cout << "Truncated input recording: " << _path << std::endl;
+            frames.clear();
+            return false;
+        }
+        mode = INPUT_PLAYBACK;
+        std::cout << "Playing " << frames.size() << " frames from " << _path << std::endl;
+        return true;
+    }
+
+    // text file, one "time x y z yaw pitch" control point per line, '#' starts a comment
+    bool followPath(const std::string& _path)
+    {
+        std::ifstream file(_path.c_str());
+        if (!file)
+        {
+            std::cout << "Camera path not found: " << _path << std::endl;
+            return false;
+        }
+        cameraPath.clear();
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream in(line);
+            CameraKey key;
+            if (in >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+                cameraPath.push_back(key);
+        }
+        if (cameraPath.size() < 2)
+        {
+            std::cout << "A camera path needs at least 2 control points: " << _path << std::endl;
+            return false;
+        }
+        std::sort(cameraPath.begin(), cameraPath.end(), [](const CameraKey& a, const CameraKey& b) { return a.time < b.time; });
+        mode = INPUT_PATH;
+        pathTime = cameraPath[0].time;
+        return true;
+    }
+
+    Input_Mode getMode() const
+    {
+        return mode;
+    }
+
+    bool isReplaying() const
+    {
+        return mode == INPUT_PLAYBACK || mode == INPUT_PATH;
+    }
+
+    // starts a frame, realDelta is the measured frame time. Returns the deltaTime the frame must simulate.
+    float beginFrame(float realDelta)
+    {
+        if (isReplaying() && frame > 0)
+            realFrameTimes.push_back(realDelta);
+        current.keys = 0;
+        if (mode == INPUT_PLAYBACK)
+        {
+            if (frame < frames.size())
+                current = frames[frame];
+            frame++;
+            return current.deltaTime;
+        }
+        if (mode == INPUT_PATH)
+        {
+            current.deltaTime = frame == 0 ? 0.0f : INPUT_PATH_TIMESTEP;
+            pathTime += current.deltaTime;
+            current.time = pathTime;
+            frame++;
+            return current.deltaTime;
+        }
+        current.time = glfwGetTime();
+        current.deltaTime = realDelta;
+        frame++;
+        return realDelta;
+    }
+
+    // ends a frame, a recorded frame is kept until close()
+    void endFrame()
+    {
+        if (mode == INPUT_RECORD)
+        {
+            // the events GLFW delivered since the last frame ended were all consumed by this one
+            current.events.swap(pending);
+            pending.clear();
+            frames.push_back(current);
+        }
+        current.events.clear();
+    }
+
+    // true once every frame of the replay was played
+    bool finished() const
+    {
+        if (mode == INPUT_PLAYBACK)
+            return frame >= frames.size();
+        if (mode == INPUT_PATH)
+            return pathTime >= cameraPath.back().time;
+        return false;
+    }
+
+    // time of the frame, replaces glfwGetTime() in the simulation
+    double time() const
+    {
+        return current.time;
+    }
+
+    // state of a key this frame, from GLFW or from the recording
+    bool keyDown(GLFWwindow* window, int key)
+    {
+        if (mode == INPUT_PATH)
+            return false;
+        int bit = keyBit(key);
+        if (mode == INPUT_PLAYBACK)
+            return bit >= 0 && (current.keys >> bit & 1) != 0;
+        bool down = glfwGetKey(window, key) == GLFW_PRESS;
+        if (down && bit >= 0)
+            current.keys |= 1u << bit;
+        return down;
+    }
+
+    // called by the GLFW callbacks. Returns false when the event must be ignored because a replay drives the input.
+    bool cursor(double x, double y)
+    {
+        return event(INPUT_CURSOR, x, y);
+    }
+
+    bool scroll(double x, double y)
+    {
+        return event(INPUT_SCROLL, x, y);
+    }
+
+    // recorded events to dispatch at the start of this frame, empty outside of playback
+    const std::vector<InputEvent>& frameEvents() const
+    {
+        static const std::vector<InputEvent> none;
+        return mode == INPUT_PLAYBACK ? current.events : none;
+    }
+
+    // camera pose of the path at the current frame
+    void samplePath(glm::vec3& position, float& yaw, float& pitch) const
+    {
+        unsigned int i = 0;
+        while (i + 2 < cameraPath.size() && cameraPath[i + 1].time <= pathTime)
+            i++;
+        const CameraKey& k1 = cameraPath[i];
+        const CameraKey& k2 = cameraPath[i + 1];
+        const CameraKey& k0 = cameraPath[i > 0 ? i - 1 : i];
+        const CameraKey& k3 = cameraPath[i + 2 < cameraPath.size() ? i + 2 : i + 1];
+        float span = k2.time - k1.time;
+        float t = span > 0.0f ? glm::clamp((pathTime - k1.time) / span, 0.0f, 1.0f) : 1.0f;
+        position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+        glm::vec3 angles = catmullRom(glm::vec3(k0.yaw, k0.pitch, 0.0f), glm::vec3(k1.yaw, k1.pitch, 0.0f),
+            glm::vec3(k2.yaw, k2.pitch, 0.0f), glm::vec3(k3.yaw, k3.pitch, 0.0f), t);
+        yaw = angles.x;
+        pitch = glm::clamp(angles.y, -89.0f, 89.0f);
+    }
+
+    // writes the recording, or prints the frame times of a replay
+    void close()
+    {
+        if (mode == INPUT_RECORD)
+        {
+            save();
+            mode = INPUT_LIVE;
+        }
+        else if (isReplaying() && !realFrameTimes.empty())
+        {
+            std::vector<float> sorted = realFrameTimes;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0.0;
+            for (unsigned int k = 0; k < sorted.size(); k++)
+                total += sorted[k];
+            std::cout << "Replayed " << sorted.size() << " frames: average " << 1000.0 * total / sorted.size()
+                << " ms, min " << 1000.0f * sorted.front() << " ms, 99th percentile "
+                << 1000.0f * sorted[(sorted.size() - 1) * 99 / 100] << " ms, max " << 1000.0f * sorted.back() << " ms" << std::endl;
+            realFrameTimes.clear();
+        }
+    }
+
+private:
+    struct Frame {
+        double time;
+        float deltaTime;
+        uint32_t keys; // bit k set when keys[k] is down
+        std::vector<InputEvent> events;
+
+        Frame() : time(0.0), deltaTime(0.0f), keys(0)
+        {
+        }
+    };
+
+    Input_Mode mode;
+    std::string path;
+    std::vector<int> keys;
+    std::vector<Frame> frames;
+    std::vector<InputEvent> pending;
+    Frame current;
+    unsigned int frame;
+    std::vector<CameraKey> cameraPath;
+    float pathTime;
+    std::vector<float> realFrameTimes;
+
+    // bit of a key, assigned the first time the key is polled while recording
+    int keyBit(int key)
+    {
+        for (unsigned int k = 0; k < keys.size(); k++)
+            if (keys[k] == key)
+                return (int)k;
+        if (mode != INPUT_RECORD || keys.size() >= INPUT_MAX_KEYS)
+            return -1;
+        keys.push_back(key);
+        return (int)keys.size() - 1;
+    }
+
+    bool event(uint8_t type, double x, double y)
+    {
+        if (isReplaying())
+            return false;
+        if (mode == INPUT_RECORD)
+        {
+            InputEvent e = { type, x, y };
+            pending.push_back(e);
+        }
+        return true;
+    }
+
+    static glm::vec3 catmullRom(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, float t)
+    {
+        float t2 = t * t, t3 = t2 * t;
+        return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+
+    void save() const
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            std::cout << "Input recording could not be written to " << path << std::endl;
+            return;
+        }
+        uint32_t header[4] = { INPUT_FILE_MAGIC, INPUT_FILE_VERSION, (uint32_t)keys.size(), (uint32_t)frames.size() };
+        file.write((const char*)header, sizeof(header));
+        if (!keys.empty())
+            file.write((const char*)keys.data(), keys.size() * sizeof(int));
+        for (unsigned int f = 0; f < frames.size(); f++)
+        {
+            uint32_t count = (uint32_t)frames[f].events.size();
+            file.write((const char*)&frames[f].time, sizeof(double));
+            file.write((const char*)&frames[f].deltaTime, sizeof(float));
+            file.write((const char*)&frames[f].keys, sizeof(uint32_t));
+            file.write((const char*)&count, sizeof(count));
+            for (unsigned int e = 0; e < count; e++)
+            {
+                file.write((const char*)&frames[f].events[e].type, sizeof(uint8_t));
+                file.write((const char*)&frames[f].events[e].x, sizeof(double));
+                file.write((const char*)&frames[f].events[e].y, sizeof(double));
+            }
+        }
+        std::cout << "Recorded " << frames.size() << " frames to " << path << std::endl;
+    }
+};
+#endif
@@ -0,0 +1,114 @@
+#ifndef LATENCY_MONITOR_H
+#define LATENCY_MONITOR_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <algorithm>
+
+// queries in flight, results are read this many frames later at most
+const int LATENCY_QUERY_COUNT = 4;
+// the GPU clock is matched to glfwGetTime again this often, in seconds, to follow their drift
+const double LATENCY_CALIBRATION_INTERVAL = 1.0;
+
+// Measures the input latency: from the reception of an input event to the end of the GPU work of the frame that
+// used it. A GL_TIMESTAMP query is issued after the swap of each frame that consumed input and read back without
+// waiting a few frames later; the GPU time is converted to the glfwGetTime clock with an offset calibrated
+// regularly. The scan-out of the display comes after and is not included.
+class LatencyMonitor
+{
+public:
+    LatencyMonitor() : next(0), offset(0.0), calibrated(-1.0), count(0), total(0.0), worst(0.0)
+    {
+        for (int i = 0; i < LATENCY_QUERY_COUNT; i++)
+        {
+            queries[i] = 0;
+            inputTime[i] = -1.0;
+        }
+    }
+
+    // needs a current GL context
+    void init()
+    {
+        glGenQueries(LATENCY_QUERY_COUNT, queries);
+        calibrate();
+    }
+
+    // before the GL context is destroyed
+    void release()
+    {
+        if (queries[0])
+            glDeleteQueries(LATENCY_QUERY_COUNT, queries);
+        for (int i = 0; i < LATENCY_QUERY_COUNT; i++)
+        {
+            queries[i] = 0;
+            inputTime[i] = -1.0;
+        }
+    }
+
+    // after the swap of a frame, time is when its oldest input was received (-1 when the frame used no input)
+    void endFrame(double time)
+    {
+        if (!queries[0])
+            return;
+        collect();
+        if (glfwGetTime() - calibrated > LATENCY_CALIBRATION_INTERVAL)
+            calibrate();
+        if (time < 0.0 || inputTime[next] >= 0.0)
+            return; // nothing to measure, or the oldest query is still in flight
+        glQueryCounter(queries[next], GL_TIMESTAMP);
+        inputTime[next] = time;
+        next = (next + 1) % LATENCY_QUERY_COUNT;
+    }
+
+    // prints the latencies measured since the last report and starts over
+    void report()
+    {
+        if (count == 0)
+            return;
+        std::cout << "Input latency over " << count << " frames: average " << 1000.0 * total / count
+            << " ms, max " << 1000.0 * worst << " ms" << std::endl;
+        count = 0;
+        total = 0.0;
+        worst = 0.0;
+    }
+
+private:
+    GLuint queries[LATENCY_QUERY_COUNT];
+    double inputTime[LATENCY_QUERY_COUNT]; // -1 for a free query
+    int next;
+    double offset;     // glfwGetTime() - GPU time, in seconds
+    double calibrated; // glfwGetTime() of the last calibration
+    unsigned int count;
+    double total, worst;
+
+    void calibrate()
+    {
+        GLint64 gpu = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpu);
+        calibrated = glfwGetTime();
+        offset = calibrated - gpu * 1e-9;
+    }
+
+    void collect()
+    {
+        for (int i = 0; i < LATENCY_QUERY_COUNT; i++)
+        {
+            if (inputTime[i] < 0.0)
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 gpu = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &gpu);
+            double latency = std::max(0.0, gpu * 1e-9 + offset - inputTime[i]);
+            count++;
+            total += latency;
+            worst = std::max(worst, latency);
+            inputTime[i] = -1.0;
+        }
+    }
+};
+#endif
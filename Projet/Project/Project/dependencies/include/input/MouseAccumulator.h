@@ -0,0 +1,64 @@
+#ifndef MOUSE_ACCUMULATOR_H
+#define MOUSE_ACCUMULATOR_H
+
+#include <GLFW/glfw3.h>
+
+// Sums the cursor motion between two camera updates.
+// The cursor callback only adds the offset to the last position, in doubles since a disabled cursor moves without
+// bounds; the camera applies the sum once per frame, so the trigonometry of the camera vectors runs once per frame
+// instead of once per event. The time of the oldest event not consumed yet is kept to measure the input latency.
+class MouseAccumulator
+{
+public:
+    MouseAccumulator() : first(true), lastX(0.0), lastY(0.0), dx(0.0), dy(0.0), oldest(-1.0), events(0)
+    {
+    }
+
+    // raw motion skips the acceleration and scaling of the OS, only when the cursor is disabled and GLFW supports it
+    static bool enableRawMotion(GLFWwindow* window)
+    {
+        if (!glfwRawMouseMotionSupported())
+            return false;
+        glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+        return true;
+    }
+
+    // cursor position of an event, time is when it was received
+    void cursor(double x, double y, double time)
+    {
+        if (first)
+        {
+            lastX = x;
+            lastY = y;
+            first = false;
+        }
+        dx += x - lastX;
+        dy += lastY - y; // reversed since y-coordinates go from bottom to top
+        lastX = x;
+        lastY = y;
+        if (events == 0)
+            oldest = time;
+        events++;
+    }
+
+    // returns the motion since the last call and resets it. time is the reception time of its oldest event, -1 if none.
+    bool consume(float& xoffset, float& yoffset, double& time)
+    {
+        xoffset = (float)dx;
+        yoffset = (float)dy;
+        time = oldest;
+        bool moved = events > 0;
+        dx = dy = 0.0;
+        oldest = -1.0;
+        events = 0;
+        return moved;
+    }
+
+private:
+    bool first;
+    double lastX, lastY;
+    double dx, dy;
+    double oldest;
+    unsigned int events;
+};
+#endif
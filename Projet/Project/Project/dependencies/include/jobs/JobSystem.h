@@ -0,0 +1,363 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <utility>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+enum Job_Affinity {
+    JOB_ANY_THREAD, // run by a worker, or by a thread helping while it waits
+    JOB_GL_THREAD   // run only by the thread that owns the GL context, in runGLJobs() or wait()
+};
+
+class JobCounter;
+
+struct Job {
+    std::function<void()> run;
+    JobCounter* counter; // decremented when the job is done, may be NULL
+    const char* name;
+    Job_Affinity affinity;
+};
+
+// Number of jobs not done yet. A counter is the handle to wait for a group of jobs, and the dependency of the jobs
+// submitted after it. It must be waited with JobSystem::wait() before it is destroyed.
+class JobCounter
+{
+public:
+    JobCounter() : pending(0)
+    {
+    }
+
+    bool done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending;
+    std::mutex mutex;              // guards the transition to 0 and the continuations
+    std::vector<Job> continuations; // jobs submitted after this counter, queued once it reaches 0
+};
+
+// called around every job, to plug a profiler. thread is the worker index, or workerCount() for the other threads.
+struct JobHooks {
+    void (*begin)(void* user, const char* name, unsigned int thread);
+    void (*end)(void* user, const char* name, unsigned int thread);
+    void* user;
+};
+
+// Work-stealing job system.
+// Each worker has its own deque: it pushes and pops its jobs at the back, so it runs the most recent ones while they
+// are hot in cache, and idle workers steal the oldest ones at the front of the others. Threads that are not workers
+// push to a shared deque. A thread waiting for a counter runs jobs meanwhile, so jobs can wait for other jobs without
+// blocking a worker. GL calls can only happen on the thread that owns the context, jobs with the JOB_GL_THREAD
+// affinity are kept apart until that thread runs them.
+class JobSystem
+{
+public:
+    // shared instance, its workers are started on the first call
+    static JobSystem& instance()
+    {
+        static JobSystem system;
+        return system;
+    }
+
+    // workers is the number of worker threads, by default one per core beside the calling thread
+    JobSystem(unsigned int workers = std::max(1u, std::thread::hardware_concurrency()) - 1)
+        : queued(0), stopping(false), glThread(std::this_thread::get_id())
+    {
+        hooks.begin = NULL;
+        hooks.end = NULL;
+        hooks.user = NULL;
+        // the last queue is shared by the threads that are not workers
+        for (unsigned int i = 0; i <= workers; i++)
+            queues.emplace_back();
+        for (unsigned int i = 0; i < workers; i++)
+            threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+
+    ~JobSystem()
+    {
+        shutdown();
+    }
+
+    // stops the workers once the queued jobs are done, better called before the end of main than from the destructor
+    void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (unsigned int i = 0; i < threads.size(); i++)
+            threads[i].join();
+        threads.clear();
+    }
+
+    unsigned int workerCount() const
+    {
+        return (unsigned int)threads.size();
+    }
+
+    // the calling thread runs the JOB_GL_THREAD jobs from now on, it must own the GL context
+    void bindGLThread()
+    {
+        std::lock_guard<std::mutex> lock(glMutex);
+        glThread = std::this_thread::get_id();
+    }
+
+    // set before any job runs
+    void setHooks(const JobHooks& _hooks)
+    {
+        hooks = _hooks;
+    }
+
+    // queues run, which decrements counter once done. When after is given, run is only queued once after reaches 0.
+    void submit(std::function<void()> run, JobCounter* counter = NULL, const char* name = "job",
+        Job_Affinity affinity = JOB_ANY_THREAD, JobCounter* after = NULL)
+    {
+        Job job = { run, counter, name, affinity };
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        if (after)
+        {
+            std::lock_guard<std::mutex> lock(after->mutex);
+            if (after->pending.load(std::memory_order_acquire) > 0)
+            {
+                after->continuations.push_back(job);
+                return;
+            }
+        }
+        push(job);
+    }
+
+    // runs jobs until counter reaches 0
+    void wait(JobCounter& counter)
+    {
+        while (!counter.done())
+        {
+            if (isGLThread() && runGLJob())
+                continue;
+            if (!runOne(currentWorker()))
+                std::this_thread::yield();
+        }
+        // the job that reached 0 may still hold the lock, the counter can be destroyed once it is released
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    // runs the JOB_GL_THREAD jobs queued so far, from the thread bound to GL. returns whether any ran.
+    bool runGLJobs()
+    {
+        if (!isGLThread())
+            return false;
+        bool any = false;
+        while (runGLJob())
+            any = true;
+        return any;
+    }
+
+    // runs kernel(begin, end) over [0, n) in chunks of at least minChunk items, the calling thread takes the first chunk
+    template <typename Kernel>
+    void parallelFor(unsigned int n, unsigned int minChunk, const Kernel& kernel, const char* name = "parallelFor")
+    {
+        unsigned int parts = workerCount() + 1;
+        unsigned int chunk = std::max(std::max(1u, minChunk), (n + parts - 1) / parts);
+        if (n <= chunk)
+        {
+            if (n > 0)
+                kernel(0u, n);
+            return;
+        }
+        JobCounter counter;
+        for (unsigned int begin = chunk; begin < n; begin += chunk)
+        {
+            unsigned int end = std::min(n, begin + chunk);
+            submit([&kernel, begin, end]() { kernel(begin, end); }, &counter, name);
+        }
+        kernel(0u, chunk);
+        wait(counter);
+    }
+
+private:
+    // ring buffer of jobs: once it reached the size a frame needs, pushing and popping make no heap allocation
+    struct WorkQueue {
+        std::mutex mutex;
+        std::vector<Job> ring;
+        unsigned int head, count;
+
+        WorkQueue() : head(0), count(0)
+        {
+        }
+
+        void pushBack(const Job& job)
+        {
+            if (count == ring.size())
+            {
+                std::vector<Job> larger(std::max<size_t>(64, ring.size() * 2));
+                for (unsigned int i = 0; i < count; i++)
+                    larger[i] = std::move(ring[(head + i) % ring.size()]);
+                ring.swap(larger);
+                head = 0;
+            }
+            ring[(head + count) % ring.size()] = job;
+            count++;
+        }
+
+        void popBack(Job& job)
+        {
+            count--;
+            job = std::move(ring[(head + count) % ring.size()]);
+        }
+
+        void popFront(Job& job)
+        {
+            job = std::move(ring[head]);
+            head = (head + 1) % ring.size();
+            count--;
+        }
+    };
+
+    std::deque<WorkQueue> queues;
+    std::vector<std::thread> threads;
+    std::atomic<int> queued; // jobs in the queues, the workers sleep when it is 0
+    bool stopping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    std::mutex glMutex; // guards glThread
+    std::thread::id glThread;
+    WorkQueue glJobs;
+
+    JobHooks hooks;
+
+    // worker index of the calling thread, workerCount() for the other threads
+    unsigned int currentWorker() const
+    {
+        const JobSystem* owner = workerOwner();
+        return owner == this ? workerIndex() : workerCount();
+    }
+
+    static const JobSystem*& workerOwner()
+    {
+        static thread_local const JobSystem* owner = NULL;
+        return owner;
+    }
+
+    static unsigned int& workerIndex()
+    {
+        static thread_local unsigned int index = 0;
+        return index;
+    }
+
+    bool isGLThread()
+    {
+        std::lock_guard<std::mutex> lock(glMutex);
+        return glThread == std::this_thread::get_id();
+    }
+
+    void push(const Job& job)
+    {
+        if (job.affinity == JOB_GL_THREAD)
+        {
+            std::lock_guard<std::mutex> lock(glJobs.mutex);
+            glJobs.pushBack(job);
+            return;
+        }
+        WorkQueue& queue = queues[currentWorker()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.pushBack(job);
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        // taking the lock orders the increment before the check of a worker going to sleep
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // the own queue first from the back, then the shared queue and the other workers from the front
+    bool pop(unsigned int self, Job& job)
+    {
+        unsigned int count = (unsigned int)queues.size();
+        for (unsigned int k = 0; k < count; k++)
+        {
+            unsigned int i = (self + k) % count;
+            WorkQueue& queue = queues[i];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.count == 0)
+                continue;
+            if (k == 0 && self < workerCount())
+                queue.popBack(job);
+            else
+                queue.popFront(job);
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool runOne(unsigned int self)
+    {
+        Job job;
+        if (!pop(self, job))
+            return false;
+        execute(job, self);
+        return true;
+    }
+
+    bool runGLJob()
+    {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(glJobs.mutex);
+            if (glJobs.count == 0)
+                return false;
+            glJobs.popFront(job);
+        }
+        execute(job, currentWorker());
+        return true;
+    }
+
+    void execute(Job& job, unsigned int self)
+    {
+        if (hooks.begin)
+            hooks.begin(hooks.user, job.name, self);
+        job.run();
+        if (hooks.end)
+            hooks.end(hooks.user, job.name, self);
+        if (!job.counter)
+            return;
+        std::vector<Job> ready;
+        {
+            std::lock_guard<std::mutex> lock(job.counter->mutex);
+            if (job.counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.swap(job.counter->continuations);
+        }
+        for (unsigned int i = 0; i < ready.size(); i++)
+            push(ready[i]);
+    }
+
+    void workerLoop(unsigned int index)
+    {
+        workerOwner() = this;
+        workerIndex() = index;
+        while (true)
+        {
+            if (runOne(index))
+                continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return queued.load(std::memory_order_acquire) > 0 || stopping; });
+            if (stopping && queued.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+};
+#endif
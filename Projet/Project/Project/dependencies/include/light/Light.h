@@ -14,9 +14,11 @@ public:
 	glm::vec3 spotDir;
 	float strength;
 	float range;
+	float radius = 0.0f; // distance where the light fades to exactly 0, 0 keeps the unbounded attenuation
 	float cutOff;
 	float outerCutOff;
 	bool isSpot = false;
+	bool isStatic = false; // never moves nor changes color, can be baked in the lightmap
 
 	Light(glm::vec3 _lightPos, glm::vec3 _lightColor, float _strength, float _range) {
 		lightPos = _lightPos;
@@ -47,6 +49,14 @@ public:
 	void setStrength(float _strength) {
 		strength = _strength;
 	}
+
+	void setRadius(float _radius) {
+		radius = _radius;
+	}
+
+	void setStatic(bool _isStatic) {
+		isStatic = _isStatic;
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,523 @@
+#ifndef LIGHT_SYSTEM_H
+#define LIGHT_SYSTEM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <light/Light.h>
+#include <shader/shader_s.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LIGHT_SYSTEM_SSE 1
+#endif
+
+// number of lights the wall shader can receive (NBLamp in Wall.frag)
+const int LIGHT_SHADER_MAX = 6;
+// contribution below which a light is considered to have no visible effect (one 8 bit step)
+const float LIGHT_INFLUENCE_EPSILON = 1.0f / 256.0f;
+// diffuse (0.3) + specular (0.2) weights used by Wall.frag
+const float LIGHT_SHADING_WEIGHT = 0.5f;
+
+// Which derived values of a light need to be recomputed
+enum Light_Dirty {
+    LIGHT_DIRTY_POSITION = 1 << 0,
+    LIGHT_DIRTY_COLOR = 1 << 1,
+    LIGHT_DIRTY_DIRECTION = 1 << 2,
+    LIGHT_DIRTY_ANGLES = 1 << 3,
+    LIGHT_DIRTY_RANGE = 1 << 4,
+    LIGHT_DIRTY_STRENGTH = 1 << 5,
+    LIGHT_DIRTY_RADIUS = 1 << 6
+};
+
+// Attenuation shared by Wall.frag and the CPU side (baker, culling).
+// radius > 0: windowed inverse square, flat inside range then range^2 / d^2, reaching exactly 0 at radius.
+// radius = 0: legacy min(range / d, 1), which never reaches 0.
+inline float lightAttenuation(float dist, float range, float radius)
+{
+    if (radius <= 0.0f)
+        return std::min(range / dist, 1.0f);
+    if (dist >= radius)
+        return 0.0f;
+    float ratio = dist / radius;
+    float window = 1.0f - ratio * ratio * ratio * ratio;
+    return std::min(range * range / (dist * dist), 1.0f) * window * window;
+}
+
+struct LightSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// spot cone: everything lit is within height of the apex and within the half angle around the axis
+struct LightCone {
+    glm::vec3 apex;
+    glm::vec3 axis;
+    float height;
+    float cosAngle, sinAngle;
+};
+
+// Owns every light of the scene as structure-of-arrays and caches the values the shaders and the culling need.
+// Raw parameters are written through the setters which only flag the light as dirty; update() recomputes the
+// derived data of the dirty lights in blocks of 4 and bumps the version so consumers can skip redundant work.
+class LightSystem
+{
+public:
+    // raw parameters
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> colorR, colorG, colorB;
+    std::vector<float> dirX, dirY, dirZ;
+    std::vector<float> strength;
+    std::vector<float> range;
+    std::vector<float> radius;      // 0 for the legacy unbounded attenuation
+    std::vector<float> cutOff;      // degrees
+    std::vector<float> outerCutOff; // degrees
+    std::vector<int>   isSpot;
+    std::vector<int>   isStatic;
+    std::vector<uint8_t> active;    // inactive lights are uploaded with a strength of 0
+
+    // derived values, valid after update()
+    std::vector<float> cosCutOff, cosOuterCutOff;
+    std::vector<float> invRange;
+    std::vector<float> spotX, spotY, spotZ; // normalized spot direction
+    std::vector<float> influence;                    // distance after which the light has no effect
+    std::vector<float> coneCos, coneSin;             // half angle of the lit cone of spots
+    std::vector<float> boundsX, boundsY, boundsZ;    // bounding sphere center, tight around the cone for spots
+    std::vector<float> boundsRadius;
+    std::vector<float> boundsMinX, boundsMinY, boundsMinZ;
+    std::vector<float> boundsMaxX, boundsMaxY, boundsMaxZ;
+
+    LightSystem() : count(0), dirtyCount(0), version(0), packedVersion(~0ull)
+    {
+    }
+
+    // adds a light and returns its index
+    unsigned int add(const Light& light)
+    {
+        unsigned int index = count++;
+        // arrays are padded to a multiple of 4 so the update kernel never needs a scalar tail
+        if (count > posX.size())
+            resize((count + 3) & ~3u);
+
+        posX[index] = light.lightPos.x; posY[index] = light.lightPos.y; posZ[index] = light.lightPos.z;
+        colorR[index] = light.lightColor.r; colorG[index] = light.lightColor.g; colorB[index] = light.lightColor.b;
+        dirX[index] = light.spotDir.x; dirY[index] = light.spotDir.y; dirZ[index] = light.spotDir.z;
+        strength[index] = light.strength;
+        range[index] = light.range;
+        radius[index] = light.radius;
+        cutOff[index] = light.cutOff;
+        outerCutOff[index] = light.outerCutOff;
+        isSpot[index] = light.isSpot ? 1 : 0;
+        isStatic[index] = light.isStatic ? 1 : 0;
+        markDirty(index, 0xFF);
+        return index;
+    }
+
+    // copies the lights of another system, e.g. into the frame packet of the render thread. other must be up to
+    // date (update() called) so versions identify its content: nothing is copied when they match, and what this
+    // system already uploaded to each program stays valid.
+    void assign(const LightSystem& other)
+    {
+        if (other.version == version && other.count == count)
+            return;
+        posX = other.posX; posY = other.posY; posZ = other.posZ;
+        colorR = other.colorR; colorG = other.colorG; colorB = other.colorB;
+        dirX = other.dirX; dirY = other.dirY; dirZ = other.dirZ;
+        strength = other.strength; range = other.range; radius = other.radius;
+        cutOff = other.cutOff; outerCutOff = other.outerCutOff;
+        isSpot = other.isSpot; isStatic = other.isStatic; active = other.active;
+        cosCutOff = other.cosCutOff; cosOuterCutOff = other.cosOuterCutOff; invRange = other.invRange;
+        spotX = other.spotX; spotY = other.spotY; spotZ = other.spotZ;
+        influence = other.influence; coneCos = other.coneCos; coneSin = other.coneSin;
+        boundsX = other.boundsX; boundsY = other.boundsY; boundsZ = other.boundsZ; boundsRadius = other.boundsRadius;
+        boundsMinX = other.boundsMinX; boundsMinY = other.boundsMinY; boundsMinZ = other.boundsMinZ;
+        boundsMaxX = other.boundsMaxX; boundsMaxY = other.boundsMaxY; boundsMaxZ = other.boundsMaxZ;
+        count = other.count;
+        dirty = other.dirty;
+        dirtyCount = 0;
+        version = other.version;
+    }
+
+    unsigned int size() const
+    {
+        return count;
+    }
+
+    uint64_t getVersion() const
+    {
+        return version;
+    }
+
+    // setters only flag the light, nothing is recomputed until update()
+    void setPosition(unsigned int i, glm::vec3 position)
+    {
+        if (posX[i] == position.x && posY[i] == position.y && posZ[i] == position.z)
+            return;
+        posX[i] = position.x; posY[i] = position.y; posZ[i] = position.z;
+        markDirty(i, LIGHT_DIRTY_POSITION);
+    }
+
+    void setColor(unsigned int i, glm::vec3 color)
+    {
+        if (colorR[i] == color.r && colorG[i] == color.g && colorB[i] == color.b)
+            return;
+        colorR[i] = color.r; colorG[i] = color.g; colorB[i] = color.b;
+        markDirty(i, LIGHT_DIRTY_COLOR);
+    }
+
+    void setSpotDirection(unsigned int i, glm::vec3 direction)
+    {
+        if (dirX[i] == direction.x && dirY[i] == direction.y && dirZ[i] == direction.z)
+            return;
+        dirX[i] = direction.x; dirY[i] = direction.y; dirZ[i] = direction.z;
+        markDirty(i, LIGHT_DIRTY_DIRECTION);
+    }
+
+    void setCutOff(unsigned int i, float _cutOff, float _outerCutOff)
+    {
+        if (cutOff[i] == _cutOff && outerCutOff[i] == _outerCutOff)
+            return;
+        cutOff[i] = _cutOff;
+        outerCutOff[i] = _outerCutOff;
+        markDirty(i, LIGHT_DIRTY_ANGLES);
+    }
+
+    void setRange(unsigned int i, float _range)
+    {
+        if (range[i] == _range)
+            return;
+        range[i] = _range;
+        markDirty(i, LIGHT_DIRTY_RANGE);
+    }
+
+    void setRadius(unsigned int i, float _radius)
+    {
+        if (radius[i] == _radius)
+            return;
+        radius[i] = _radius;
+        markDirty(i, LIGHT_DIRTY_RADIUS);
+    }
+
+    void setStrength(unsigned int i, float _strength)
+    {
+        if (strength[i] == _strength)
+            return;
+        strength[i] = _strength;
+        markDirty(i, LIGHT_DIRTY_STRENGTH);
+    }
+
+    // batch setters for animated lights, values[k] goes to light indices[k]
+    void setStrengths(const unsigned int* indices, const float* values, size_t n)
+    {
+        for (size_t k = 0; k < n; k++)
+            setStrength(indices[k], values[k]);
+    }
+
+    // switches a light off without removing it, e.g. when it cannot reach anything visible this frame
+    void setActive(unsigned int i, bool _active)
+    {
+        if ((active[i] != 0) == _active)
+            return;
+        active[i] = _active ? 1 : 0;
+        version++;
+    }
+
+    void setPositions(const unsigned int* indices, const glm::vec3* values, size_t n)
+    {
+        for (size_t k = 0; k < n; k++)
+            setPosition(indices[k], values[k]);
+    }
+
+    glm::vec3 position(unsigned int i) const
+    {
+        return glm::vec3(posX[i], posY[i], posZ[i]);
+    }
+
+    glm::vec3 color(unsigned int i) const
+    {
+        return glm::vec3(colorR[i], colorG[i], colorB[i]);
+    }
+
+    glm::vec3 spotDirection(unsigned int i) const
+    {
+        return glm::vec3(spotX[i], spotY[i], spotZ[i]);
+    }
+
+    // true when the light can be culled exactly, i.e. its attenuation reaches 0
+    bool isBounded(unsigned int i) const
+    {
+        return radius[i] > 0.0f;
+    }
+
+    // smallest sphere containing everything the light can reach
+    LightSphere boundingSphere(unsigned int i) const
+    {
+        LightSphere sphere;
+        sphere.center = glm::vec3(boundsX[i], boundsY[i], boundsZ[i]);
+        sphere.radius = boundsRadius[i];
+        return sphere;
+    }
+
+    // lit cone of a spot, a point light is a cone with a half angle of 180 degrees
+    LightCone boundingCone(unsigned int i) const
+    {
+        LightCone cone;
+        cone.apex = position(i);
+        cone.axis = spotDirection(i);
+        cone.height = influence[i];
+        cone.cosAngle = coneCos[i];
+        cone.sinAngle = coneSin[i];
+        return cone;
+    }
+
+    // exact test of the light volume against a sphere, for culling objects or clusters
+    bool intersectsSphere(unsigned int i, glm::vec3 center, float sphereRadius) const
+    {
+        glm::vec3 d = center - position(i);
+        float dist2 = glm::dot(d, d);
+        float reach = influence[i] + sphereRadius;
+        if (dist2 > reach * reach)
+            return false;
+        if (!isSpot[i] || coneCos[i] <= -1.0f)
+            return true;
+        // distance from the sphere center to the cone, see "Cull that cone" (Bart Wronski)
+        float along = glm::dot(d, spotDirection(i));
+        float across = glm::sqrt(std::max(dist2 - along * along, 0.0f));
+        float coneDist = coneCos[i] * across - coneSin[i] * along;
+        bool outsideAngle = coneDist > sphereRadius;
+        bool beyondCap = along > influence[i] + sphereRadius;
+        bool behindApex = coneCos[i] >= 0.0f && along < -sphereRadius;
+        return !(outsideAngle || beyondCap || behindApex);
+    }
+
+    // recomputes the derived values of every dirty light, returns true if anything changed
+    bool update()
+    {
+        if (dirtyCount == 0)
+            return false;
+
+        unsigned int padded = (unsigned int)posX.size();
+        for (unsigned int block = 0; block < padded; block += 4)
+        {
+            uint8_t blockFlags = dirty[block] | dirty[block + 1] | dirty[block + 2] | dirty[block + 3];
+            if (blockFlags == 0)
+                continue;
+            updateBlock(block);
+            for (unsigned int i = block; i < block + 4; i++)
+            {
+                if (dirty[i] & LIGHT_DIRTY_ANGLES)
+                {
+                    cosCutOff[i] = glm::cos(glm::radians(cutOff[i]));
+                    cosOuterCutOff[i] = glm::cos(glm::radians(outerCutOff[i]));
+                    float angle = isSpot[i] ? glm::radians(std::max(cutOff[i], outerCutOff[i])) : glm::radians(180.0f);
+                    coneCos[i] = glm::cos(angle);
+                    coneSin[i] = glm::sin(angle);
+                }
+                // updateBlock rewrote the sphere of all four lanes, clean spots included
+                if (isSpot[i] && coneCos[i] > -1.0f)
+                    fitSpotBounds(i);
+            }
+            dirty[block] = dirty[block + 1] = dirty[block + 2] = dirty[block + 3] = 0;
+        }
+        dirtyCount = 0;
+        version++;
+        return true;
+    }
+
+    // uploads the light arrays to the shader, skipped when this program already has the current version
+    void upload(const Shader& shader)
+    {
+        update();
+
+        for (unsigned int k = 0; k < uploaded.size(); k++)
+        {
+            if (uploaded[k].program == shader.ID)
+            {
+                if (uploaded[k].version == version)
+                    return;
+                uploaded[k].version = version;
+                uploadArrays(shader.ID);
+                return;
+            }
+        }
+        UploadState state;
+        state.program = shader.ID;
+        state.version = version;
+        uploaded.push_back(state);
+        uploadArrays(shader.ID);
+    }
+
+private:
+    struct UploadState {
+        unsigned int program;
+        uint64_t version;
+    };
+
+    unsigned int count;
+    unsigned int dirtyCount;
+    uint64_t version;
+    std::vector<uint8_t> dirty;
+    std::vector<UploadState> uploaded;
+
+    // interleaved copies for glUniform*v, rebuilt only when the version changes
+    uint64_t packedVersion;
+    std::vector<glm::vec3> packedPos, packedColor, packedSpot;
+    std::vector<float> packedStrength;
+
+    void markDirty(unsigned int i, uint8_t flags)
+    {
+        if (dirty[i] == 0)
+            dirtyCount++;
+        dirty[i] |= flags;
+    }
+
+    void resize(unsigned int n)
+    {
+        std::vector<float>* raw[] = { &posX, &posY, &posZ, &colorR, &colorG, &colorB, &dirX, &dirY,
+            &cutOff, &outerCutOff, &strength, &radius, &cosCutOff, &cosOuterCutOff, &invRange, &spotX, &spotY, &spotZ,
+            &influence, &coneCos, &coneSin, &boundsX, &boundsY, &boundsZ, &boundsRadius, &boundsMinX, &boundsMinY, &boundsMinZ, &boundsMaxX, &boundsMaxY, &boundsMaxZ };
+        for (std::vector<float>* v : raw)
+            v->resize(n, 0.0f);
+        // padding lights get a valid range and direction so the kernel never divides by zero
+        range.resize(n, 1.0f);
+        dirZ.resize(n, -1.0f);
+        isSpot.resize(n, 0);
+        isStatic.resize(n, 0);
+        active.resize(n, 1);
+        dirty.resize(n, 0);
+    }
+
+    // recomputes normalized direction, inverse range and world-space bounds of lights [block, block + 4)
+    void updateBlock(unsigned int block)
+    {
+#ifdef LIGHT_SYSTEM_SSE
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 tiny = _mm_set1_ps(1e-12f);
+        __m128 x = _mm_loadu_ps(&dirX[block]);
+        __m128 y = _mm_loadu_ps(&dirY[block]);
+        __m128 z = _mm_loadu_ps(&dirZ[block]);
+        __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(len2, tiny)));
+        _mm_storeu_ps(&spotX[block], _mm_mul_ps(x, invLen));
+        _mm_storeu_ps(&spotY[block], _mm_mul_ps(y, invLen));
+        _mm_storeu_ps(&spotZ[block], _mm_mul_ps(z, invLen));
+
+        __m128 r = _mm_max_ps(_mm_loadu_ps(&range[block]), tiny);
+        _mm_storeu_ps(&invRange[block], _mm_div_ps(one, r));
+
+        // strength * min(range / d, 1) * weight * maxColor < epsilon  <=>  d > strength * range * weight * maxColor / epsilon
+        __m128 maxColor = _mm_max_ps(_mm_loadu_ps(&colorR[block]), _mm_max_ps(_mm_loadu_ps(&colorG[block]), _mm_loadu_ps(&colorB[block])));
+        __m128 legacy = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&strength[block]), r),
+            _mm_mul_ps(maxColor, _mm_set1_ps(LIGHT_SHADING_WEIGHT / LIGHT_INFLUENCE_EPSILON)));
+        legacy = _mm_max_ps(legacy, _mm_setzero_ps());
+        // finite radius when set, the epsilon estimate otherwise
+        __m128 finite = _mm_loadu_ps(&radius[block]);
+        __m128 bounded = _mm_cmpgt_ps(finite, _mm_setzero_ps());
+        __m128 reach = _mm_or_ps(_mm_and_ps(bounded, finite), _mm_andnot_ps(bounded, legacy));
+        _mm_storeu_ps(&influence[block], reach);
+        _mm_storeu_ps(&boundsRadius[block], reach);
+
+        __m128 px = _mm_loadu_ps(&posX[block]);
+        __m128 py = _mm_loadu_ps(&posY[block]);
+        __m128 pz = _mm_loadu_ps(&posZ[block]);
+        _mm_storeu_ps(&boundsX[block], px);
+        _mm_storeu_ps(&boundsY[block], py);
+        _mm_storeu_ps(&boundsZ[block], pz);
+        __m128 radius = reach;
+        _mm_storeu_ps(&boundsMinX[block], _mm_sub_ps(px, radius));
+        _mm_storeu_ps(&boundsMinY[block], _mm_sub_ps(py, radius));
+        _mm_storeu_ps(&boundsMinZ[block], _mm_sub_ps(pz, radius));
+        _mm_storeu_ps(&boundsMaxX[block], _mm_add_ps(px, radius));
+        _mm_storeu_ps(&boundsMaxY[block], _mm_add_ps(py, radius));
+        _mm_storeu_ps(&boundsMaxZ[block], _mm_add_ps(pz, radius));
+#else
+        for (unsigned int i = block; i < block + 4; i++)
+        {
+            float len = glm::sqrt(std::max(dirX[i] * dirX[i] + dirY[i] * dirY[i] + dirZ[i] * dirZ[i], 1e-12f));
+            spotX[i] = dirX[i] / len;
+            spotY[i] = dirY[i] / len;
+            spotZ[i] = dirZ[i] / len;
+
+            float r = std::max(range[i], 1e-12f);
+            invRange[i] = 1.0f / r;
+
+            float maxColor = std::max(colorR[i], std::max(colorG[i], colorB[i]));
+            float legacy = std::max(strength[i] * r * maxColor * (LIGHT_SHADING_WEIGHT / LIGHT_INFLUENCE_EPSILON), 0.0f);
+            float reach = radius[i] > 0.0f ? radius[i] : legacy;
+            influence[i] = reach;
+            boundsRadius[i] = reach;
+            boundsX[i] = posX[i]; boundsY[i] = posY[i]; boundsZ[i] = posZ[i];
+            boundsMinX[i] = posX[i] - reach; boundsMaxX[i] = posX[i] + reach;
+            boundsMinY[i] = posY[i] - reach; boundsMaxY[i] = posY[i] + reach;
+            boundsMinZ[i] = posZ[i] - reach; boundsMaxZ[i] = posZ[i] + reach;
+        }
+#endif
+    }
+
+    // replaces the point light sphere of a spot by the smallest sphere around its cone
+    void fitSpotBounds(unsigned int i)
+    {
+        float h = influence[i];
+        glm::vec3 apex = position(i), axis = spotDirection(i);
+        glm::vec3 center;
+        float r;
+        if (coneCos[i] < 0.70710678f)
+        {
+            // wider than 45 degrees: the sphere around the cap circle, or the whole sphere past 90
+            center = apex + axis * (h * std::max(coneCos[i], 0.0f));
+            r = coneCos[i] > 0.0f ? h * coneSin[i] : h;
+        }
+        else
+        {
+            // narrow: the sphere going through the apex and the cap circle
+            r = h / (2.0f * coneCos[i]);
+            center = apex + axis * r;
+        }
+        if (r >= boundsRadius[i])
+            return;
+        boundsX[i] = center.x; boundsY[i] = center.y; boundsZ[i] = center.z;
+        boundsRadius[i] = r;
+        boundsMinX[i] = center.x - r; boundsMaxX[i] = center.x + r;
+        boundsMinY[i] = center.y - r; boundsMaxY[i] = center.y + r;
+        boundsMinZ[i] = center.z - r; boundsMaxZ[i] = center.z + r;
+    }
+
+    void uploadArrays(unsigned int program)
+    {
+        int n = std::min((int)count, LIGHT_SHADER_MAX);
+        if (packedVersion != version)
+        {
+            packedPos.resize(n);
+            packedColor.resize(n);
+            packedSpot.resize(n);
+            packedStrength.resize(n);
+            for (int i = 0; i < n; i++)
+            {
+                packedPos[i] = position(i);
+                packedColor[i] = color(i);
+                packedSpot[i] = spotDirection(i);
+                packedStrength[i] = active[i] ? strength[i] : 0.0f;
+            }
+            packedVersion = version;
+        }
+        if (n == 0)
+            return;
+
+        glUniform3fv(glGetUniformLocation(program, "lightColor"), n, glm::value_ptr(packedColor[0]));
+        glUniform3fv(glGetUniformLocation(program, "lightPos"), n, glm::value_ptr(packedPos[0]));
+        glUniform1fv(glGetUniformLocation(program, "strength"), n, &packedStrength[0]);
+        glUniform1fv(glGetUniformLocation(program, "range"), n, &range[0]);
+        glUniform1fv(glGetUniformLocation(program, "radius"), n, &radius[0]);
+        glUniform3fv(glGetUniformLocation(program, "spotDir"), n, glm::value_ptr(packedSpot[0]));
+        glUniform1fv(glGetUniformLocation(program, "cutOff"), n, &cosCutOff[0]);
+        glUniform1fv(glGetUniformLocation(program, "outerCutOff"), n, &cosOuterCutOff[0]);
+        glUniform1iv(glGetUniformLocation(program, "isSpot"), n, &isSpot[0]);
+    }
+};
+#endif
@@ -0,0 +1,574 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <light/LightSystem.h>
+#include <shader/shader_s.h>
+#include <jobs/JobSystem.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cfloat>
+
+// texels per world unit of the lightmap atlas
+const float LIGHTMAP_TEXELS_PER_UNIT = 8.0f;
+// empty texels kept around every chart so bilinear filtering never bleeds between surfaces
+const int LIGHTMAP_PADDING = 2;
+// offset applied to shadow rays to avoid self intersection
+const float LIGHTMAP_RAY_EPSILON = 1e-3f;
+const uint32_t LIGHTMAP_FILE_MAGIC = 0x50414D4C; // "LMAP"
+const uint32_t LIGHTMAP_FILE_VERSION = 1;
+
+struct BakeTriangle {
+    glm::vec3 v0, v1, v2;
+};
+
+// Bounding volume hierarchy over the static triangles, built with a binned surface area heuristic.
+// Only answers occlusion queries: is anything hit between the origin and tMax.
+class TriangleBVH
+{
+public:
+    void build(const std::vector<BakeTriangle>& _triangles)
+    {
+        triangles = _triangles;
+        nodes.clear();
+        order.resize(triangles.size());
+        centroids.resize(triangles.size());
+        for (unsigned int i = 0; i < triangles.size(); i++)
+        {
+            order[i] = i;
+            centroids[i] = (triangles[i].v0 + triangles[i].v1 + triangles[i].v2) / 3.0f;
+        }
+        if (triangles.empty())
+            return;
+        nodes.reserve(triangles.size() * 2);
+        nodes.push_back(Node());
+        nodes[0].first = 0;
+        nodes[0].count = (unsigned int)triangles.size();
+        subdivide(0);
+    }
+
+    bool occluded(glm::vec3 origin, glm::vec3 dir, float tMax) const
+    {
+        if (nodes.empty())
+            return false;
+        glm::vec3 invDir = 1.0f / dir;
+        unsigned int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node& node = nodes[stack[--top]];
+            if (!hitBox(node, origin, invDir, tMax))
+                continue;
+            if (node.count > 0)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                    if (hitTriangle(triangles[order[i]], origin, dir, tMax))
+                        return true;
+            }
+            else
+            {
+                stack[top++] = node.first;
+                stack[top++] = node.first + 1;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Node {
+        glm::vec3 bmin, bmax;
+        unsigned int first; // first triangle for leaves, left child for inner nodes
+        unsigned int count; // 0 for inner nodes
+    };
+
+    std::vector<BakeTriangle> triangles;
+    std::vector<unsigned int> order;
+    std::vector<glm::vec3> centroids;
+    std::vector<Node> nodes;
+
+    static float area(glm::vec3 bmin, glm::vec3 bmax)
+    {
+        glm::vec3 e = bmax - bmin;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    void subdivide(unsigned int index)
+    {
+        const int BINS = 12;
+        Node& node = nodes[index];
+        node.bmin = glm::vec3(FLT_MAX);
+        node.bmax = glm::vec3(-FLT_MAX);
+        glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+        for (unsigned int i = node.first; i < node.first + node.count; i++)
+        {
+            const BakeTriangle& t = triangles[order[i]];
+            node.bmin = glm::min(node.bmin, glm::min(t.v0, glm::min(t.v1, t.v2)));
+            node.bmax = glm::max(node.bmax, glm::max(t.v0, glm::max(t.v1, t.v2)));
+            cmin = glm::min(cmin, centroids[order[i]]);
+            cmax = glm::max(cmax, centroids[order[i]]);
+        }
+        if (node.count <= 4)
+            return;
+
+        // evaluate the SAH on a few bins along every axis
+        float bestCost = area(node.bmin, node.bmax) * node.count;
+        int bestAxis = -1;
+        float bestSplit = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = cmax[axis] - cmin[axis];
+            if (extent <= 0.0f)
+                continue;
+            glm::vec3 binMin[BINS], binMax[BINS];
+            unsigned int binCount[BINS] = { 0 };
+            for (int b = 0; b < BINS; b++)
+            {
+                binMin[b] = glm::vec3(FLT_MAX);
+                binMax[b] = glm::vec3(-FLT_MAX);
+            }
+            float scale = BINS / extent;
+            for (unsigned int i = node.first; i < node.first + node.count; i++)
+            {
+                const BakeTriangle& t = triangles[order[i]];
+                int b = std::min(BINS - 1, (int)((centroids[order[i]][axis] - cmin[axis]) * scale));
+                binCount[b]++;
+                binMin[b] = glm::min(binMin[b], glm::min(t.v0, glm::min(t.v1, t.v2)));
+                binMax[b] = glm::max(binMax[b], glm::max(t.v0, glm::max(t.v1, t.v2)));
+            }
+            for (int split = 1; split < BINS; split++)
+            {
+                glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX), rmin(FLT_MAX), rmax(-FLT_MAX);
+                unsigned int lcount = 0, rcount = 0;
+                for (int b = 0; b < split; b++)
+                {
+                    if (!binCount[b]) continue;
+                    lmin = glm::min(lmin, binMin[b]); lmax = glm::max(lmax, binMax[b]); lcount += binCount[b];
+                }
+                for (int b = split; b < BINS; b++)
+                {
+                    if (!binCount[b]) continue;
+                    rmin = glm::min(rmin, binMin[b]); rmax = glm::max(rmax, binMax[b]); rcount += binCount[b];
+                }
+                if (lcount == 0 || rcount == 0)
+                    continue;
+                float cost = area(lmin, lmax) * lcount + area(rmin, rmax) * rcount;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = cmin[axis] + split / scale;
+                }
+            }
+        }
+        if (bestAxis < 0)
+            return;
+
+        unsigned int* begin = &order[node.first];
+        unsigned int* middle = std::partition(begin, begin + node.count,
+            [this, bestAxis, bestSplit](unsigned int t) { return centroids[t][bestAxis] < bestSplit; });
+        unsigned int leftCount = (unsigned int)(middle - begin);
+        if (leftCount == 0 || leftCount == node.count)
+            return;
+
+        unsigned int left = (unsigned int)nodes.size();
+        Node child;
+        child.first = node.first;
+        child.count = leftCount;
+        nodes.push_back(child);
+        child.first = nodes[index].first + leftCount;
+        child.count = nodes[index].count - leftCount;
+        nodes.push_back(child);
+        // push_back may have moved the nodes, do not use the node reference anymore
+        nodes[index].first = left;
+        nodes[index].count = 0;
+        subdivide(left);
+        subdivide(left + 1);
+    }
+
+    static bool hitBox(const Node& node, glm::vec3 origin, glm::vec3 invDir, float tMax)
+    {
+        glm::vec3 t0 = (node.bmin - origin) * invDir;
+        glm::vec3 t1 = (node.bmax - origin) * invDir;
+        glm::vec3 tmin = glm::min(t0, t1), tmax = glm::max(t0, t1);
+        float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+        float exit = std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, tMax));
+        return enter <= exit;
+    }
+
+    // Moller-Trumbore
+    static bool hitTriangle(const BakeTriangle& t, glm::vec3 origin, glm::vec3 dir, float tMax)
+    {
+        glm::vec3 e1 = t.v1 - t.v0, e2 = t.v2 - t.v0;
+        glm::vec3 p = glm::cross(dir, e2);
+        float det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-8f)
+            return false;
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - t.v0;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(dir, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        float hit = glm::dot(e2, q) * invDet;
+        return hit > LIGHTMAP_RAY_EPSILON && hit < tMax;
+    }
+};
+
+// A planar quad receiving a lightmap chart. Built from the model matrix of the unit quad [-0.5, 0.5]^2 (z = 0)
+// the walls and the ground are drawn with, so the local UV of a vertex is simply its position + 0.5.
+struct LightmapSurface {
+    glm::vec3 origin, edgeU, edgeV, normal;
+    int width, height; // chart size in texels
+    int x, y;          // chart position in the atlas
+    glm::vec4 rect;    // scale.xy, offset.zw mapping the local UV into the atlas
+
+    static LightmapSurface fromQuad(const glm::mat4& model)
+    {
+        LightmapSurface s;
+        s.origin = glm::vec3(model * glm::vec4(-0.5f, -0.5f, 0.0f, 1.0f));
+        s.edgeU = glm::vec3(model * glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+        s.edgeV = glm::vec3(model * glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+        s.normal = glm::normalize(glm::mat3(glm::transpose(glm::inverse(model))) * glm::vec3(0.0f, 0.0f, -1.0f));
+        s.width = std::max(1, (int)std::ceil(glm::length(s.edgeU) * LIGHTMAP_TEXELS_PER_UNIT));
+        s.height = std::max(1, (int)std::ceil(glm::length(s.edgeV) * LIGHTMAP_TEXELS_PER_UNIT));
+        s.x = s.y = 0;
+        s.rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+        return s;
+    }
+};
+
+// Bakes the diffuse irradiance of static lights into an atlas with one layer per light, baked at unit strength.
+// The shader multiplies each layer by the current strength of its light, so static lights may still be dimmed
+// or switched on and off; any other change to a baked light makes it fall back to per-fragment lighting.
+class LightmapBaker
+{
+public:
+    std::vector<LightmapSurface> surfaces;
+    std::vector<unsigned int> bakedLights; // light index of every atlas layer
+    int atlasWidth, atlasHeight;
+    std::vector<float> texels;             // RGB, layer after layer
+    unsigned int texture;
+
+    LightmapBaker() : atlasWidth(0), atlasHeight(0), texture(0)
+    {
+    }
+
+    unsigned int addSurface(const glm::mat4& quadModel)
+    {
+        surfaces.push_back(LightmapSurface::fromQuad(quadModel));
+        return (unsigned int)surfaces.size() - 1;
+    }
+
+    void addOccluder(const BakeTriangle& triangle)
+    {
+        occluders.push_back(triangle);
+    }
+
+    // adds every triangle of an indexed mesh transformed by model
+    template <typename VertexT>
+    void addOccluderMesh(const std::vector<VertexT>& vertices, const std::vector<unsigned int>& indices, const glm::mat4& model)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            BakeTriangle t;
+            t.v0 = glm::vec3(model * glm::vec4(vertices[indices[i]].Position, 1.0f));
+            t.v1 = glm::vec3(model * glm::vec4(vertices[indices[i + 1]].Position, 1.0f));
+            t.v2 = glm::vec3(model * glm::vec4(vertices[indices[i + 2]].Position, 1.0f));
+            occluders.push_back(t);
+        }
+    }
+
+    // loads the atlas from cachePath when it was baked from the same scene, bakes and saves it otherwise
+    void bake(const LightSystem& lights, const std::string& cachePath)
+    {
+        bakedLights.clear();
+        for (unsigned int i = 0; i < lights.size(); i++)
+            if (lights.isStatic[i])
+                bakedLights.push_back(i);
+
+        packCharts();
+        uint64_t key = sceneKey(lights);
+        if (load(cachePath, key))
+        {
+            std::cout << "Lightmap loaded from " << cachePath << std::endl;
+        }
+        else
+        {
+            bvh.build(occluders);
+            texels.assign((size_t)atlasWidth * atlasHeight * 3 * bakedLights.size(), 0.0f);
+            for (unsigned int layer = 0; layer < bakedLights.size(); layer++)
+                bakeLayer(lights, layer);
+            save(cachePath, key);
+            std::cout << "Lightmap baked: " << atlasWidth << "x" << atlasHeight << " x " << bakedLights.size()
+                << " layers, " << occluders.size() << " occluders" << std::endl;
+        }
+        bakedParams.resize(bakedLights.size());
+        for (unsigned int layer = 0; layer < bakedLights.size(); layer++)
+            lightParams(lights, bakedLights[layer], bakedParams[layer]);
+        bakedVersion = ~0ull;
+        upload();
+    }
+
+    // binds the atlas and tells the shader which lights come from it, call before drawing a surface
+    void apply(const Shader& shader, const LightSystem& lights, unsigned int surface, int textureUnit)
+    {
+        refreshValidity(lights);
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1i(glGetUniformLocation(shader.ID, "lightmap"), textureUnit);
+        glUniform1i(glGetUniformLocation(shader.ID, "useLightmap"), texture != 0 ? 1 : 0);
+        glUniform4fv(glGetUniformLocation(shader.ID, "lightmapRect"), 1, &surfaces[surface].rect[0]);
+        glUniform1iv(glGetUniformLocation(shader.ID, "bakedLayer"), LIGHT_SHADER_MAX, layerOfLight);
+    }
+
+    // geometry that is not part of the atlas (doors, eye) lights everything per fragment
+    static void disable(const Shader& shader)
+    {
+        glUniform1i(glGetUniformLocation(shader.ID, "useLightmap"), 0);
+    }
+
+private:
+    std::vector<BakeTriangle> occluders;
+    TriangleBVH bvh;
+    // everything but the strength, which is applied at runtime
+    struct LightParams {
+        float values[14];
+    };
+
+    std::vector<LightParams> bakedParams;
+    uint64_t bakedVersion;
+    int layerOfLight[LIGHT_SHADER_MAX];
+
+    // shelf packing of the charts, tallest first
+    void packCharts()
+    {
+        std::vector<unsigned int> sorted(surfaces.size());
+        int totalArea = 0, widest = 0;
+        for (unsigned int i = 0; i < surfaces.size(); i++)
+        {
+            sorted[i] = i;
+            totalArea += (surfaces[i].width + LIGHTMAP_PADDING * 2) * (surfaces[i].height + LIGHTMAP_PADDING * 2);
+            widest = std::max(widest, surfaces[i].width + LIGHTMAP_PADDING * 2);
+        }
+        std::sort(sorted.begin(), sorted.end(), [this](unsigned int a, unsigned int b) { return surfaces[a].height > surfaces[b].height; });
+
+        atlasWidth = 1;
+        while (atlasWidth < widest || atlasWidth * atlasWidth < totalArea)
+            atlasWidth *= 2;
+        int x = 0, y = 0, shelf = 0;
+        for (unsigned int k = 0; k < sorted.size(); k++)
+        {
+            LightmapSurface& s = surfaces[sorted[k]];
+            int w = s.width + LIGHTMAP_PADDING * 2, h = s.height + LIGHTMAP_PADDING * 2;
+            if (x + w > atlasWidth)
+            {
+                x = 0;
+                y += shelf;
+                shelf = 0;
+            }
+            s.x = x + LIGHTMAP_PADDING;
+            s.y = y + LIGHTMAP_PADDING;
+            x += w;
+            shelf = std::max(shelf, h);
+        }
+        atlasHeight = 1;
+        while (atlasHeight < y + shelf)
+            atlasHeight *= 2;
+        for (unsigned int i = 0; i < surfaces.size(); i++)
+        {
+            LightmapSurface& s = surfaces[i];
+            s.rect = glm::vec4((float)s.width / atlasWidth, (float)s.height / atlasHeight,
+                (float)s.x / atlasWidth, (float)s.y / atlasHeight);
+        }
+    }
+
+    // diffuse term of Wall.frag for one light at unit strength, without the view dependent specular
+    static glm::vec3 irradiance(const LightSystem& lights, unsigned int i, glm::vec3 p, glm::vec3 n, float& dist)
+    {
+        glm::vec3 toLight = lights.position(i) - p;
+        dist = glm::length(toLight);
+        if (dist <= 0.0f)
+            return glm::vec3(0.0f);
+        glm::vec3 lightDir = toLight / dist;
+        float diff = std::max(glm::dot(n, lightDir), 0.0f);
+        if (diff <= 0.0f)
+            return glm::vec3(0.0f);
+        float factor = lightAttenuation(dist, lights.range[i], lights.radius[i]);
+        if (factor <= 0.0f)
+            return glm::vec3(0.0f);
+        if (lights.isSpot[i])
+        {
+            float theta = glm::dot(lightDir, -lights.spotDirection(i));
+            if (theta <= lights.cosCutOff[i])
+                return glm::vec3(0.0f);
+            float epsilon = lights.cosCutOff[i] - lights.cosOuterCutOff[i];
+            float intensity = glm::clamp((theta - lights.cosOuterCutOff[i]) / epsilon, 0.0f, 1.0f);
+            factor *= 1.0f - intensity;
+        }
+        return factor * 0.3f * diff * lights.color(i);
+    }
+
+    void bakeLayer(const LightSystem& lights, unsigned int layer)
+    {
+        unsigned int light = bakedLights[layer];
+        float* out = &texels[(size_t)atlasWidth * atlasHeight * 3 * layer];
+        for (unsigned int si = 0; si < surfaces.size(); si++)
+        {
+            const LightmapSurface& s = surfaces[si];
+            // rows are independent, split them across the job system
+            unsigned int rows = s.height + LIGHTMAP_PADDING * 2;
+            JobSystem::instance().parallelFor(rows, 1, [this, &lights, &s, light, out](unsigned int begin, unsigned int end) {
+                bakeRows(lights, s, light, out, (int)begin, (int)end);
+            }, "Lightmap bake");
+        }
+    }
+
+    // rows are counted from the top of the padding, gutter texels take the value of the closest chart texel
+    void bakeRows(const LightSystem& lights, const LightmapSurface& s, unsigned int light, float* out, int begin, int end) const
+    {
+        for (int row = begin; row < end; row++)
+        {
+            int ty = row - LIGHTMAP_PADDING;
+            float v = glm::clamp((ty + 0.5f) / s.height, 0.5f / s.height, 1.0f - 0.5f / s.height);
+            for (int tx = -LIGHTMAP_PADDING; tx < s.width + LIGHTMAP_PADDING; tx++)
+            {
+                float u = glm::clamp((tx + 0.5f) / s.width, 0.5f / s.width, 1.0f - 0.5f / s.width);
+                glm::vec3 p = s.origin + u * s.edgeU + v * s.edgeV;
+                float dist;
+                glm::vec3 e = irradiance(lights, light, p, s.normal, dist);
+                if (e != glm::vec3(0.0f))
+                {
+                    glm::vec3 origin = p + s.normal * LIGHTMAP_RAY_EPSILON;
+                    glm::vec3 dir = (lights.position(light) - origin) / dist;
+                    if (bvh.occluded(origin, dir, dist - 10.0f * LIGHTMAP_RAY_EPSILON))
+                        e = glm::vec3(0.0f);
+                }
+                size_t texel = ((size_t)(s.y + ty) * atlasWidth + (s.x + tx)) * 3;
+                out[texel] = e.r;
+                out[texel + 1] = e.g;
+                out[texel + 2] = e.b;
+            }
+        }
+    }
+
+    static void lightParams(const LightSystem& lights, unsigned int i, LightParams& out)
+    {
+        float p[] = { lights.posX[i], lights.posY[i], lights.posZ[i], lights.colorR[i], lights.colorG[i], lights.colorB[i],
+            lights.dirX[i], lights.dirY[i], lights.dirZ[i], lights.range[i], lights.radius[i], lights.cutOff[i], lights.outerCutOff[i], (float)lights.isSpot[i] };
+        static_assert(sizeof(p) == sizeof(out.values), "LightParams does not match the light parameters");
+        std::memcpy(out.values, p, sizeof(p));
+    }
+
+    static bool sameParams(const LightParams& a, const LightParams& b)
+    {
+        return std::equal(a.values, a.values + sizeof(a.values) / sizeof(float), b.values);
+    }
+
+    // FNV-1a over everything the bake depends on
+    uint64_t sceneKey(const LightSystem& lights) const
+    {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const void* data, size_t size) {
+            const unsigned char* bytes = (const unsigned char*)data;
+            for (size_t k = 0; k < size; k++)
+                h = (h ^ bytes[k]) * 1099511628211ull;
+        };
+        mix(&LIGHTMAP_TEXELS_PER_UNIT, sizeof(float));
+        for (unsigned int layer = 0; layer < bakedLights.size(); layer++)
+        {
+            LightParams p;
+            lightParams(lights, bakedLights[layer], p);
+            mix(p.values, sizeof(p.values));
+        }
+        for (unsigned int i = 0; i < surfaces.size(); i++)
+        {
+            mix(&surfaces[i].origin, sizeof(glm::vec3));
+            mix(&surfaces[i].edgeU, sizeof(glm::vec3));
+            mix(&surfaces[i].edgeV, sizeof(glm::vec3));
+        }
+        if (!occluders.empty())
+            mix(occluders.data(), occluders.size() * sizeof(BakeTriangle));
+        return h;
+    }
+
+    bool load(const std::string& path, uint64_t key)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file)
+            return false;
+        uint32_t header[5];
+        uint64_t fileKey;
+        file.read((char*)header, sizeof(header));
+        file.read((char*)&fileKey, sizeof(fileKey));
+        if (!file || header[0] != LIGHTMAP_FILE_MAGIC || header[1] != LIGHTMAP_FILE_VERSION || fileKey != key
+            || (int)header[2] != atlasWidth || (int)header[3] != atlasHeight || header[4] != bakedLights.size())
+            return false;
+        texels.resize((size_t)atlasWidth * atlasHeight * 3 * bakedLights.size());
+        file.read((char*)texels.data(), texels.size() * sizeof(float));
+        return (bool)file;
+    }
+
+    void save(const std::string& path, uint64_t key) const
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            std::cout << "Lightmap could not be written to " << path << std::endl;
+            return;
+        }
+        uint32_t header[5] = { LIGHTMAP_FILE_MAGIC, LIGHTMAP_FILE_VERSION, (uint32_t)atlasWidth, (uint32_t)atlasHeight, (uint32_t)bakedLights.size() };
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)&key, sizeof(key));
+        file.write((const char*)texels.data(), texels.size() * sizeof(float));
+    }
+
+    void upload()
+    {
+        if (bakedLights.empty())
+            return;
+        if (texture == 0)
+            glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB16F, atlasWidth, atlasHeight, (GLsizei)bakedLights.size(), 0, GL_RGB, GL_FLOAT, texels.data());
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    // a baked light whose parameters (other than strength) changed is lit per fragment again
+    void refreshValidity(const LightSystem& lights)
+    {
+        if (bakedVersion == lights.getVersion())
+            return;
+        bakedVersion = lights.getVersion();
+        for (int i = 0; i < LIGHT_SHADER_MAX; i++)
+            layerOfLight[i] = -1;
+        for (unsigned int layer = 0; layer < bakedLights.size(); layer++)
+        {
+            unsigned int light = bakedLights[layer];
+            if (light >= (unsigned int)LIGHT_SHADER_MAX)
+                continue;
+            LightParams current;
+            lightParams(lights, light, current);
+            if (sameParams(current, bakedParams[layer]))
+                layerOfLight[light] = (int)layer;
+        }
+    }
+};
+#endif
@@ -0,0 +1,258 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <vector>
+#include <string>
+#include <new>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <cassert>
+
+// size of the first block of an arena, it grows to what a frame needs after the first frames
+const size_t FRAME_ARENA_BLOCK_SIZE = 64 * 1024;
+// frames skipped by FrameAllocationCheck while the containers and arenas reach their steady size
+const unsigned int FRAME_ALLOCATION_WARMUP = 120;
+
+// Linear allocator for the data of one frame.
+// Allocating only moves a pointer and nothing is freed one by one: reset() drops everything at once when the frame
+// is over. When a frame needs more than the current block, another block is taken from the heap; the next reset()
+// replaces them with a single block of the total size, so after a few frames a frame makes no heap allocation.
+class FrameArena
+{
+public:
+    FrameArena(size_t blockSize = FRAME_ARENA_BLOCK_SIZE) : offset(0), total(0), highWater(0), firstBlockSize(blockSize)
+    {
+    }
+
+    ~FrameArena()
+    {
+        release();
+    }
+
+    // the blocks belong to one arena
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        if (!blocks.empty())
+        {
+            uintptr_t base = (uintptr_t)blocks.back().data;
+            size_t aligned = (size_t)(((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+            if (aligned + size <= blocks.back().size)
+            {
+                offset = aligned + size;
+                total += size;
+                return (char*)blocks.back().data + aligned;
+            }
+        }
+        size_t blockSize = blocks.empty() ? firstBlockSize : blocks.back().size * 2;
+        while (blockSize < size + alignment)
+            blockSize *= 2;
+        addBlock(blockSize);
+        return allocate(size, alignment);
+    }
+
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        return (T*)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    // frees everything allocated since the last reset
+    void reset()
+    {
+        if (total > highWater)
+            highWater = total;
+        if (blocks.size() > 1)
+        {
+            size_t size = 0;
+            for (unsigned int i = 0; i < blocks.size(); i++)
+                size += blocks[i].size;
+            release();
+            addBlock(size);
+        }
+        offset = 0;
+        total = 0;
+    }
+
+    // bytes allocated since the last reset
+    size_t used() const
+    {
+        return total;
+    }
+
+    // most bytes a frame used
+    size_t peak() const
+    {
+        return total > highWater ? total : highWater;
+    }
+
+private:
+    struct Block {
+        void* data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t offset; // in the last block
+    size_t total;
+    size_t highWater;
+    size_t firstBlockSize;
+
+    void addBlock(size_t size)
+    {
+        Block block = { ::operator new(size), size };
+        blocks.push_back(block);
+        offset = 0;
+    }
+
+    void release()
+    {
+        for (unsigned int i = 0; i < blocks.size(); i++)
+            ::operator delete(blocks[i].data);
+        blocks.clear();
+    }
+};
+
+// Arenas of the frames in flight: the data of frame N stays valid while frame N + 1 is built in the other arena,
+// e.g. for a consumer that is one frame late.
+class DoubleBufferedArena
+{
+public:
+    DoubleBufferedArena() : current(0)
+    {
+    }
+
+    // switches to the other arena and resets it
+    FrameArena& beginFrame()
+    {
+        current ^= 1;
+        arenas[current].reset();
+        return arenas[current];
+    }
+
+    FrameArena& get()
+    {
+        return arenas[current];
+    }
+
+    FrameArena& previous()
+    {
+        return arenas[current ^ 1];
+    }
+
+private:
+    FrameArena arenas[2];
+    unsigned int current;
+};
+
+// STL allocator over a FrameArena, deallocate does nothing. Without an arena it uses the heap, so the containers
+// of a class can take an arena only when the caller has one.
+template <typename T>
+class FrameAllocator
+{
+public:
+    typedef T value_type;
+    // containers keep the arena they were given, also when assigned or swapped
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    FrameArena* arena;
+
+    FrameAllocator(FrameArena* _arena = NULL) : arena(_arena)
+    {
+    }
+
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        if (arena)
+            return arena->allocate<T>(n);
+        return (T*)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        if (!arena)
+            ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>& other) const
+    {
+        return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const FrameAllocator<U>& other) const
+    {
+        return arena != other.arena;
+    }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
+typedef std::basic_string<char, std::char_traits<char>, FrameAllocator<char> > FrameString;
+
+// With FRAME_ALLOCATION_CHECK defined, operator new is replaced to count the allocations of each thread (see the
+// main file) and FrameAllocationCheck asserts that the frames of a thread make none once warmed up.
+#ifdef FRAME_ALLOCATION_CHECK
+inline unsigned long long& heapAllocationCount()
+{
+    static thread_local unsigned long long count = 0;
+    return count;
+}
+#endif
+
+// checks one part of the frame of the calling thread, between beginFrame() and endFrame()
+class FrameAllocationCheck
+{
+public:
+    FrameAllocationCheck(const char* _name, unsigned int _warmup = FRAME_ALLOCATION_WARMUP)
+        : name(_name), warmup(_warmup), frame(0), start(0), skip(false)
+    {
+    }
+
+    // the current frame is not checked, for the frames that do extra work such as profiling or a GL capture
+    void skipFrame()
+    {
+        skip = true;
+    }
+
+    void beginFrame()
+    {
+#ifdef FRAME_ALLOCATION_CHECK
+        start = heapAllocationCount();
+#endif
+    }
+
+    void endFrame()
+    {
+#ifdef FRAME_ALLOCATION_CHECK
+        unsigned long long count = heapAllocationCount() - start;
+        if (frame >= warmup && count > 0 && !skip)
+        {
+            std::cout << "ERROR::FRAME_ALLOCATION:: " << name << " frame " << frame << " made " << count << " heap allocations" << std::endl;
+            assert(count == 0);
+        }
+#endif
+        skip = false;
+        frame++;
+    }
+
+private:
+    const char* name;
+    unsigned int warmup;
+    unsigned int frame;
+    unsigned long long start;
+    bool skip;
+};
+#endif
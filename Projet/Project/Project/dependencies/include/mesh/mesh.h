@@ -31,6 +31,58 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// bounding volumes in the mesh's local space
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center;
+    float radius;
+};
+
+// bounds of a set of points, the sphere is centered on the box
+inline Bounds computeBounds(const glm::vec3* points, size_t count, size_t stride = sizeof(glm::vec3))
+{
+    Bounds b;
+    b.min = glm::vec3(0.0f);
+    b.max = glm::vec3(0.0f);
+    const char* p = (const char*)points;
+    for (size_t i = 0; i < count; i++, p += stride)
+    {
+        const glm::vec3& v = *(const glm::vec3*)p;
+        b.min = i == 0 ? v : glm::min(b.min, v);
+        b.max = i == 0 ? v : glm::max(b.max, v);
+    }
+    b.center = (b.min + b.max) * 0.5f;
+    b.radius = 0.0f;
+    p = (const char*)points;
+    for (size_t i = 0; i < count; i++, p += stride)
+        b.radius = glm::max(b.radius, glm::length(*(const glm::vec3*)p - b.center));
+    return b;
+}
+
+// world space bounds of local bounds moved by model: box of the transformed box, sphere scaled by the largest axis
+inline Bounds transformBounds(const Bounds& local, const glm::mat4& model)
+{
+    Bounds b;
+    glm::vec3 translation = glm::vec3(model[3]);
+    b.min = translation;
+    b.max = translation;
+    for (int col = 0; col < 3; col++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            float e = model[col][row] * local.min[col];
+            float f = model[col][row] * local.max[col];
+            b.min[row] += glm::min(e, f);
+            b.max[row] += glm::max(e, f);
+        }
+    }
+    b.center = glm::vec3(model * glm::vec4(local.center, 1.0f));
+    float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    b.radius = local.radius * scale;
+    return b;
+}
+
 struct Texture {
     unsigned int id;
     string type;
@@ -43,6 +95,7 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    Bounds               bounds;
     unsigned int VAO;
 
     // constructor
@@ -51,6 +104,8 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->bounds = computeBounds(vertices.empty() ? NULL : &vertices[0].Position, vertices.size(), sizeof(Vertex));
+        this->samplerNames = computeSamplerNames(textures);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -60,27 +115,11 @@ public:
     void Draw(Shader& shader)
     {
         // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
         for (unsigned int i = 0; i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if (name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+            glUniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), i);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
@@ -97,6 +136,34 @@ public:
 private:
     // render data 
     unsigned int VBO, EBO;
+    // sampler uniform of each texture, built once so that drawing makes no string
+    vector<string> samplerNames;
+
+    // the Nth texture of a type goes to the sampler typeN (texture_diffuse1, texture_diffuse2, ...)
+    static vector<string> computeSamplerNames(const vector<Texture>& textures)
+    {
+        unsigned int diffuseNr = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr = 1;
+        unsigned int heightNr = 1;
+        vector<string> names;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            // retrieve texture number (the N in diffuse_textureN)
+            string number;
+            string name = textures[i].type;
+            if (name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular")
+                number = std::to_string(specularNr++); // transfer unsigned int to string
+            else if (name == "texture_normal")
+                number = std::to_string(normalNr++); // transfer unsigned int to string
+            else if (name == "texture_height")
+                number = std::to_string(heightNr++); // transfer unsigned int to string
+            names.push_back(name + number);
+        }
+        return names;
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -12,6 +12,7 @@
 
 #include <mesh/mesh.h>
 #include <shader/shader_s.h>
+#include <jobs/JobSystem.h>
 
 #include <string>
 #include <fstream>
@@ -22,6 +23,15 @@
 using namespace std;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+void uploadTexture(unsigned int textureID, const unsigned char* data, int width, int height, int nrComponents);
+
+// texture whose id is already given to the meshes, decoded by a job and then uploaded by the GL thread
+struct PendingTexture {
+    unsigned int id;
+    string filename;
+    unsigned char* data;
+    int width, height, nrComponents;
+};
 
 class Model
 {
@@ -45,7 +55,17 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws only the meshes flagged visible by the culling, visible[i] is for meshes[i]
+    void Draw(Shader& shader, const unsigned char* visible)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            if (visible[i])
+                meshes[i].Draw(shader);
+    }
+
 private:
+    vector<PendingTexture> pendingTextures;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
     {
@@ -63,6 +83,35 @@ private:
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+        loadPendingTextures();
+    }
+
+    // the images are decoded in parallel, then uploaded by the thread that owns the GL context
+    void loadPendingTextures()
+    {
+        JobSystem& jobs = JobSystem::instance();
+        JobCounter decoded, uploaded;
+        for (unsigned int i = 0; i < pendingTextures.size(); i++)
+        {
+            PendingTexture* texture = &pendingTextures[i];
+            jobs.submit([texture]() {
+                texture->data = stbi_load(texture->filename.c_str(), &texture->width, &texture->height, &texture->nrComponents, 0);
+            }, &decoded, "Texture decode");
+        }
+        jobs.submit([this]() {
+            for (unsigned int i = 0; i < pendingTextures.size(); i++)
+            {
+                PendingTexture& texture = pendingTextures[i];
+                if (texture.data)
+                    uploadTexture(texture.id, texture.data, texture.width, texture.height, texture.nrComponents);
+                else
+                    std::cout << "Texture failed to load at path: " << texture.filename << std::endl;
+                stbi_image_free(texture.data);
+            }
+        }, &uploaded, "Texture upload", JOB_GL_THREAD, &decoded);
+        jobs.wait(uploaded);
+        jobs.wait(decoded);
+        pendingTextures.clear();
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -164,7 +213,7 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-        // return a mesh object created from the extracted mesh data
+        // return a mesh object created from the extracted mesh data, its AABB and bounding sphere are computed from the vertices
         return Mesh(vertices, indices, textures);
     }
 
@@ -189,9 +238,11 @@ private:
                 }
             }
             if (!skip)
-            {   // if texture hasn't been loaded already, load it
+            {   // if texture hasn't been loaded already, reserve its id, the image is loaded with the others at the end
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                glGenTextures(1, &texture.id);
+                PendingTexture pending = { texture.id, this->directory + '/' + str.C_Str(), NULL, 0, 0, 0 };
+                pendingTextures.push_back(pending);
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -215,23 +266,7 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
     unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
     if (data)
     {        
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
+        uploadTexture(textureID, data, width, height, nrComponents);
         stbi_image_free(data);
     }
     else
@@ -242,4 +277,24 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
 
     return textureID;
 }
+
+void uploadTexture(unsigned int textureID, const unsigned char* data, int width, int height, int nrComponents)
+{
+    GLenum format;
+    if (nrComponents == 1)
+        format = GL_RED;
+    else if (nrComponents == 3)
+        format = GL_RGB;
+    else if (nrComponents == 4)
+        format = GL_RGBA;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 #endif
\ No newline at end of file
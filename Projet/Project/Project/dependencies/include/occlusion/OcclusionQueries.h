@@ -0,0 +1,195 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <shader/shader_s.h>
+#include <mesh/mesh.h>
+
+#include <vector>
+
+// objects seen visible are only queried again every this many frames, spread over the frames by object id
+const unsigned int OCCLUSION_VISIBLE_INTERVAL = 4;
+// the proxy box is inflated so its faces do not z-fight with the object or the wall it stands against
+const float OCCLUSION_PROXY_MARGIN = 0.05f;
+
+// Hardware occlusion culling of expensive models with GL_ANY_SAMPLES_PASSED queries.
+// Every object keeps the result of its last query (temporal coherence):
+// - visible last frame: drawn normally, the real draw is itself the query, and only every few frames
+// - hidden last frame: its bounding box is drawn without color or depth writes inside a query, and the real draw
+//   is wrapped in a conditional render on that query, so the GPU skips it without the CPU waiting for the result.
+// Results are read back one frame later, only when available, and feed the next frame's choice.
+// Occluders (walls, ground) must be drawn before the objects for the queries to see them.
+class OcclusionQueries
+{
+public:
+    // counters of the current frame
+    unsigned int proxiesDrawn;
+    unsigned int conditionalDraws;
+    unsigned int hiddenLastFrame;
+
+    OcclusionQueries() : proxiesDrawn(0), conditionalDraws(0), hiddenLastFrame(0), proxyProgram(0), cubeVAO(0), cubeVBO(0), cubeEBO(0), frame(0)
+    {
+    }
+
+    // needs a current GL context. proxyShader transforms aPos by model and the camera block, and writes nothing.
+    void init(const Shader& proxyShader)
+    {
+        proxyProgram = proxyShader.ID;
+        float vertices[] = {
+            0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 1.0f
+        };
+        unsigned int indices[] = {
+            0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+            3, 6, 2, 3, 7, 6,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5
+        };
+        glGenVertexArrays(1, &cubeVAO);
+        glGenBuffers(1, &cubeVBO);
+        glGenBuffers(1, &cubeEBO);
+        glBindVertexArray(cubeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+    }
+
+    // before the GL context is destroyed, the objects are dropped
+    void release()
+    {
+        if (!queries.empty())
+            glDeleteQueries((GLsizei)queries.size(), &queries[0]);
+        queries.clear();
+        visible.clear();
+        issued.clear();
+        if (cubeVAO)
+        {
+            glDeleteVertexArrays(1, &cubeVAO);
+            glDeleteBuffers(1, &cubeVBO);
+            glDeleteBuffers(1, &cubeEBO);
+        }
+        cubeVAO = cubeVBO = cubeEBO = 0;
+    }
+
+    // registers an object, returns its id. New objects start visible.
+    unsigned int add()
+    {
+        unsigned int id = (unsigned int)visible.size();
+        unsigned int pair[2];
+        glGenQueries(2, pair);
+        queries.push_back(pair[0]);
+        queries.push_back(pair[1]);
+        visible.push_back(1);
+        issued.push_back(0);
+        return id;
+    }
+
+    // reads back the results of the queries issued last frame that are already available
+    void beginFrame()
+    {
+        frame++;
+        proxiesDrawn = 0;
+        conditionalDraws = 0;
+        hiddenLastFrame = 0;
+        unsigned int previous = (frame - 1) & 1;
+        for (unsigned int id = 0; id < visible.size(); id++)
+        {
+            if (issued[id] & (1 << previous))
+            {
+                GLuint query = queries[id * 2 + previous];
+                GLint available = 0;
+                glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    GLuint samples = 0;
+                    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+                    visible[id] = samples ? 1 : 0;
+                }
+                else
+                {
+                    // still in flight: assume visible rather than wait
+                    visible[id] = 1;
+                }
+                issued[id] &= ~(1 << previous);
+            }
+            hiddenLastFrame += visible[id] ? 0 : 1;
+        }
+    }
+
+    // result of the last query read back for an object
+    bool isVisible(unsigned int id) const
+    {
+        return visible[id] != 0;
+    }
+
+    // draws an object through its query, drawReal() issues the real draw calls.
+    // world is its world space bounding box and viewPos the camera position.
+    template <typename DrawFn>
+    void draw(unsigned int id, const Bounds& world, glm::vec3 viewPos, DrawFn drawReal)
+    {
+        unsigned int current = frame & 1;
+        GLuint query = queries[id * 2 + current];
+        glm::vec3 bmin = world.min - glm::vec3(OCCLUSION_PROXY_MARGIN);
+        glm::vec3 bmax = world.max + glm::vec3(OCCLUSION_PROXY_MARGIN);
+        // the near plane would clip the proxy of a box the camera is in
+        bool inside = glm::all(glm::greaterThanEqual(viewPos, bmin)) && glm::all(glm::lessThanEqual(viewPos, bmax));
+
+        if (visible[id] || inside)
+        {
+            if (inside || (frame + id) % OCCLUSION_VISIBLE_INTERVAL != 0)
+            {
+                drawReal();
+                return;
+            }
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+            drawReal();
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            issued[id] |= 1 << current;
+            return;
+        }
+
+        drawProxy(query, bmin, bmax);
+        issued[id] |= 1 << current;
+        proxiesDrawn++;
+        glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+        drawReal();
+        glEndConditionalRender();
+        conditionalDraws++;
+    }
+
+private:
+    unsigned int proxyProgram;
+    unsigned int cubeVAO, cubeVBO, cubeEBO;
+    unsigned int frame;
+
+    // two queries per object, one written this frame while the other one from last frame is read back
+    std::vector<GLuint> queries;
+    std::vector<unsigned char> visible;
+    std::vector<unsigned char> issued; // bit i set when queries[id * 2 + i] holds an unread result
+
+    void drawProxy(GLuint query, glm::vec3 bmin, glm::vec3 bmax)
+    {
+        GLint program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        glUseProgram(proxyProgram);
+        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), bmin), bmax - bmin);
+        glUniformMatrix4fv(glGetUniformLocation(proxyProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+        glBindVertexArray(cubeVAO);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glUseProgram(program);
+    }
+};
+#endif
@@ -0,0 +1,285 @@
+#ifndef SOFTWARE_OCCLUSION_H
+#define SOFTWARE_OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <mesh/mesh.h>
+#include <jobs/JobSystem.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SOFTWARE_OCCLUSION_SSE 1
+#endif
+
+// coarse depth buffer, whatever the window size
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+// the hierarchical level keeps the farthest depth of each block of BLOCK x BLOCK pixels
+const int OCCLUSION_BLOCK = 8;
+const int OCCLUSION_BLOCKS_X = OCCLUSION_WIDTH / OCCLUSION_BLOCK;
+const int OCCLUSION_BLOCKS_Y = OCCLUSION_HEIGHT / OCCLUSION_BLOCK;
+// vertices closer than this w are clipped
+const float OCCLUSION_NEAR_W = 1e-3f;
+// occluder boxes are shrunk around their center so they can never hide the object they were made from
+const float OCCLUSION_OCCLUDER_SHRINK = 0.9f;
+
+// CPU occlusion culling without GPU feedback.
+// A few low-poly static occluders are rasterized every frame into a coarse depth buffer, in horizontal bands of
+// blocks processed by worker threads, 4 pixels at a time. Each band then reduces its blocks to their farthest depth.
+// An object is hidden when the nearest depth of its bounding box is behind the farthest occluder depth of every
+// block its screen rectangle touches, so the test is conservative and has no latency.
+class SoftwareOcclusion
+{
+public:
+    // counters of the tests since the last render
+    unsigned int tested;
+    unsigned int occluded;
+
+    SoftwareOcclusion() : tested(0), occluded(0), depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f), blockDepth(OCCLUSION_BLOCKS_X * OCCLUSION_BLOCKS_Y, 1.0f)
+    {
+    }
+
+    void addOccluder(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+    {
+        occluders.push_back(v0);
+        occluders.push_back(v1);
+        occluders.push_back(v2);
+        // the near plane clips a triangle to a quad at most, two triangles
+        screenTriangles.reserve(occluders.size() * 2);
+    }
+
+    // the unit quad [-0.5, 0.5]^2 (z = 0) the walls and the ground are drawn with, moved by model
+    void addOccluderQuad(const glm::mat4& model)
+    {
+        glm::vec3 a = glm::vec3(model * glm::vec4(-0.5f, -0.5f, 0.0f, 1.0f));
+        glm::vec3 b = glm::vec3(model * glm::vec4(0.5f, -0.5f, 0.0f, 1.0f));
+        glm::vec3 c = glm::vec3(model * glm::vec4(0.5f, 0.5f, 0.0f, 1.0f));
+        glm::vec3 d = glm::vec3(model * glm::vec4(-0.5f, 0.5f, 0.0f, 1.0f));
+        addOccluder(a, b, c);
+        addOccluder(a, c, d);
+    }
+
+    // a solid object used as an occluder through its box, shrunk by OCCLUSION_OCCLUDER_SHRINK
+    void addOccluderBox(const Bounds& world)
+    {
+        glm::vec3 center = (world.min + world.max) * 0.5f;
+        glm::vec3 half = (world.max - world.min) * 0.5f * OCCLUSION_OCCLUDER_SHRINK;
+        glm::vec3 corner[8];
+        for (int k = 0; k < 8; k++)
+            corner[k] = center + half * glm::vec3((k & 1) ? 1.0f : -1.0f, (k & 2) ? 1.0f : -1.0f, (k & 4) ? 1.0f : -1.0f);
+        const int faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+        for (int f = 0; f < 6; f++)
+        {
+            addOccluder(corner[faces[f][0]], corner[faces[f][1]], corner[faces[f][2]]);
+            addOccluder(corner[faces[f][0]], corner[faces[f][2]], corner[faces[f][3]]);
+        }
+    }
+
+    // rasterizes the occluders seen through viewProjection
+    void render(const glm::mat4& viewProjection)
+    {
+        tested = 0;
+        occluded = 0;
+        setupTriangles(viewProjection);
+
+        // bands of block rows are independent
+        JobSystem::instance().parallelFor(OCCLUSION_BLOCKS_Y, 1, [this](unsigned int begin, unsigned int end) {
+            renderBand((int)begin, (int)end);
+        }, "Occlusion raster");
+    }
+
+    // true when the world space box is certainly hidden by the occluders of the last render
+    bool isOccluded(const Bounds& world, const glm::mat4& viewProjection)
+    {
+        tested++;
+        glm::vec2 smin(FLT_MAX), smax(-FLT_MAX);
+        float nearest = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 p((corner & 1) ? world.max.x : world.min.x, (corner & 2) ? world.max.y : world.min.y, (corner & 4) ? world.max.z : world.min.z);
+            glm::vec4 clip = viewProjection * glm::vec4(p, 1.0f);
+            // the box crosses the near plane, it covers the camera
+            if (clip.w < OCCLUSION_NEAR_W)
+                return false;
+            glm::vec3 screen = toScreen(clip);
+            smin = glm::min(smin, glm::vec2(screen));
+            smax = glm::max(smax, glm::vec2(screen));
+            nearest = std::min(nearest, screen.z);
+        }
+        int x0 = std::max(0, (int)std::floor(smin.x));
+        int y0 = std::max(0, (int)std::floor(smin.y));
+        int x1 = std::min(OCCLUSION_WIDTH - 1, (int)std::ceil(smax.x));
+        int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)std::ceil(smax.y));
+        // off screen: the frustum culling decides
+        if (x0 > x1 || y0 > y1)
+            return false;
+        x0 /= OCCLUSION_BLOCK;
+        y0 /= OCCLUSION_BLOCK;
+        x1 /= OCCLUSION_BLOCK;
+        y1 /= OCCLUSION_BLOCK;
+        for (int by = y0; by <= y1; by++)
+        {
+            const float* row = &blockDepth[by * OCCLUSION_BLOCKS_X];
+            int bx = x0;
+#ifdef SOFTWARE_OCCLUSION_SSE
+            __m128 nearest4 = _mm_set1_ps(nearest);
+            for (; bx + 3 <= x1; bx += 4)
+                if (_mm_movemask_ps(_mm_cmple_ps(nearest4, _mm_loadu_ps(row + bx))))
+                    return false;
+#endif
+            for (; bx <= x1; bx++)
+                if (nearest <= row[bx])
+                    return false;
+        }
+        occluded++;
+        return true;
+    }
+
+private:
+    // world space occluder triangles, 3 vertices each
+    std::vector<glm::vec3> occluders;
+    // screen space triangles of the current render: x, y in pixels, z in [0, 1]
+    std::vector<glm::vec3> screenTriangles;
+    std::vector<float> depth;
+    std::vector<float> blockDepth;
+
+    static glm::vec3 toScreen(glm::vec4 clip)
+    {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z * 0.5f + 0.5f);
+    }
+
+    // transforms the occluders, clips them against the near plane and keeps them with a positive area
+    void setupTriangles(const glm::mat4& viewProjection)
+    {
+        screenTriangles.clear();
+        for (size_t t = 0; t + 2 < occluders.size(); t += 3)
+        {
+            glm::vec4 in[3];
+            for (int k = 0; k < 3; k++)
+                in[k] = viewProjection * glm::vec4(occluders[t + k], 1.0f);
+
+            // Sutherland-Hodgman against w = near, a triangle becomes at most a quad
+            glm::vec4 clipped[4];
+            int n = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                const glm::vec4& a = in[k];
+                const glm::vec4& b = in[(k + 1) % 3];
+                bool aIn = a.w >= OCCLUSION_NEAR_W, bIn = b.w >= OCCLUSION_NEAR_W;
+                if (aIn)
+                    clipped[n++] = a;
+                if (aIn != bIn)
+                    clipped[n++] = a + (b - a) * ((OCCLUSION_NEAR_W - a.w) / (b.w - a.w));
+            }
+            for (int k = 1; k + 1 < n; k++)
+            {
+                glm::vec3 s0 = toScreen(clipped[0]), s1 = toScreen(clipped[k]), s2 = toScreen(clipped[k + 1]);
+                float area = (s1.x - s0.x) * (s2.y - s0.y) - (s1.y - s0.y) * (s2.x - s0.x);
+                if (std::fabs(area) < 1e-6f)
+                    continue;
+                // occluders are two-sided, the winding is made counter clockwise
+                if (area < 0.0f)
+                    std::swap(s1, s2);
+                screenTriangles.push_back(s0);
+                screenTriangles.push_back(s1);
+                screenTriangles.push_back(s2);
+            }
+        }
+    }
+
+    // clears, rasterizes and reduces the rows of blocks [blockBegin, blockEnd)
+    void renderBand(int blockBegin, int blockEnd)
+    {
+        int yBegin = blockBegin * OCCLUSION_BLOCK;
+        int yEnd = blockEnd * OCCLUSION_BLOCK;
+        std::fill(depth.begin() + yBegin * OCCLUSION_WIDTH, depth.begin() + yEnd * OCCLUSION_WIDTH, 1.0f);
+        for (size_t t = 0; t + 2 < screenTriangles.size(); t += 3)
+            rasterize(&screenTriangles[t], yBegin, yEnd);
+
+        for (int by = blockBegin; by < blockEnd; by++)
+        {
+            for (int bx = 0; bx < OCCLUSION_BLOCKS_X; bx++)
+            {
+                float farthest = 0.0f;
+                for (int y = by * OCCLUSION_BLOCK; y < (by + 1) * OCCLUSION_BLOCK; y++)
+                {
+                    const float* row = &depth[y * OCCLUSION_WIDTH + bx * OCCLUSION_BLOCK];
+                    for (int x = 0; x < OCCLUSION_BLOCK; x++)
+                        farthest = std::max(farthest, row[x]);
+                }
+                blockDepth[by * OCCLUSION_BLOCKS_X + bx] = farthest;
+            }
+        }
+    }
+
+    // edge functions evaluated at the pixel centers, depth interpolated on the plane of the triangle
+    void rasterize(const glm::vec3* v, int yBegin, int yEnd)
+    {
+        float minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+        float maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+        float minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+        float maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+        int x0 = std::max(0, (int)std::floor(minX)) & ~3;
+        int x1 = std::min(OCCLUSION_WIDTH - 1, (int)std::ceil(maxX));
+        int y0 = std::max(yBegin, (int)std::floor(minY));
+        int y1 = std::min(yEnd - 1, (int)std::ceil(maxY));
+        if (x0 > x1 || y0 > y1)
+            return;
+
+        // edge k is >= 0 on the inside: e = a x + b y + c
+        float a[3], b[3], c[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const glm::vec3& p = v[(k + 1) % 3];
+            const glm::vec3& q = v[(k + 2) % 3];
+            a[k] = p.y - q.y;
+            b[k] = q.x - p.x;
+            c[k] = p.x * q.y - p.y * q.x;
+        }
+        float area = a[0] * v[0].x + b[0] * v[0].y + c[0];
+        // z = z0 + (e1 (z1 - z0) + e2 (z2 - z0)) / area, written as a plane za x + zb y + zc
+        float d1 = (v[1].z - v[0].z) / area, d2 = (v[2].z - v[0].z) / area;
+        float za = a[1] * d1 + a[2] * d2;
+        float zb = b[1] * d1 + b[2] * d2;
+        float zc = v[0].z + c[1] * d1 + c[2] * d2;
+
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            float* row = &depth[y * OCCLUSION_WIDTH];
+            int x = x0;
+#ifdef SOFTWARE_OCCLUSION_SSE
+            __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 zero = _mm_setzero_ps();
+            for (; x + 3 < OCCLUSION_WIDTH && x <= x1; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), px), _mm_set1_ps(b[0] * py + c[0]));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), px), _mm_set1_ps(b[1] * py + c[1]));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), px), _mm_set1_ps(b[2] * py + c[2]));
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+                if (!_mm_movemask_ps(inside))
+                    continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), _mm_set1_ps(zb * py + zc));
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 closer = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+            }
+#endif
+            for (; x <= x1; x++)
+            {
+                float px = x + 0.5f;
+                if (a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f || a[2] * px + b[2] * py + c[2] < 0.0f)
+                    continue;
+                row[x] = std::min(row[x], za * px + zb * py + zc);
+            }
+        }
+    }
+};
+#endif
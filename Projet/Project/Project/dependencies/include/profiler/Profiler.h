@@ -0,0 +1,441 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+// frames of GPU queries in flight, a frame is read back this many frames later so reading never waits for the GPU
+const unsigned int PROFILER_GPU_FRAMES = 4;
+// timestamps per frame, two per GPU range
+const unsigned int PROFILER_GPU_QUERIES = 64;
+// nesting of the scopes of a thread
+const unsigned int PROFILER_MAX_DEPTH = 32;
+// frames kept for the rolling statistics
+const unsigned int PROFILER_HISTORY = 240;
+// the GPU clock is matched to the CPU clock again this often, in seconds
+const double PROFILER_CALIBRATION_INTERVAL = 1.0;
+
+// a timed range, in microseconds since the profiler started
+struct ProfileEvent {
+    const char* name;
+    double start, duration;
+    unsigned int thread;
+    bool gpu;
+};
+
+// rolling totals of one name per frame
+struct ProfileStat {
+    const char* name;
+    bool gpu;
+    double frameTotal;          // of the frame being built, in ms
+    std::vector<float> history; // ring of the last PROFILER_HISTORY frame totals
+    unsigned int count;
+};
+
+// CPU and GPU frame profiler.
+// CPU ranges come from ProfileScope and from the hooks of the job system; GPU ranges are pairs of GL_TIMESTAMP
+// queries, which can nest unlike GL_TIME_ELAPSED, in a ring of PROFILER_GPU_FRAMES frames read back without
+// waiting. Every range adds its duration to the total of its name for the current frame, and beginFrame() pushes
+// the totals into the rolling history the report computes mean and percentiles from. While a capture runs the
+// ranges are also kept and written as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+// Disabled, a scope only reads a flag.
+class Profiler
+{
+public:
+    static Profiler& instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    Profiler() : enabled(false), capturing(false), origin(glfwGetTime()), frame(0), gpuReady(false), gpuFrame(0),
+        gpuOffset(0.0), gpuCalibrated(-1.0), gpuDropped(0)
+    {
+        for (unsigned int f = 0; f < PROFILER_GPU_FRAMES; f++)
+            for (unsigned int q = 0; q < PROFILER_GPU_QUERIES; q++)
+                gpuFrames[f].queries[q] = 0;
+    }
+
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool on)
+    {
+        enabled = on;
+    }
+
+    bool isCapturing() const
+    {
+        return capturing.load(std::memory_order_relaxed);
+    }
+
+    // keeps every range until stopCapture, also enables the profiler
+    void startCapture()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        trace.clear();
+        trace.reserve(1 << 16);
+        enabled = true;
+        capturing = true;
+    }
+
+    // writes the ranges kept since startCapture as a Chrome trace
+    bool stopCapture(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        capturing = false;
+        std::ofstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER:: cannot write " << path << std::endl;
+            return false;
+        }
+        file << "{\"traceEvents\":[\n";
+        for (unsigned int t = 0; t < threadNames.size(); t++)
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":\""
+                << threadNames[t] << "\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpuThread() << ",\"args\":{\"name\":\"GPU\"}}";
+        for (unsigned int i = 0; i < trace.size(); i++)
+        {
+            const ProfileEvent& e = trace[i];
+            file << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << (e.gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"ts\":"
+                << std::fixed << e.start << ",\"dur\":" << e.duration << ",\"pid\":1,\"tid\":" << (e.gpu ? gpuThread() : e.thread) << "}";
+            file.unsetf(std::ios::fixed);
+        }
+        file << "\n]}\n";
+        std::cout << "Profile of " << trace.size() << " ranges written to " << path << std::endl;
+        trace.clear();
+        return true;
+    }
+
+    // names the calling thread in the trace
+    void setThreadName(const char* name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        threadNames[threadIndexLocked()] = name;
+    }
+
+    // closes the frame of the statistics, from the main thread
+    void beginFrame()
+    {
+        if (!isEnabled())
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned int i = 0; i < stats.size(); i++)
+        {
+            ProfileStat& s = stats[i];
+            s.history[s.count % PROFILER_HISTORY] = (float)s.frameTotal;
+            s.count++;
+            s.frameTotal = 0.0;
+        }
+        frame++;
+    }
+
+    // microseconds since the profiler started
+    double now() const
+    {
+        return (glfwGetTime() - origin) * 1e6;
+    }
+
+    void cpuRange(const char* name, double start, double end)
+    {
+        if (!isEnabled())
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        addLocked(name, start, end - start, threadIndexLocked(), false);
+    }
+
+    // GPU ranges, from the thread that owns the GL context
+
+    // at the start of a GPU frame: reads the oldest frame of the ring back and starts a new one
+    void gpuBeginFrame()
+    {
+        if (!gpuReady)
+        {
+            if (!isEnabled())
+                return;
+            for (unsigned int f = 0; f < PROFILER_GPU_FRAMES; f++)
+            {
+                glGenQueries(PROFILER_GPU_QUERIES, gpuFrames[f].queries);
+                gpuFrames[f].used = 0;
+                gpuFrames[f].depth = 0;
+            }
+            gpuReady = true;
+        }
+        if (glfwGetTime() - gpuCalibrated > PROFILER_CALIBRATION_INTERVAL)
+        {
+            GLint64 gpu = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpu);
+            gpuCalibrated = glfwGetTime();
+            gpuOffset = (gpuCalibrated - origin) * 1e6 - gpu * 1e-3;
+        }
+        gpuFrame = (gpuFrame + 1) % PROFILER_GPU_FRAMES;
+        collectGpu(gpuFrames[gpuFrame]);
+    }
+
+    // returns whether the range was opened and needs gpuEnd()
+    bool gpuBegin(const char* name)
+    {
+        if (!gpuReady || !isEnabled())
+            return false;
+        GpuFrame& f = gpuFrames[gpuFrame];
+        if (f.depth >= PROFILER_MAX_DEPTH)
+            return false;
+        if (f.used + 2 > PROFILER_GPU_QUERIES)
+        {
+            f.open[f.depth++] = -1;
+            return true;
+        }
+        GpuRange range = { name, f.used, f.used + 1 };
+        glQueryCounter(f.queries[f.used], GL_TIMESTAMP);
+        f.used += 2;
+        f.open[f.depth++] = (int)f.ranges.size();
+        f.ranges.push_back(range);
+        return true;
+    }
+
+    void gpuEnd()
+    {
+        GpuFrame& f = gpuFrames[gpuFrame];
+        if (!gpuReady || f.depth == 0)
+            return;
+        int open = f.open[--f.depth];
+        if (open >= 0)
+            glQueryCounter(f.queries[f.ranges[open].end], GL_TIMESTAMP);
+    }
+
+    // needs the GL context, before it is destroyed
+    void releaseGpu()
+    {
+        if (!gpuReady)
+            return;
+        for (unsigned int f = 0; f < PROFILER_GPU_FRAMES; f++)
+            glDeleteQueries(PROFILER_GPU_QUERIES, gpuFrames[f].queries);
+        gpuReady = false;
+    }
+
+    // prints the rolling statistics of every name, per frame in ms
+    void report()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stats.empty())
+            return;
+        std::cout << "Profile over the last " << std::min(frame, (unsigned long long)PROFILER_HISTORY) << " frames (ms): mean, p50, p95, p99" << std::endl;
+        std::vector<float> sorted;
+        for (unsigned int i = 0; i < stats.size(); i++)
+        {
+            const ProfileStat& s = stats[i];
+            unsigned int n = std::min(s.count, PROFILER_HISTORY);
+            if (n == 0)
+                continue;
+            sorted.assign(s.history.begin(), s.history.begin() + n);
+            std::sort(sorted.begin(), sorted.end());
+            double mean = 0.0;
+            for (unsigned int k = 0; k < n; k++)
+                mean += sorted[k];
+            mean /= n;
+            std::cout << "  " << (s.gpu ? "GPU " : "CPU ") << s.name << ": " << mean << ", " << percentile(sorted, 0.50f)
+                << ", " << percentile(sorted, 0.95f) << ", " << percentile(sorted, 0.99f) << std::endl;
+        }
+        if (gpuDropped > 0)
+            std::cout << "  " << gpuDropped << " GPU frames not ready in time were dropped" << std::endl;
+    }
+
+    // plugged into JobSystem::setHooks, every job becomes a CPU range of the thread running it
+    static void jobBegin(void* user, const char*, unsigned int)
+    {
+        JobStack& stack = jobStack();
+        if (stack.depth < PROFILER_MAX_DEPTH)
+            stack.start[stack.depth] = ((Profiler*)user)->now();
+        stack.depth++;
+    }
+
+    static void jobEnd(void* user, const char* name, unsigned int)
+    {
+        JobStack& stack = jobStack();
+        stack.depth--;
+        if (stack.depth < PROFILER_MAX_DEPTH)
+        {
+            Profiler* profiler = (Profiler*)user;
+            profiler->cpuRange(name, stack.start[stack.depth], profiler->now());
+        }
+    }
+
+private:
+    struct GpuRange {
+        const char* name;
+        unsigned int begin, end; // query indices
+    };
+
+    struct GpuFrame {
+        GLuint queries[PROFILER_GPU_QUERIES];
+        unsigned int used;
+        std::vector<GpuRange> ranges;
+        int open[PROFILER_MAX_DEPTH]; // ranges not ended yet, -1 for a range over the query budget
+        unsigned int depth;
+    };
+
+    struct JobStack {
+        double start[PROFILER_MAX_DEPTH];
+        unsigned int depth;
+    };
+
+    std::atomic<bool> enabled, capturing;
+    double origin;
+    std::mutex mutex; // guards the statistics, the trace and the thread names
+    std::vector<ProfileStat> stats;
+    std::vector<ProfileEvent> trace;
+    std::vector<std::string> threadNames;
+    unsigned long long frame;
+
+    // render thread only
+    GpuFrame gpuFrames[PROFILER_GPU_FRAMES];
+    bool gpuReady;
+    unsigned int gpuFrame;
+    double gpuOffset; // CPU microseconds - GPU microseconds
+    double gpuCalibrated;
+    unsigned long long gpuDropped;
+
+    static JobStack& jobStack()
+    {
+        static thread_local JobStack stack = { {}, 0 };
+        return stack;
+    }
+
+    // threads are numbered in the order they first record something
+    unsigned int threadIndexLocked()
+    {
+        static thread_local int index = -1;
+        if (index < 0)
+        {
+            index = (int)threadNames.size();
+            threadNames.push_back("Thread " + std::to_string(index));
+        }
+        return (unsigned int)index;
+    }
+
+    unsigned int gpuThread() const
+    {
+        return (unsigned int)threadNames.size();
+    }
+
+    void addLocked(const char* name, double start, double duration, unsigned int thread, bool gpu)
+    {
+        ProfileStat* stat = NULL;
+        for (unsigned int i = 0; i < stats.size() && !stat; i++)
+            if (stats[i].gpu == gpu && (stats[i].name == name || std::strcmp(stats[i].name, name) == 0))
+                stat = &stats[i];
+        if (!stat)
+        {
+            ProfileStat s = { name, gpu, 0.0, std::vector<float>(PROFILER_HISTORY, 0.0f), 0 };
+            stats.push_back(s);
+            stat = &stats.back();
+        }
+        stat->frameTotal += duration * 1e-3;
+        if (capturing)
+        {
+            ProfileEvent e = { name, start, duration, thread, gpu };
+            trace.push_back(e);
+        }
+    }
+
+    // reads back a frame of the ring, a frame with a query not ready yet is dropped instead of waited for
+    void collectGpu(GpuFrame& f)
+    {
+        if (f.used > 0)
+        {
+            // the ends of the outer ranges were issued last
+            GLint available = f.depth == 0;
+            for (unsigned int i = 0; i < f.ranges.size() && available; i++)
+                glGetQueryObjectiv(f.queries[f.ranges[i].end], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                gpuDropped++;
+            else
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (unsigned int i = 0; i < f.ranges.size(); i++)
+                {
+                    GLuint64 begin = 0, end = 0;
+                    glGetQueryObjectui64v(f.queries[f.ranges[i].begin], GL_QUERY_RESULT, &begin);
+                    glGetQueryObjectui64v(f.queries[f.ranges[i].end], GL_QUERY_RESULT, &end);
+                    double start = begin * 1e-3 + gpuOffset;
+                    addLocked(f.ranges[i].name, start, end > begin ? (end - begin) * 1e-3 : 0.0, 0, true);
+                }
+            }
+        }
+        f.used = 0;
+        f.depth = 0;
+        f.ranges.clear();
+    }
+
+    static float percentile(const std::vector<float>& sorted, float p)
+    {
+        unsigned int i = (unsigned int)(p * (sorted.size() - 1) + 0.5f);
+        return sorted[std::min(i, (unsigned int)sorted.size() - 1)];
+    }
+};
+
+// times the enclosing block as a CPU range of the calling thread
+class ProfileScope
+{
+public:
+    ProfileScope(const char* _name) : name(_name), start(-1.0)
+    {
+        if (Profiler::instance().isEnabled())
+            start = Profiler::instance().now();
+    }
+
+    ~ProfileScope()
+    {
+        if (start >= 0.0)
+            Profiler::instance().cpuRange(name, start, Profiler::instance().now());
+    }
+
+    // ends the range and starts the next one, for the consecutive parts of a block
+    void next(const char* _name)
+    {
+        double end = -1.0;
+        if (start >= 0.0)
+        {
+            end = Profiler::instance().now();
+            Profiler::instance().cpuRange(name, start, end);
+        }
+        name = _name;
+        start = Profiler::instance().isEnabled() ? (end >= 0.0 ? end : Profiler::instance().now()) : -1.0;
+    }
+
+private:
+    const char* name;
+    double start;
+};
+
+// times the enclosing block on the GPU, from the thread that owns the GL context
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(const char* name)
+    {
+        open = Profiler::instance().gpuBegin(name);
+    }
+
+    ~GpuProfileScope()
+    {
+        if (open)
+            Profiler::instance().gpuEnd();
+    }
+
+private:
+    bool open;
+};
+#endif
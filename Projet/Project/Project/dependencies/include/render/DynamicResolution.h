@@ -0,0 +1,253 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <shader/shader_s.h>
+
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+// GPU time of the scene the scale aims for, in ms; 0 keeps the full resolution
+const double DYNAMIC_RESOLUTION_TARGET = 14.0;
+// range of the scale of each axis, and the step between two scales
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+const float DYNAMIC_RESOLUTION_MAX_SCALE = 1.0f;
+const float DYNAMIC_RESOLUTION_STEP = 0.05f;
+// the scale only goes up when the GPU time is under this part of the target, so it does not come back down at once
+const double DYNAMIC_RESOLUTION_HEADROOM = 0.8;
+// frames in a row over the target before the scale goes down, and under the headroom before it goes up
+const unsigned int DYNAMIC_RESOLUTION_DOWN_FRAMES = 3;
+const unsigned int DYNAMIC_RESOLUTION_UP_FRAMES = 60;
+// timer queries in flight, results are read this many frames later
+const int DYNAMIC_RESOLUTION_QUERY_FRAMES = 4;
+
+// Renders the scene into an offscreen target whose resolution follows the GPU time, then stretches it over the
+// window. The target is allocated at the size of the framebuffer and the scene is drawn in its lower left part at
+// the current scale, so changing the scale only changes the viewport; the target is reallocated when the window is
+// resized. The GPU time of the scene is measured with a pair of GL_TIMESTAMP queries read back a few frames later
+// without waiting. The scale goes down after a few frames over the target and up after many frames well under it,
+// and ignores the results still in flight from before a change.
+class DynamicResolution
+{
+public:
+    DynamicResolution() : fbo(0), colorTexture(0), depthBuffer(0), emptyVAO(0), width(0), height(0),
+        scale(DYNAMIC_RESOLUTION_MAX_SCALE), targetTime(DYNAMIC_RESOLUTION_TARGET), slot(0), overFrames(0), underFrames(0),
+        settle(0), gpuTime(0.0), count(0), total(0.0), changes(0)
+    {
+        for (int i = 0; i < DYNAMIC_RESOLUTION_QUERY_FRAMES; i++)
+        {
+            queries[i][0] = queries[i][1] = 0;
+            pending[i] = false;
+        }
+    }
+
+    // needs a current GL context, the thread that renders
+    void init()
+    {
+        for (int i = 0; i < DYNAMIC_RESOLUTION_QUERY_FRAMES; i++)
+            glGenQueries(2, queries[i]);
+        // the upscale pass makes its triangle from gl_VertexID, but a core context still needs a vertex array bound
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // before the GL context is destroyed
+    void release()
+    {
+        if (queries[0][0])
+            for (int i = 0; i < DYNAMIC_RESOLUTION_QUERY_FRAMES; i++)
+                glDeleteQueries(2, queries[i]);
+        queries[0][0] = 0;
+        if (emptyVAO)
+            glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+        releaseTarget();
+    }
+
+    // GPU time of the scene in ms, 0 renders at the full resolution
+    void setTargetTime(double ms)
+    {
+        targetTime = std::max(0.0, ms);
+        if (targetTime == 0.0)
+            scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+    }
+
+    float getScale() const
+    {
+        return scale;
+    }
+
+    // binds the target for a frame of the framebuffer size and sets the viewport to its scaled part
+    void begin(int framebufferWidth, int framebufferHeight)
+    {
+        collect();
+        if (framebufferWidth != width || framebufferHeight != height)
+            allocate(framebufferWidth, framebufferHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, scaledWidth(), scaledHeight());
+        glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+    }
+
+    // ends the scene and draws it over the default framebuffer with bilinear filtering
+    void present(Shader& upscaleShader)
+    {
+        glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+        pending[slot] = true;
+        slot = (slot + 1) % DYNAMIC_RESOLUTION_QUERY_FRAMES;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        upscaleShader.use();
+        upscaleShader.setInt("scene", 0);
+        // the part of the target the scene covers, the samples stay half a texel inside so nothing outside bleeds in
+        upscaleShader.setVec2("uvScale", (float)scaledWidth() / width, (float)scaledHeight() / height);
+        upscaleShader.setVec2("uvMax", (scaledWidth() - 0.5f) / width, (scaledHeight() - 0.5f) / height);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        // the scene of the next frame must not sample its own target
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // prints the scale and the GPU time since the last report and starts over
+    void report()
+    {
+        if (count == 0)
+            return;
+        std::cout << "Dynamic resolution: scale " << scale << " (" << scaledWidth() << "x" << scaledHeight() << "), scene "
+            << total / count << " ms on the GPU over " << count << " frames, " << changes << " scale changes" << std::endl;
+        count = 0;
+        total = 0.0;
+        changes = 0;
+    }
+
+private:
+    GLuint fbo, colorTexture, depthBuffer, emptyVAO;
+    int width, height; // of the target, the framebuffer size
+    float scale;
+    double targetTime;
+
+    GLuint queries[DYNAMIC_RESOLUTION_QUERY_FRAMES][2];
+    bool pending[DYNAMIC_RESOLUTION_QUERY_FRAMES];
+    int slot;
+
+    unsigned int overFrames, underFrames;
+    int settle; // results to ignore, measured at the previous scale
+    double gpuTime;
+
+    unsigned int count;
+    double total;
+    unsigned int changes;
+
+    int scaledWidth() const
+    {
+        return std::max(1, (int)(width * scale + 0.5f));
+    }
+
+    int scaledHeight() const
+    {
+        return std::max(1, (int)(height * scale + 0.5f));
+    }
+
+    void allocate(int _width, int _height)
+    {
+        releaseTarget();
+        width = _width;
+        height = _height;
+        glGenTextures(1, &colorTexture);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::DYNAMIC_RESOLUTION:: Framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void releaseTarget()
+    {
+        if (fbo)
+        {
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteTextures(1, &colorTexture);
+            glDeleteRenderbuffers(1, &depthBuffer);
+        }
+        fbo = colorTexture = depthBuffer = 0;
+        width = height = 0;
+    }
+
+    // reads the queries of the slot about to be reused, if the GPU is done with them
+    void collect()
+    {
+        if (!pending[slot])
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return; // dropped, the slot is reused
+        pending[slot] = false;
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+        gpuTime = end > begin ? (end - begin) * 1e-6 : 0.0;
+        count++;
+        total += gpuTime;
+        adapt();
+    }
+
+    void adapt()
+    {
+        if (targetTime <= 0.0)
+            return;
+        if (settle > 0)
+        {
+            settle--;
+            return;
+        }
+        if (gpuTime > targetTime)
+        {
+            overFrames++;
+            underFrames = 0;
+        }
+        else if (gpuTime < targetTime * DYNAMIC_RESOLUTION_HEADROOM)
+        {
+            underFrames++;
+            overFrames = 0;
+        }
+        else
+            overFrames = underFrames = 0;
+
+        float next = scale;
+        if (overFrames >= DYNAMIC_RESOLUTION_DOWN_FRAMES)
+            // the cost follows the pixel count, the square of the scale: jump to the scale that fits when far over
+            next = std::min(scale - DYNAMIC_RESOLUTION_STEP, scale * (float)std::sqrt(targetTime / gpuTime));
+        else if (underFrames >= DYNAMIC_RESOLUTION_UP_FRAMES)
+            next = scale + DYNAMIC_RESOLUTION_STEP;
+        // multiples of the step, from the bottom so a drop is at least one step
+        next = std::floor(next / DYNAMIC_RESOLUTION_STEP + 1e-3f) * DYNAMIC_RESOLUTION_STEP;
+        next = std::max(DYNAMIC_RESOLUTION_MIN_SCALE, std::min(DYNAMIC_RESOLUTION_MAX_SCALE, next));
+        if (next == scale)
+            return;
+        scale = next;
+        overFrames = underFrames = 0;
+        settle = DYNAMIC_RESOLUTION_QUERY_FRAMES;
+        changes++;
+    }
+};
+#endif
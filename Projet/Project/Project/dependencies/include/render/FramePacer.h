@@ -0,0 +1,185 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+enum Pacing_Mode {
+    PACING_VSYNC,          // the swap waits for the vertical blank, no tearing
+    PACING_ADAPTIVE_VSYNC, // waits for the vertical blank unless the frame is late, then tears instead of halving the rate
+    PACING_UNCAPPED        // the swap never waits
+};
+
+// the sleep of the limiter stops this long before the deadline at first, then adapts to the oversleep it measures
+const double PACING_SPIN_MARGIN = 0.002;
+// longest spin, for the systems whose timers are coarse (15.6 ms on Windows by default)
+const double PACING_MAX_SPIN_MARGIN = 0.004;
+
+// Frame pacing: the swap interval of the mode and a frame limiter.
+// The limiter holds the start of each frame to a fixed rate on the monotonic clock. It sleeps until just before the
+// deadline, since a sleep can wake up late, and spins the rest of the way; the margin kept for the spin follows the
+// worst oversleep seen, so the CPU mostly sleeps. When a frame is more than a period late the schedule restarts from
+// now rather than running the missed frames back to back. The intervals between the frames are kept for the jitter
+// report.
+class FramePacer
+{
+public:
+    FramePacer() : mode(PACING_VSYNC), targetFPS(0.0), adaptiveSupported(false), spinMargin(PACING_SPIN_MARGIN),
+        started(false), count(0), total(0.0), totalSquared(0.0), worst(0.0), late(0), spun(0.0)
+    {
+    }
+
+    // needs a current GL context, to check the swap control extensions
+    void init()
+    {
+        adaptiveSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") == GLFW_TRUE
+            || glfwExtensionSupported("GLX_EXT_swap_control_tear") == GLFW_TRUE;
+    }
+
+    void setMode(Pacing_Mode _mode)
+    {
+        mode = _mode;
+    }
+
+    Pacing_Mode getMode() const
+    {
+        return mode;
+    }
+
+    // vsync, adaptive vsync, uncapped, vsync...
+    void nextMode()
+    {
+        mode = (Pacing_Mode)((mode + 1) % 3);
+        std::cout << "Frame pacing: " << modeName() << std::endl;
+    }
+
+    const char* modeName() const
+    {
+        if (mode == PACING_ADAPTIVE_VSYNC)
+            return adaptiveSupported ? "adaptive vsync" : "adaptive vsync (not supported, vsync)";
+        return mode == PACING_VSYNC ? "vsync" : "uncapped";
+    }
+
+    // argument of glfwSwapInterval, from the thread that owns the context
+    int swapInterval() const
+    {
+        if (mode == PACING_ADAPTIVE_VSYNC)
+            return adaptiveSupported ? -1 : 1;
+        return mode == PACING_VSYNC ? 1 : 0;
+    }
+
+    // frames per second of the limiter, 0 turns it off
+    void setTargetFPS(double fps)
+    {
+        targetFPS = std::max(0.0, fps);
+        started = false;
+    }
+
+    double getTargetFPS() const
+    {
+        return targetFPS;
+    }
+
+    // at the start of a frame, waits for its turn when the limiter is on
+    void wait()
+    {
+        Clock::time_point now = Clock::now();
+        if (targetFPS > 0.0 && started)
+        {
+            Clock::duration period = seconds(1.0 / targetFPS);
+            deadline += period;
+            if (now > deadline + period)
+            {
+                // too late to catch up
+                late++;
+                deadline = now;
+            }
+            else
+            {
+                Clock::time_point wake = deadline - seconds(spinMargin);
+                if (now < wake)
+                {
+                    std::this_thread::sleep_until(wake);
+                    Clock::time_point woke = Clock::now();
+                    double oversleep = toSeconds(woke - wake);
+                    // the margin grows at once with a late wake up and shrinks slowly
+                    spinMargin = std::min(PACING_MAX_SPIN_MARGIN, std::max(oversleep * 1.25, spinMargin * 0.99 + oversleep * 0.01));
+                    spinMargin = std::max(spinMargin, 0.0002);
+                }
+                Clock::time_point spinStart = Clock::now();
+                while (Clock::now() < deadline)
+                    std::this_thread::yield();
+                spun += toSeconds(Clock::now() - spinStart);
+                now = Clock::now();
+            }
+        }
+        else
+            deadline = now;
+        if (started)
+        {
+            double interval = toSeconds(now - previous);
+            count++;
+            total += interval;
+            totalSquared += interval * interval;
+            worst = std::max(worst, interval);
+        }
+        previous = now;
+        started = true;
+    }
+
+    // prints the pacing since the last report and starts over: the jitter is the standard deviation of the intervals
+    void report()
+    {
+        if (count == 0)
+            return;
+        double mean = total / count;
+        double jitter = std::sqrt(std::max(0.0, totalSquared / count - mean * mean));
+        std::cout << "Frame pacing (" << modeName();
+        if (targetFPS > 0.0)
+            std::cout << ", limited to " << targetFPS << " fps";
+        std::cout << ") over " << count << " frames: average " << 1000.0 * mean << " ms, jitter " << 1000.0 * jitter
+            << " ms, max " << 1000.0 * worst << " ms";
+        if (targetFPS > 0.0)
+            std::cout << ", " << late << " late, spin " << 1000.0 * spun / count << " ms per frame";
+        std::cout << std::endl;
+        count = 0;
+        total = 0.0;
+        totalSquared = 0.0;
+        worst = 0.0;
+        late = 0;
+        spun = 0.0;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Pacing_Mode mode;
+    double targetFPS;
+    bool adaptiveSupported;
+    double spinMargin; // seconds
+
+    bool started;
+    Clock::time_point deadline; // start of the current frame on the schedule
+    Clock::time_point previous; // actual start of the last frame
+
+    unsigned int count;
+    double total, totalSquared, worst;
+    unsigned int late;
+    double spun;
+
+    static Clock::duration seconds(double s)
+    {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s));
+    }
+
+    static double toSeconds(Clock::duration d)
+    {
+        return std::chrono::duration<double>(d).count();
+    }
+};
+#endif
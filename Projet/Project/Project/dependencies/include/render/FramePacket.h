@@ -0,0 +1,71 @@
+#ifndef FRAME_PACKET_H
+#define FRAME_PACKET_H
+
+#include <glm/glm.hpp>
+
+#include <mesh/mesh.h>
+#include <light/LightSystem.h>
+#include <memory/FrameArena.h>
+
+#include <vector>
+
+enum Packet_Draw_Kind {
+    PACKET_SURFACE, // a quad of the room, drawn first since it hides the models
+    PACKET_MODEL    // a model drawn through its occlusion query
+};
+
+// one draw of the draw list
+struct PacketDraw {
+    Packet_Draw_Kind kind;
+    unsigned int index;     // surface index for the lightmap, or model index in the table of the renderer
+    unsigned int texture;   // surfaces only
+    glm::mat4 model;
+    Bounds bounds;          // models only, world bounds for the occlusion proxy
+    unsigned int occlusion; // models only, object id in OcclusionQueries
+    unsigned int meshFirst; // models only, culling result of each mesh in FramePacket::meshVisible
+    bool visible;           // false when only the occlusion query of the model runs
+};
+
+// Everything the render thread needs to draw a frame, written by the simulation thread and then read only.
+// Packets are reused from frame to frame: the draw list lives in the arena of the packet, which clear() resets, and
+// the lights are only copied when their version changed. The packets of the pipeline are the frame buffers of
+// the arenas, a packet is only cleared once the render thread is done with it.
+struct FramePacket {
+    // camera
+    glm::mat4 view, projection;
+    glm::vec3 viewPos;
+    int framebufferWidth, framebufferHeight;
+    // argument of glfwSwapInterval
+    int swapInterval;
+
+    LightSystem lights;
+
+    FrameArena arena;
+    FrameVector<PacketDraw> draws;
+    FrameVector<unsigned char> meshVisible;
+
+    // reception time of the oldest input the frame used, -1 if none
+    double inputTime;
+    // the render thread saves the framebuffer of this frame, before the swap
+    bool screenshot;
+    // the render thread captures the GL calls of this frame into a trace for GLReplay
+    bool capture;
+
+    FramePacket() : framebufferWidth(0), framebufferHeight(0), swapInterval(1),
+        draws(FrameAllocator<PacketDraw>(&arena)), meshVisible(FrameAllocator<unsigned char>(&arena)), inputTime(-1.0),
+        screenshot(false), capture(false)
+    {
+    }
+
+    void clear()
+    {
+        // the lists drop their arena memory before it is reused
+        FrameVector<PacketDraw>(FrameAllocator<PacketDraw>(&arena)).swap(draws);
+        FrameVector<unsigned char>(FrameAllocator<unsigned char>(&arena)).swap(meshVisible);
+        arena.reset();
+        inputTime = -1.0;
+        screenshot = false;
+        capture = false;
+    }
+};
+#endif
@@ -0,0 +1,104 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+// 2 is double buffering: the simulation builds frame N + 1 while frame N is submitted.
+// 3 lets the simulation run one more frame ahead, at the cost of one more frame of latency.
+const unsigned int FRAME_PIPELINE_DEPTH = 2;
+
+// Ring of packets between one producer thread and one consumer thread.
+// The producer fills the packets in order and the consumer reads them in the same order; each side blocks only when
+// the ring is full (the consumer is late) or empty (the producer is late). A packet belongs to a single side at a
+// time, so its content needs no lock.
+template <typename T>
+class FramePipeline
+{
+public:
+    // counters, for the reports
+    unsigned long long producerWaits;
+    unsigned long long consumerWaits;
+
+    FramePipeline(unsigned int depth = FRAME_PIPELINE_DEPTH)
+        : producerWaits(0), consumerWaits(0), packets(depth), states(depth, SLOT_FREE), writeIndex(0), readIndex(0), closed(false)
+    {
+    }
+
+    // next packet to fill, NULL once closed
+    T* beginWrite()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (states[writeIndex] != SLOT_FREE && !closed)
+        {
+            producerWaits++;
+            changed.wait(lock, [this]() { return states[writeIndex] == SLOT_FREE || closed; });
+        }
+        if (closed)
+            return NULL;
+        states[writeIndex] = SLOT_WRITING;
+        return &packets[writeIndex];
+    }
+
+    void endWrite()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            states[writeIndex] = SLOT_READY;
+            writeIndex = (writeIndex + 1) % packets.size();
+        }
+        changed.notify_all();
+    }
+
+    // next packet to consume, NULL once closed and every packet written before was consumed
+    T* beginRead()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (states[readIndex] != SLOT_READY && !closed)
+        {
+            consumerWaits++;
+            changed.wait(lock, [this]() { return states[readIndex] == SLOT_READY || closed; });
+        }
+        if (states[readIndex] != SLOT_READY)
+            return NULL;
+        states[readIndex] = SLOT_READING;
+        return &packets[readIndex];
+    }
+
+    void endRead()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            states[readIndex] = SLOT_FREE;
+            readIndex = (readIndex + 1) % packets.size();
+        }
+        changed.notify_all();
+    }
+
+    // wakes both sides, the consumer still gets the packets already written
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+private:
+    enum Slot_State {
+        SLOT_FREE,
+        SLOT_WRITING,
+        SLOT_READY,
+        SLOT_READING
+    };
+
+    std::vector<T> packets;
+    std::vector<Slot_State> states;
+    unsigned int writeIndex, readIndex;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+#endif
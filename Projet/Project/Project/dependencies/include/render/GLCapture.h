@@ -0,0 +1,1030 @@
+#ifndef GL_CAPTURE_H
+#define GL_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <set>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+// "GLTR", then the version, the size of the default framebuffer and the records up to TRACE_END
+const uint32_t GL_TRACE_MAGIC = 0x52544C47;
+const uint32_t GL_TRACE_VERSION = 1;
+// vertex attributes saved with a vertex array
+const GLuint GL_TRACE_MAX_ATTRIBS = 16;
+
+// Records of a trace: a 16 bit op and its arguments, little endian. Object names are the ones of the captured
+// context, the replayer maps them to its own.
+enum Trace_Op {
+    TRACE_END = 0,
+    // definitions: the state of an object when the frame first used it, created by the replayer before the calls
+    TRACE_DEF_STATE = 1,
+    TRACE_DEF_PROGRAM,
+    TRACE_DEF_BUFFER,
+    TRACE_DEF_TEXTURE,
+    TRACE_DEF_VERTEX_ARRAY,
+    TRACE_DEF_FRAMEBUFFER,
+    TRACE_DEF_QUERY,
+    // calls, in the order of the frame
+    TRACE_USE_PROGRAM = 32,
+    TRACE_GET_UNIFORM_LOCATION,
+    TRACE_UNIFORM,
+    TRACE_ACTIVE_TEXTURE,
+    TRACE_BIND_TEXTURE,
+    TRACE_BIND_VERTEX_ARRAY,
+    TRACE_BIND_BUFFER,
+    TRACE_BIND_BUFFER_RANGE,
+    TRACE_BUFFER_DATA,
+    TRACE_BUFFER_SUB_DATA,
+    TRACE_BIND_FRAMEBUFFER,
+    TRACE_VIEWPORT,
+    TRACE_CLEAR_COLOR,
+    TRACE_CLEAR,
+    TRACE_ENABLE,
+    TRACE_DISABLE,
+    TRACE_DEPTH_FUNC,
+    TRACE_DEPTH_MASK,
+    TRACE_COLOR_MASK,
+    TRACE_DRAW_ARRAYS,
+    TRACE_DRAW_ELEMENTS,
+    TRACE_BEGIN_QUERY,
+    TRACE_END_QUERY,
+    TRACE_QUERY_COUNTER,
+    TRACE_BEGIN_CONDITIONAL_RENDER,
+    TRACE_END_CONDITIONAL_RENDER,
+    TRACE_OP_COUNT
+};
+
+// glUniform* function of a TRACE_UNIFORM record
+enum Trace_Uniform {
+    TRACE_UNIFORM_1I,
+    TRACE_UNIFORM_1F,
+    TRACE_UNIFORM_2F,
+    TRACE_UNIFORM_3F,
+    TRACE_UNIFORM_4F,
+    TRACE_UNIFORM_1IV,
+    TRACE_UNIFORM_1FV,
+    TRACE_UNIFORM_2FV,
+    TRACE_UNIFORM_3FV,
+    TRACE_UNIFORM_4FV,
+    TRACE_UNIFORM_MATRIX_2FV,
+    TRACE_UNIFORM_MATRIX_3FV,
+    TRACE_UNIFORM_MATRIX_4FV
+};
+
+// capabilities saved in TRACE_DEF_STATE, in this order
+const GLenum GL_TRACE_CAPABILITIES[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_STENCIL_TEST, GL_SCISSOR_TEST };
+const unsigned int GL_TRACE_CAPABILITY_COUNT = sizeof(GL_TRACE_CAPABILITIES) / sizeof(GLenum);
+
+inline const char* traceOpName(unsigned int op)
+{
+    static const char* calls[] = { "glUseProgram", "glGetUniformLocation", "glUniform*", "glActiveTexture",
+        "glBindTexture", "glBindVertexArray", "glBindBuffer", "glBindBufferRange", "glBufferData", "glBufferSubData",
+        "glBindFramebuffer", "glViewport", "glClearColor", "glClear", "glEnable", "glDisable", "glDepthFunc",
+        "glDepthMask", "glColorMask", "glDrawArrays", "glDrawElements", "glBeginQuery", "glEndQuery", "glQueryCounter",
+        "glBeginConditionalRender", "glEndConditionalRender" };
+    if (op >= TRACE_USE_PROGRAM && op < TRACE_OP_COUNT)
+        return calls[op - TRACE_USE_PROGRAM];
+    return "definition";
+}
+
+// floats or ints of a uniform of this type, 0 for the types a trace does not save
+inline unsigned int traceUniformComponents(GLenum type, bool& isInteger)
+{
+    isInteger = false;
+    switch (type)
+    {
+    case GL_FLOAT: return 1;
+    case GL_FLOAT_VEC2: return 2;
+    case GL_FLOAT_VEC3: return 3;
+    case GL_FLOAT_VEC4: return 4;
+    case GL_FLOAT_MAT2: return 4;
+    case GL_FLOAT_MAT3: return 9;
+    case GL_FLOAT_MAT4: return 16;
+    default: break;
+    }
+    isInteger = true;
+    switch (type)
+    {
+    case GL_INT: case GL_BOOL: case GL_SAMPLER_2D: case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_3D:
+        return 1;
+    case GL_INT_VEC2: case GL_BOOL_VEC2: return 2;
+    case GL_INT_VEC3: case GL_BOOL_VEC3: return 3;
+    case GL_INT_VEC4: case GL_BOOL_VEC4: return 4;
+    default: return 0;
+    }
+}
+
+// Captures the GL calls of a frame into a binary trace for the GLReplay tool.
+// Like GLCounters it replaces the glad function pointers with wrappers, which write the call and then make it.
+// Each object is saved the first time the frame uses it, before the call: shader sources and uniform values of the
+// programs, contents of the buffers and textures, attributes of the vertex arrays, attachments of the framebuffers.
+// The uniform blocks written through mapped memory are saved at each glBindBufferRange, since no call carries them.
+// begin() and end() around the frame, on the thread that owns the context; the capture is slow and allocates.
+// Calls made before begin() are not in the trace: textures still streaming in, or the state of objects the frame
+// does not bind again.
+class GLCapture
+{
+public:
+    GLCapture() : calls(0), capturing(false)
+    {
+    }
+
+    bool isCapturing() const
+    {
+        return capturing;
+    }
+
+    bool begin(const char* path, int width, int height)
+    {
+        if (capturing)
+            return false;
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "ERROR::GL_CAPTURE:: Cannot write " << path << std::endl;
+            return false;
+        }
+        tracePath = path;
+        calls = 0;
+        programs.clear();
+        buffers.clear();
+        textures.clear();
+        vertexArrays.clear();
+        framebuffers.clear();
+        queries.clear();
+        u32(GL_TRACE_MAGIC);
+        u32(GL_TRACE_VERSION);
+        i32(width);
+        i32(height);
+        // the snapshots call the real functions, saved by install()
+        install();
+        defineState();
+        capturing = true;
+        return true;
+    }
+
+    void end()
+    {
+        if (!capturing)
+            return;
+        uninstall();
+        op(TRACE_END);
+        std::streamoff size = out.tellp();
+        out.close();
+        capturing = false;
+        std::cout << "Captured " << calls << " GL calls, " << programs.size() << " programs, " << buffers.size()
+            << " buffers, " << textures.size() << " textures to " << tracePath << " (" << size / 1024 << " KB)" << std::endl;
+    }
+
+private:
+    struct Originals {
+        PFNGLUSEPROGRAMPROC useProgram;
+        PFNGLGETUNIFORMLOCATIONPROC getUniformLocation;
+        PFNGLUNIFORM1IPROC uniform1i;
+        PFNGLUNIFORM1FPROC uniform1f;
+        PFNGLUNIFORM2FPROC uniform2f;
+        PFNGLUNIFORM3FPROC uniform3f;
+        PFNGLUNIFORM4FPROC uniform4f;
+        PFNGLUNIFORM1IVPROC uniform1iv;
+        PFNGLUNIFORM1FVPROC uniform1fv;
+        PFNGLUNIFORM2FVPROC uniform2fv;
+        PFNGLUNIFORM3FVPROC uniform3fv;
+        PFNGLUNIFORM4FVPROC uniform4fv;
+        PFNGLUNIFORMMATRIX2FVPROC uniformMatrix2fv;
+        PFNGLUNIFORMMATRIX3FVPROC uniformMatrix3fv;
+        PFNGLUNIFORMMATRIX4FVPROC uniformMatrix4fv;
+        PFNGLACTIVETEXTUREPROC activeTexture;
+        PFNGLBINDTEXTUREPROC bindTexture;
+        PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+        PFNGLBINDBUFFERPROC bindBuffer;
+        PFNGLBINDBUFFERRANGEPROC bindBufferRange;
+        PFNGLBUFFERDATAPROC bufferData;
+        PFNGLBUFFERSUBDATAPROC bufferSubData;
+        PFNGLBINDFRAMEBUFFERPROC bindFramebuffer;
+        PFNGLVIEWPORTPROC viewport;
+        PFNGLCLEARCOLORPROC clearColor;
+        PFNGLCLEARPROC clear;
+        PFNGLENABLEPROC enable;
+        PFNGLDISABLEPROC disable;
+        PFNGLDEPTHFUNCPROC depthFunc;
+        PFNGLDEPTHMASKPROC depthMask;
+        PFNGLCOLORMASKPROC colorMask;
+        PFNGLDRAWARRAYSPROC drawArrays;
+        PFNGLDRAWELEMENTSPROC drawElements;
+        PFNGLBEGINQUERYPROC beginQuery;
+        PFNGLENDQUERYPROC endQuery;
+        PFNGLQUERYCOUNTERPROC queryCounter;
+        PFNGLBEGINCONDITIONALRENDERPROC beginConditionalRender;
+        PFNGLENDCONDITIONALRENDERPROC endConditionalRender;
+    };
+
+    std::ofstream out;
+    std::string tracePath;
+    unsigned long long calls;
+    bool capturing;
+    std::set<GLuint> programs, buffers, textures, vertexArrays, framebuffers, queries;
+
+    static Originals& originals()
+    {
+        static Originals o;
+        return o;
+    }
+
+    static GLCapture*& active()
+    {
+        static GLCapture* capture = NULL;
+        return capture;
+    }
+
+    template <typename F>
+    static void hook(F& slot, F& original, F wrapper)
+    {
+        original = slot;
+        slot = wrapper;
+    }
+
+    void install()
+    {
+        Originals& o = originals();
+        hook(glad_glUseProgram, o.useProgram, useProgram);
+        hook(glad_glGetUniformLocation, o.getUniformLocation, getUniformLocation);
+        hook(glad_glUniform1i, o.uniform1i, uniform1i);
+        hook(glad_glUniform1f, o.uniform1f, uniform1f);
+        hook(glad_glUniform2f, o.uniform2f, uniform2f);
+        hook(glad_glUniform3f, o.uniform3f, uniform3f);
+        hook(glad_glUniform4f, o.uniform4f, uniform4f);
+        hook(glad_glUniform1iv, o.uniform1iv, uniform1iv);
+        hook(glad_glUniform1fv, o.uniform1fv, uniform1fv);
+        hook(glad_glUniform2fv, o.uniform2fv, uniform2fv);
+        hook(glad_glUniform3fv, o.uniform3fv, uniform3fv);
+        hook(glad_glUniform4fv, o.uniform4fv, uniform4fv);
+        hook(glad_glUniformMatrix2fv, o.uniformMatrix2fv, uniformMatrix2fv);
+        hook(glad_glUniformMatrix3fv, o.uniformMatrix3fv, uniformMatrix3fv);
+        hook(glad_glUniformMatrix4fv, o.uniformMatrix4fv, uniformMatrix4fv);
+        hook(glad_glActiveTexture, o.activeTexture, activeTexture);
+        hook(glad_glBindTexture, o.bindTexture, bindTexture);
+        hook(glad_glBindVertexArray, o.bindVertexArray, bindVertexArray);
+        hook(glad_glBindBuffer, o.bindBuffer, bindBuffer);
+        hook(glad_glBindBufferRange, o.bindBufferRange, bindBufferRange);
+        hook(glad_glBufferData, o.bufferData, bufferData);
+        hook(glad_glBufferSubData, o.bufferSubData, bufferSubData);
+        hook(glad_glBindFramebuffer, o.bindFramebuffer, bindFramebuffer);
+        hook(glad_glViewport, o.viewport, viewport);
+        hook(glad_glClearColor, o.clearColor, clearColor);
+        hook(glad_glClear, o.clear, clear);
+        hook(glad_glEnable, o.enable, enable);
+        hook(glad_glDisable, o.disable, disable);
+        hook(glad_glDepthFunc, o.depthFunc, depthFunc);
+        hook(glad_glDepthMask, o.depthMask, depthMask);
+        hook(glad_glColorMask, o.colorMask, colorMask);
+        hook(glad_glDrawArrays, o.drawArrays, drawArrays);
+        hook(glad_glDrawElements, o.drawElements, drawElements);
+        hook(glad_glBeginQuery, o.beginQuery, beginQuery);
+        hook(glad_glEndQuery, o.endQuery, endQuery);
+        hook(glad_glQueryCounter, o.queryCounter, queryCounter);
+        hook(glad_glBeginConditionalRender, o.beginConditionalRender, beginConditionalRender);
+        hook(glad_glEndConditionalRender, o.endConditionalRender, endConditionalRender);
+        active() = this;
+    }
+
+    void uninstall()
+    {
+        Originals& o = originals();
+        glad_glUseProgram = o.useProgram;
+        glad_glGetUniformLocation = o.getUniformLocation;
+        glad_glUniform1i = o.uniform1i;
+        glad_glUniform1f = o.uniform1f;
+        glad_glUniform2f = o.uniform2f;
+        glad_glUniform3f = o.uniform3f;
+        glad_glUniform4f = o.uniform4f;
+        glad_glUniform1iv = o.uniform1iv;
+        glad_glUniform1fv = o.uniform1fv;
+        glad_glUniform2fv = o.uniform2fv;
+        glad_glUniform3fv = o.uniform3fv;
+        glad_glUniform4fv = o.uniform4fv;
+        glad_glUniformMatrix2fv = o.uniformMatrix2fv;
+        glad_glUniformMatrix3fv = o.uniformMatrix3fv;
+        glad_glUniformMatrix4fv = o.uniformMatrix4fv;
+        glad_glActiveTexture = o.activeTexture;
+        glad_glBindTexture = o.bindTexture;
+        glad_glBindVertexArray = o.bindVertexArray;
+        glad_glBindBuffer = o.bindBuffer;
+        glad_glBindBufferRange = o.bindBufferRange;
+        glad_glBufferData = o.bufferData;
+        glad_glBufferSubData = o.bufferSubData;
+        glad_glBindFramebuffer = o.bindFramebuffer;
+        glad_glViewport = o.viewport;
+        glad_glClearColor = o.clearColor;
+        glad_glClear = o.clear;
+        glad_glEnable = o.enable;
+        glad_glDisable = o.disable;
+        glad_glDepthFunc = o.depthFunc;
+        glad_glDepthMask = o.depthMask;
+        glad_glColorMask = o.colorMask;
+        glad_glDrawArrays = o.drawArrays;
+        glad_glDrawElements = o.drawElements;
+        glad_glBeginQuery = o.beginQuery;
+        glad_glEndQuery = o.endQuery;
+        glad_glQueryCounter = o.queryCounter;
+        glad_glBeginConditionalRender = o.beginConditionalRender;
+        glad_glEndConditionalRender = o.endConditionalRender;
+        active() = NULL;
+    }
+
+    // writing
+    void u8(uint8_t v) { out.write((const char*)&v, sizeof(v)); }
+    void u32(uint32_t v) { out.write((const char*)&v, sizeof(v)); }
+    void i32(int32_t v) { out.write((const char*)&v, sizeof(v)); }
+    void u64(uint64_t v) { out.write((const char*)&v, sizeof(v)); }
+    void f32(float v) { out.write((const char*)&v, sizeof(v)); }
+
+    void bytes(const void* data, size_t size)
+    {
+        u32((uint32_t)size);
+        if (size > 0)
+            out.write((const char*)data, size);
+    }
+
+    void text(const std::string& s)
+    {
+        bytes(s.data(), s.size());
+    }
+
+    void op(Trace_Op code)
+    {
+        uint16_t v = (uint16_t)code;
+        out.write((const char*)&v, sizeof(v));
+        if (code >= TRACE_USE_PROGRAM)
+            calls++;
+    }
+
+    // state the frame starts from, the replayer restores it before each loop
+    void defineState()
+    {
+        GLint depthFunction = GL_LESS, program = 0, vertexArray = 0, framebuffer = 0, activeUnit = GL_TEXTURE0;
+        GLint view[4] = { 0, 0, 0, 0 };
+        GLboolean depthWrite = GL_TRUE, colorWrite[4] = { GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE };
+        GLfloat clearValue[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glGetIntegerv(GL_DEPTH_FUNC, &depthFunction);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWrite);
+        glGetBooleanv(GL_COLOR_WRITEMASK, colorWrite);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearValue);
+        glGetIntegerv(GL_VIEWPORT, view);
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &activeUnit);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+        // the objects bound at the start are defined first
+        defineProgram(program);
+        defineVertexArray(vertexArray);
+        defineFramebuffer(framebuffer);
+        op(TRACE_DEF_STATE);
+        for (unsigned int i = 0; i < GL_TRACE_CAPABILITY_COUNT; i++)
+            u8(glIsEnabled(GL_TRACE_CAPABILITIES[i]) ? 1 : 0);
+        u32(depthFunction);
+        u8(depthWrite);
+        for (int i = 0; i < 4; i++)
+            u8(colorWrite[i]);
+        for (int i = 0; i < 4; i++)
+            f32(clearValue[i]);
+        for (int i = 0; i < 4; i++)
+            i32(view[i]);
+        u32(activeUnit);
+        u32(program);
+        u32(vertexArray);
+        u32(framebuffer);
+    }
+
+    void defineProgram(GLuint name)
+    {
+        if (name == 0 || programs.count(name))
+            return;
+        programs.insert(name);
+        GLint shaderCount = 0;
+        glGetProgramiv(name, GL_ATTACHED_SHADERS, &shaderCount);
+        std::vector<GLuint> shaders(shaderCount > 0 ? shaderCount : 1);
+        if (shaderCount > 0)
+            glGetAttachedShaders(name, shaderCount, NULL, &shaders[0]);
+
+        struct Uniform {
+            std::string name;
+            uint32_t type;
+            std::vector<int32_t> values; // floats or ints, bit for bit
+        };
+        std::vector<Uniform> uniforms;
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(name, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(name, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> buffer(maxLength + 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size = 0, block = -1;
+            GLenum type = 0;
+            GLuint index = (GLuint)i;
+            glGetActiveUniform(name, index, maxLength + 1, NULL, &size, &type, &buffer[0]);
+            // the values of the uniform blocks are in their buffers
+            glGetActiveUniformsiv(name, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+            bool isInteger = false;
+            unsigned int components = traceUniformComponents(type, isInteger);
+            if (block != -1 || components == 0)
+                continue;
+            std::string base = &buffer[0];
+            if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+                base.resize(base.size() - 3);
+            for (GLint e = 0; e < size; e++)
+            {
+                Uniform uniform;
+                uniform.name = size > 1 ? base + "[" + std::to_string(e) + "]" : base;
+                uniform.type = type;
+                GLint location = originals().getUniformLocation(name, uniform.name.c_str());
+                if (location < 0)
+                    continue;
+                uniform.values.resize(components);
+                if (isInteger)
+                    glGetUniformiv(name, location, (GLint*)&uniform.values[0]);
+                else
+                    glGetUniformfv(name, location, (GLfloat*)&uniform.values[0]);
+                uniforms.push_back(uniform);
+            }
+        }
+
+        op(TRACE_DEF_PROGRAM);
+        u32(name);
+        u32(shaderCount);
+        for (GLint i = 0; i < shaderCount; i++)
+        {
+            GLint type = 0, length = 0;
+            glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+            glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length);
+            std::vector<char> source(length + 1, 0);
+            if (length > 0)
+                glGetShaderSource(shaders[i], length + 1, NULL, &source[0]);
+            u32(type);
+            text(&source[0]);
+        }
+        u32((uint32_t)uniforms.size());
+        for (unsigned int i = 0; i < uniforms.size(); i++)
+        {
+            text(uniforms[i].name);
+            u32(uniforms[i].type);
+            bytes(&uniforms[i].values[0], uniforms[i].values.size() * sizeof(int32_t));
+        }
+    }
+
+    // the contents are read through GL_COPY_READ_BUFFER, which leaves the bindings of the frame alone
+    void defineBuffer(GLuint name)
+    {
+        if (name == 0 || buffers.count(name))
+            return;
+        buffers.insert(name);
+        GLint previous = 0, size = 0, mapped = GL_FALSE, access = 0;
+        glGetIntegerv(GL_COPY_READ_BUFFER_BINDING, &previous);
+        originals().bindBuffer(GL_COPY_READ_BUFFER, name);
+        glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+        glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_MAPPED, &mapped);
+        if (mapped)
+            glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_ACCESS_FLAGS, &access);
+        std::vector<unsigned char> data;
+        // a buffer mapped without GL_MAP_PERSISTENT_BIT cannot be read
+        if (size > 0 && (!mapped || (access & GL_MAP_PERSISTENT_BIT)))
+        {
+            data.resize(size);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, &data[0]);
+        }
+        originals().bindBuffer(GL_COPY_READ_BUFFER, previous);
+        op(TRACE_DEF_BUFFER);
+        u32(name);
+        u32(size);
+        bytes(data.empty() ? NULL : &data[0], data.size());
+    }
+
+    // level 0 of 2D, 2D array and cube map textures, read as RGBA bytes or floats
+    void defineTexture(GLenum target, GLuint name)
+    {
+        if (name == 0 || textures.count(name))
+            return;
+        textures.insert(name);
+        GLenum binding = target == GL_TEXTURE_2D ? GL_TEXTURE_BINDING_2D : target == GL_TEXTURE_2D_ARRAY
+            ? GL_TEXTURE_BINDING_2D_ARRAY : target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_BINDING_CUBE_MAP : 0;
+        GLint previous = 0, width = 0, height = 0, depth = 1, internalFormat = GL_RGBA8, redType = GL_NONE;
+        GLint minFilter = GL_LINEAR, magFilter = GL_LINEAR, wrapS = GL_REPEAT, wrapT = GL_REPEAT, wrapR = GL_REPEAT;
+        GLenum levelTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+        if (binding)
+        {
+            glGetIntegerv(binding, &previous);
+            originals().bindTexture(target, name);
+            glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_HEIGHT, &height);
+            glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_DEPTH, &depth);
+            glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+            glGetTexLevelParameteriv(levelTarget, 0, GL_TEXTURE_RED_TYPE, &redType);
+            glGetTexParameteriv(target, GL_TEXTURE_MIN_FILTER, &minFilter);
+            glGetTexParameteriv(target, GL_TEXTURE_MAG_FILTER, &magFilter);
+            glGetTexParameteriv(target, GL_TEXTURE_WRAP_S, &wrapS);
+            glGetTexParameteriv(target, GL_TEXTURE_WRAP_T, &wrapT);
+            glGetTexParameteriv(target, GL_TEXTURE_WRAP_R, &wrapR);
+        }
+        GLenum type = redType == GL_FLOAT ? GL_FLOAT : GL_UNSIGNED_BYTE;
+        // depth textures would need another read format, only their size is kept
+        bool readable = binding != 0 && redType != GL_NONE;
+        size_t faceSize = readable ? (size_t)width * height * (depth > 0 ? depth : 1) * (type == GL_FLOAT ? 16 : 4) : 0;
+        unsigned int faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+
+        op(TRACE_DEF_TEXTURE);
+        u32(name);
+        u32(target);
+        u32(internalFormat);
+        i32(width);
+        i32(height);
+        i32(depth);
+        u32(type);
+        i32(minFilter);
+        i32(magFilter);
+        i32(wrapS);
+        i32(wrapT);
+        i32(wrapR);
+        u32(faces);
+        std::vector<unsigned char> data(faceSize);
+        for (unsigned int f = 0; f < faces; f++)
+        {
+            if (faceSize > 0)
+                glGetTexImage(faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + f : target, 0, GL_RGBA, type, &data[0]);
+            bytes(faceSize > 0 ? &data[0] : NULL, faceSize);
+        }
+        if (binding)
+            originals().bindTexture(target, previous);
+    }
+
+    void defineVertexArray(GLuint name)
+    {
+        if (name == 0 || vertexArrays.count(name))
+            return;
+        vertexArrays.insert(name);
+        struct Attribute {
+            GLint index, size, type, normalized, integer, stride, buffer;
+            uint64_t offset;
+        };
+        std::vector<Attribute> attributes;
+        GLint previous = 0, elements = 0, maxAttributes = 0;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+        glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttributes);
+        originals().bindVertexArray(name);
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elements);
+        for (GLint i = 0; i < maxAttributes && i < (GLint)GL_TRACE_MAX_ATTRIBS; i++)
+        {
+            GLint enabled = 0;
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+            if (!enabled)
+                continue;
+            Attribute a;
+            a.index = i;
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_SIZE, &a.size);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_TYPE, &a.type);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &a.normalized);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &a.integer);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &a.stride);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &a.buffer);
+            void* pointer = NULL;
+            glGetVertexAttribPointerv(i, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+            a.offset = (uint64_t)(uintptr_t)pointer;
+            attributes.push_back(a);
+        }
+        originals().bindVertexArray(previous);
+        defineBuffer(elements);
+        for (unsigned int i = 0; i < attributes.size(); i++)
+            defineBuffer(attributes[i].buffer);
+        op(TRACE_DEF_VERTEX_ARRAY);
+        u32(name);
+        u32(elements);
+        u32((uint32_t)attributes.size());
+        for (unsigned int i = 0; i < attributes.size(); i++)
+        {
+            const Attribute& a = attributes[i];
+            u32(a.index);
+            i32(a.size);
+            u32(a.type);
+            u8(a.normalized ? 1 : 0);
+            u8(a.integer ? 1 : 0);
+            i32(a.stride);
+            u32(a.buffer);
+            u64(a.offset);
+        }
+    }
+
+    // a color texture and a depth (and stencil) renderbuffer, like the targets of the renderer
+    void defineFramebuffer(GLuint name)
+    {
+        if (name == 0 || framebuffers.count(name))
+            return;
+        framebuffers.insert(name);
+        GLint previousDraw = 0, previousRead = 0, colorType = GL_NONE, color = 0, depthType = GL_NONE, depth = 0;
+        GLint depthFormat = 0, depthWidth = 0, depthHeight = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+        originals().bindFramebuffer(GL_FRAMEBUFFER, name);
+        glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &colorType);
+        if (colorType == GL_TEXTURE)
+            glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &color);
+        glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &depthType);
+        if (depthType == GL_RENDERBUFFER)
+        {
+            GLint previousRenderbuffer = 0;
+            glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &depth);
+            glGetIntegerv(GL_RENDERBUFFER_BINDING, &previousRenderbuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, depth);
+            glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_INTERNAL_FORMAT, &depthFormat);
+            glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &depthWidth);
+            glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &depthHeight);
+            glBindRenderbuffer(GL_RENDERBUFFER, previousRenderbuffer);
+        }
+        originals().bindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+        originals().bindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+        defineTexture(GL_TEXTURE_2D, color);
+        op(TRACE_DEF_FRAMEBUFFER);
+        u32(name);
+        u32(color);
+        u32(depthFormat);
+        i32(depthWidth);
+        i32(depthHeight);
+    }
+
+    void defineQuery(GLuint name)
+    {
+        if (name == 0 || queries.count(name))
+            return;
+        queries.insert(name);
+        op(TRACE_DEF_QUERY);
+        u32(name);
+    }
+
+    void uniform(Trace_Uniform function, GLint location, GLsizei count, GLboolean transpose, const void* data, size_t size)
+    {
+        op(TRACE_UNIFORM);
+        u8((uint8_t)function);
+        i32(location);
+        i32(count);
+        u8(transpose);
+        bytes(data, size);
+    }
+
+    // wrappers
+    static void APIENTRY useProgram(GLuint program)
+    {
+        GLCapture* c = active();
+        c->defineProgram(program);
+        c->op(TRACE_USE_PROGRAM);
+        c->u32(program);
+        originals().useProgram(program);
+    }
+
+    static GLint APIENTRY getUniformLocation(GLuint program, const GLchar* name)
+    {
+        GLCapture* c = active();
+        GLint location = originals().getUniformLocation(program, name);
+        c->defineProgram(program);
+        c->op(TRACE_GET_UNIFORM_LOCATION);
+        c->u32(program);
+        c->text(name);
+        c->i32(location);
+        return location;
+    }
+
+    static void APIENTRY uniform1i(GLint location, GLint v0)
+    {
+        active()->uniform(TRACE_UNIFORM_1I, location, 1, GL_FALSE, &v0, sizeof(v0));
+        originals().uniform1i(location, v0);
+    }
+
+    static void APIENTRY uniform1f(GLint location, GLfloat v0)
+    {
+        active()->uniform(TRACE_UNIFORM_1F, location, 1, GL_FALSE, &v0, sizeof(v0));
+        originals().uniform1f(location, v0);
+    }
+
+    static void APIENTRY uniform2f(GLint location, GLfloat v0, GLfloat v1)
+    {
+        GLfloat v[2] = { v0, v1 };
+        active()->uniform(TRACE_UNIFORM_2F, location, 1, GL_FALSE, v, sizeof(v));
+        originals().uniform2f(location, v0, v1);
+    }
+
+    static void APIENTRY uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+    {
+        GLfloat v[3] = { v0, v1, v2 };
+        active()->uniform(TRACE_UNIFORM_3F, location, 1, GL_FALSE, v, sizeof(v));
+        originals().uniform3f(location, v0, v1, v2);
+    }
+
+    static void APIENTRY uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+    {
+        GLfloat v[4] = { v0, v1, v2, v3 };
+        active()->uniform(TRACE_UNIFORM_4F, location, 1, GL_FALSE, v, sizeof(v));
+        originals().uniform4f(location, v0, v1, v2, v3);
+    }
+
+    static void APIENTRY uniform1iv(GLint location, GLsizei count, const GLint* value)
+    {
+        active()->uniform(TRACE_UNIFORM_1IV, location, count, GL_FALSE, value, count * sizeof(GLint));
+        originals().uniform1iv(location, count, value);
+    }
+
+    static void APIENTRY uniform1fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        active()->uniform(TRACE_UNIFORM_1FV, location, count, GL_FALSE, value, count * sizeof(GLfloat));
+        originals().uniform1fv(location, count, value);
+    }
+
+    static void APIENTRY uniform2fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        active()->uniform(TRACE_UNIFORM_2FV, location, count, GL_FALSE, value, count * 2 * sizeof(GLfloat));
+        originals().uniform2fv(location, count, value);
+    }
+
+    static void APIENTRY uniform3fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        active()->uniform(TRACE_UNIFORM_3FV, location, count, GL_FALSE, value, count * 3 * sizeof(GLfloat));
+        originals().uniform3fv(location, count, value);
+    }
+
+    static void APIENTRY uniform4fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        active()->uniform(TRACE_UNIFORM_4FV, location, count, GL_FALSE, value, count * 4 * sizeof(GLfloat));
+        originals().uniform4fv(location, count, value);
+    }
+
+    static void APIENTRY uniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        active()->uniform(TRACE_UNIFORM_MATRIX_2FV, location, count, transpose, value, count * 4 * sizeof(GLfloat));
+        originals().uniformMatrix2fv(location, count, transpose, value);
+    }
+
+    static void APIENTRY uniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        active()->uniform(TRACE_UNIFORM_MATRIX_3FV, location, count, transpose, value, count * 9 * sizeof(GLfloat));
+        originals().uniformMatrix3fv(location, count, transpose, value);
+    }
+
+    static void APIENTRY uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        active()->uniform(TRACE_UNIFORM_MATRIX_4FV, location, count, transpose, value, count * 16 * sizeof(GLfloat));
+        originals().uniformMatrix4fv(location, count, transpose, value);
+    }
+
+    static void APIENTRY activeTexture(GLenum texture)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_ACTIVE_TEXTURE);
+        c->u32(texture);
+        originals().activeTexture(texture);
+    }
+
+    static void APIENTRY bindTexture(GLenum target, GLuint texture)
+    {
+        GLCapture* c = active();
+        c->defineTexture(target, texture);
+        c->op(TRACE_BIND_TEXTURE);
+        c->u32(target);
+        c->u32(texture);
+        originals().bindTexture(target, texture);
+    }
+
+    static void APIENTRY bindVertexArray(GLuint array)
+    {
+        GLCapture* c = active();
+        c->defineVertexArray(array);
+        c->op(TRACE_BIND_VERTEX_ARRAY);
+        c->u32(array);
+        originals().bindVertexArray(array);
+    }
+
+    static void APIENTRY bindBuffer(GLenum target, GLuint buffer)
+    {
+        GLCapture* c = active();
+        c->defineBuffer(buffer);
+        c->op(TRACE_BIND_BUFFER);
+        c->u32(target);
+        c->u32(buffer);
+        originals().bindBuffer(target, buffer);
+    }
+
+    // the range was written through a mapping, its contents go in the trace before the bind
+    static void APIENTRY bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        GLCapture* c = active();
+        c->defineBuffer(buffer);
+        if (buffer != 0 && size > 0)
+        {
+            GLint previous = 0;
+            std::vector<unsigned char> data(size);
+            glGetIntegerv(GL_COPY_READ_BUFFER_BINDING, &previous);
+            originals().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, offset, size, &data[0]);
+            originals().bindBuffer(GL_COPY_READ_BUFFER, previous);
+            c->op(TRACE_BUFFER_SUB_DATA);
+            c->u32(GL_COPY_WRITE_BUFFER);
+            c->u32(buffer);
+            c->u64(offset);
+            c->bytes(&data[0], data.size());
+        }
+        c->op(TRACE_BIND_BUFFER_RANGE);
+        c->u32(target);
+        c->u32(index);
+        c->u32(buffer);
+        c->u64(offset);
+        c->u64(size);
+        originals().bindBufferRange(target, index, buffer, offset, size);
+    }
+
+    static GLuint boundBuffer(GLenum target)
+    {
+        GLenum binding = target == GL_ARRAY_BUFFER ? GL_ARRAY_BUFFER_BINDING : target == GL_ELEMENT_ARRAY_BUFFER
+            ? GL_ELEMENT_ARRAY_BUFFER_BINDING : target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_BINDING
+            : target == GL_COPY_WRITE_BUFFER ? GL_COPY_WRITE_BUFFER_BINDING : GL_COPY_READ_BUFFER_BINDING;
+        GLint name = 0;
+        glGetIntegerv(binding, &name);
+        return (GLuint)name;
+    }
+
+    // recorded with the buffer bound to target, which the replayer binds to GL_COPY_WRITE_BUFFER
+    static void APIENTRY bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        GLCapture* c = active();
+        GLuint buffer = boundBuffer(target);
+        c->defineBuffer(buffer);
+        c->op(TRACE_BUFFER_DATA);
+        c->u32(buffer);
+        c->u64(size);
+        c->u32(usage);
+        c->bytes(data, data ? size : 0);
+        originals().bufferData(target, size, data, usage);
+    }
+
+    static void APIENTRY bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        GLCapture* c = active();
+        GLuint buffer = boundBuffer(target);
+        c->defineBuffer(buffer);
+        c->op(TRACE_BUFFER_SUB_DATA);
+        c->u32(GL_COPY_WRITE_BUFFER);
+        c->u32(buffer);
+        c->u64(offset);
+        c->bytes(data, size);
+        originals().bufferSubData(target, offset, size, data);
+    }
+
+    static void APIENTRY bindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        GLCapture* c = active();
+        c->defineFramebuffer(framebuffer);
+        c->op(TRACE_BIND_FRAMEBUFFER);
+        c->u32(target);
+        c->u32(framebuffer);
+        originals().bindFramebuffer(target, framebuffer);
+    }
+
+    static void APIENTRY viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_VIEWPORT);
+        c->i32(x);
+        c->i32(y);
+        c->i32(width);
+        c->i32(height);
+        originals().viewport(x, y, width, height);
+    }
+
+    static void APIENTRY clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_CLEAR_COLOR);
+        c->f32(red);
+        c->f32(green);
+        c->f32(blue);
+        c->f32(alpha);
+        originals().clearColor(red, green, blue, alpha);
+    }
+
+    static void APIENTRY clear(GLbitfield mask)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_CLEAR);
+        c->u32(mask);
+        originals().clear(mask);
+    }
+
+    static void APIENTRY enable(GLenum cap)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_ENABLE);
+        c->u32(cap);
+        originals().enable(cap);
+    }
+
+    static void APIENTRY disable(GLenum cap)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_DISABLE);
+        c->u32(cap);
+        originals().disable(cap);
+    }
+
+    static void APIENTRY depthFunc(GLenum func)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_DEPTH_FUNC);
+        c->u32(func);
+        originals().depthFunc(func);
+    }
+
+    static void APIENTRY depthMask(GLboolean flag)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_DEPTH_MASK);
+        c->u8(flag);
+        originals().depthMask(flag);
+    }
+
+    static void APIENTRY colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_COLOR_MASK);
+        c->u8(red);
+        c->u8(green);
+        c->u8(blue);
+        c->u8(alpha);
+        originals().colorMask(red, green, blue, alpha);
+    }
+
+    static void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_DRAW_ARRAYS);
+        c->u32(mode);
+        c->i32(first);
+        c->i32(count);
+        originals().drawArrays(mode, first, count);
+    }
+
+    // indices is an offset in the element buffer of the vertex array
+    static void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_DRAW_ELEMENTS);
+        c->u32(mode);
+        c->i32(count);
+        c->u32(type);
+        c->u64((uint64_t)(uintptr_t)indices);
+        originals().drawElements(mode, count, type, indices);
+    }
+
+    static void APIENTRY beginQuery(GLenum target, GLuint id)
+    {
+        GLCapture* c = active();
+        c->defineQuery(id);
+        c->op(TRACE_BEGIN_QUERY);
+        c->u32(target);
+        c->u32(id);
+        originals().beginQuery(target, id);
+    }
+
+    static void APIENTRY endQuery(GLenum target)
+    {
+        GLCapture* c = active();
+        c->op(TRACE_END_QUERY);
+        c->u32(target);
+        originals().endQuery(target);
+    }
+
+    static void APIENTRY queryCounter(GLuint id, GLenum target)
+    {
+        GLCapture* c = active();
+        c->defineQuery(id);
+        c->op(TRACE_QUERY_COUNTER);
+        c->u32(id);
+        c->u32(target);
+        originals().queryCounter(id, target);
+    }
+
+    static void APIENTRY beginConditionalRender(GLuint id, GLenum mode)
+    {
+        GLCapture* c = active();
+        c->defineQuery(id);
+        c->op(TRACE_BEGIN_CONDITIONAL_RENDER);
+        c->u32(id);
+        c->u32(mode);
+        originals().beginConditionalRender(id, mode);
+    }
+
+    static void APIENTRY endConditionalRender()
+    {
+        GLCapture* c = active();
+        c->op(TRACE_END_CONDITIONAL_RENDER);
+        originals().endConditionalRender();
+    }
+};
+#endif
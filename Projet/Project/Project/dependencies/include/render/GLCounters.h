@@ -0,0 +1,345 @@
+#ifndef GL_COUNTERS_H
+#define GL_COUNTERS_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <algorithm>
+
+// GL calls of one frame, by kind
+struct GLCallCounts {
+    unsigned long long draws;
+    unsigned long long vertices;      // vertices or indices submitted by the draws
+    unsigned long long programs;      // glUseProgram
+    unsigned long long textures;      // glBindTexture
+    unsigned long long vertexArrays;  // glBindVertexArray
+    unsigned long long buffers;       // glBindBuffer, glBindBufferRange
+    unsigned long long uniforms;      // glUniform*
+    unsigned long long lookups;       // glGetUniformLocation, a string search in the driver
+    unsigned long long states;        // glEnable, glDisable, depth and color masks, depth function
+    unsigned long long queries;       // glBeginQuery, glQueryCounter
+};
+
+// Counts the GL calls of the frames by replacing the glad function pointers with counting wrappers that call the
+// real functions. Only the thread that owns the context makes GL calls, the counters need no lock.
+// install() after gladLoadGLLoader, uninstall() before the context is destroyed.
+class GLCounters
+{
+public:
+    GLCounters() : frames(0), installed(false)
+    {
+        clear(current);
+        clear(total);
+        clear(peak);
+    }
+
+    void install()
+    {
+        if (installed)
+            return;
+        Originals& o = originals();
+        o.drawArrays = glad_glDrawArrays;
+        o.drawElements = glad_glDrawElements;
+        o.useProgram = glad_glUseProgram;
+        o.bindTexture = glad_glBindTexture;
+        o.bindVertexArray = glad_glBindVertexArray;
+        o.bindBuffer = glad_glBindBuffer;
+        o.bindBufferRange = glad_glBindBufferRange;
+        o.uniform1i = glad_glUniform1i;
+        o.uniform1f = glad_glUniform1f;
+        o.uniform1fv = glad_glUniform1fv;
+        o.uniform1iv = glad_glUniform1iv;
+        o.uniform3f = glad_glUniform3f;
+        o.uniform3fv = glad_glUniform3fv;
+        o.uniform4fv = glad_glUniform4fv;
+        o.uniformMatrix4fv = glad_glUniformMatrix4fv;
+        o.getUniformLocation = glad_glGetUniformLocation;
+        o.enable = glad_glEnable;
+        o.disable = glad_glDisable;
+        o.depthFunc = glad_glDepthFunc;
+        o.depthMask = glad_glDepthMask;
+        o.colorMask = glad_glColorMask;
+        o.beginQuery = glad_glBeginQuery;
+        o.queryCounter = glad_glQueryCounter;
+
+        glad_glDrawArrays = drawArrays;
+        glad_glDrawElements = drawElements;
+        glad_glUseProgram = useProgram;
+        glad_glBindTexture = bindTexture;
+        glad_glBindVertexArray = bindVertexArray;
+        glad_glBindBuffer = bindBuffer;
+        glad_glBindBufferRange = bindBufferRange;
+        glad_glUniform1i = uniform1i;
+        glad_glUniform1f = uniform1f;
+        glad_glUniform1fv = uniform1fv;
+        glad_glUniform1iv = uniform1iv;
+        glad_glUniform3f = uniform3f;
+        glad_glUniform3fv = uniform3fv;
+        glad_glUniform4fv = uniform4fv;
+        glad_glUniformMatrix4fv = uniformMatrix4fv;
+        glad_glGetUniformLocation = getUniformLocation;
+        glad_glEnable = enable;
+        glad_glDisable = disable;
+        glad_glDepthFunc = depthFunc;
+        glad_glDepthMask = depthMask;
+        glad_glColorMask = colorMask;
+        glad_glBeginQuery = beginQuery;
+        glad_glQueryCounter = queryCounter;
+        active() = &current;
+        installed = true;
+    }
+
+    void uninstall()
+    {
+        if (!installed)
+            return;
+        Originals& o = originals();
+        glad_glDrawArrays = o.drawArrays;
+        glad_glDrawElements = o.drawElements;
+        glad_glUseProgram = o.useProgram;
+        glad_glBindTexture = o.bindTexture;
+        glad_glBindVertexArray = o.bindVertexArray;
+        glad_glBindBuffer = o.bindBuffer;
+        glad_glBindBufferRange = o.bindBufferRange;
+        glad_glUniform1i = o.uniform1i;
+        glad_glUniform1f = o.uniform1f;
+        glad_glUniform1fv = o.uniform1fv;
+        glad_glUniform1iv = o.uniform1iv;
+        glad_glUniform3f = o.uniform3f;
+        glad_glUniform3fv = o.uniform3fv;
+        glad_glUniform4fv = o.uniform4fv;
+        glad_glUniformMatrix4fv = o.uniformMatrix4fv;
+        glad_glGetUniformLocation = o.getUniformLocation;
+        glad_glEnable = o.enable;
+        glad_glDisable = o.disable;
+        glad_glDepthFunc = o.depthFunc;
+        glad_glDepthMask = o.depthMask;
+        glad_glColorMask = o.colorMask;
+        glad_glBeginQuery = o.beginQuery;
+        glad_glQueryCounter = o.queryCounter;
+        active() = NULL;
+        installed = false;
+    }
+
+    // adds the calls since the last call to the totals
+    void endFrame()
+    {
+        unsigned long long* c = (unsigned long long*)&current;
+        unsigned long long* t = (unsigned long long*)&total;
+        unsigned long long* p = (unsigned long long*)&peak;
+        for (unsigned int i = 0; i < FIELDS; i++)
+        {
+            t[i] += c[i];
+            p[i] = std::max(p[i], c[i]);
+        }
+        clear(current);
+        frames++;
+    }
+
+    // average and most calls per frame
+    void report() const
+    {
+        if (frames == 0)
+            return;
+        static const char* names[FIELDS] = { "draws", "vertices", "programs", "textures", "vertex arrays", "buffers",
+            "uniforms", "uniform lookups", "states", "queries" };
+        const unsigned long long* t = (const unsigned long long*)&total;
+        const unsigned long long* p = (const unsigned long long*)&peak;
+        std::cout << "GL calls per frame over " << frames << " frames: average, max" << std::endl;
+        for (unsigned int i = 0; i < FIELDS; i++)
+            std::cout << "  " << names[i] << ": " << (double)t[i] / frames << ", " << p[i] << std::endl;
+    }
+
+private:
+    static const unsigned int FIELDS = sizeof(GLCallCounts) / sizeof(unsigned long long);
+
+    struct Originals {
+        PFNGLDRAWARRAYSPROC drawArrays;
+        PFNGLDRAWELEMENTSPROC drawElements;
+        PFNGLUSEPROGRAMPROC useProgram;
+        PFNGLBINDTEXTUREPROC bindTexture;
+        PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+        PFNGLBINDBUFFERPROC bindBuffer;
+        PFNGLBINDBUFFERRANGEPROC bindBufferRange;
+        PFNGLUNIFORM1IPROC uniform1i;
+        PFNGLUNIFORM1FPROC uniform1f;
+        PFNGLUNIFORM1FVPROC uniform1fv;
+        PFNGLUNIFORM1IVPROC uniform1iv;
+        PFNGLUNIFORM3FPROC uniform3f;
+        PFNGLUNIFORM3FVPROC uniform3fv;
+        PFNGLUNIFORM4FVPROC uniform4fv;
+        PFNGLUNIFORMMATRIX4FVPROC uniformMatrix4fv;
+        PFNGLGETUNIFORMLOCATIONPROC getUniformLocation;
+        PFNGLENABLEPROC enable;
+        PFNGLDISABLEPROC disable;
+        PFNGLDEPTHFUNCPROC depthFunc;
+        PFNGLDEPTHMASKPROC depthMask;
+        PFNGLCOLORMASKPROC colorMask;
+        PFNGLBEGINQUERYPROC beginQuery;
+        PFNGLQUERYCOUNTERPROC queryCounter;
+    };
+
+    GLCallCounts current, total, peak;
+    unsigned long long frames;
+    bool installed;
+
+    static void clear(GLCallCounts& counts)
+    {
+        unsigned long long* c = (unsigned long long*)&counts;
+        for (unsigned int i = 0; i < FIELDS; i++)
+            c[i] = 0;
+    }
+
+    static Originals& originals()
+    {
+        static Originals o;
+        return o;
+    }
+
+    static GLCallCounts*& active()
+    {
+        static GLCallCounts* counts = NULL;
+        return counts;
+    }
+
+    static void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        active()->draws++;
+        active()->vertices += count;
+        originals().drawArrays(mode, first, count);
+    }
+
+    static void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        active()->draws++;
+        active()->vertices += count;
+        originals().drawElements(mode, count, type, indices);
+    }
+
+    static void APIENTRY useProgram(GLuint program)
+    {
+        active()->programs++;
+        originals().useProgram(program);
+    }
+
+    static void APIENTRY bindTexture(GLenum target, GLuint texture)
+    {
+        active()->textures++;
+        originals().bindTexture(target, texture);
+    }
+
+    static void APIENTRY bindVertexArray(GLuint array)
+    {
+        active()->vertexArrays++;
+        originals().bindVertexArray(array);
+    }
+
+    static void APIENTRY bindBuffer(GLenum target, GLuint buffer)
+    {
+        active()->buffers++;
+        originals().bindBuffer(target, buffer);
+    }
+
+    static void APIENTRY bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        active()->buffers++;
+        originals().bindBufferRange(target, index, buffer, offset, size);
+    }
+
+    static void APIENTRY uniform1i(GLint location, GLint v0)
+    {
+        active()->uniforms++;
+        originals().uniform1i(location, v0);
+    }
+
+    static void APIENTRY uniform1f(GLint location, GLfloat v0)
+    {
+        active()->uniforms++;
+        originals().uniform1f(location, v0);
+    }
+
+    static void APIENTRY uniform1fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        active()->uniforms++;
+        originals().uniform1fv(location, count, value);
+    }
+
+    static void APIENTRY uniform1iv(GLint location, GLsizei count, const GLint* value)
+    {
+        active()->uniforms++;
+        originals().uniform1iv(location, count, value);
+    }
+
+    static void APIENTRY uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+    {
+        active()->uniforms++;
+        originals().uniform3f(location, v0, v1, v2);
+    }
+
+    static void APIENTRY uniform3fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        active()->uniforms++;
+        originals().uniform3fv(location, count, value);
+    }
+
+    static void APIENTRY uniform4fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        active()->uniforms++;
+        originals().uniform4fv(location, count, value);
+    }
+
+    static void APIENTRY uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        active()->uniforms++;
+        originals().uniformMatrix4fv(location, count, transpose, value);
+    }
+
+    static GLint APIENTRY getUniformLocation(GLuint program, const GLchar* name)
+    {
+        active()->lookups++;
+        return originals().getUniformLocation(program, name);
+    }
+
+    static void APIENTRY enable(GLenum cap)
+    {
+        active()->states++;
+        originals().enable(cap);
+    }
+
+    static void APIENTRY disable(GLenum cap)
+    {
+        active()->states++;
+        originals().disable(cap);
+    }
+
+    static void APIENTRY depthFunc(GLenum func)
+    {
+        active()->states++;
+        originals().depthFunc(func);
+    }
+
+    static void APIENTRY depthMask(GLboolean flag)
+    {
+        active()->states++;
+        originals().depthMask(flag);
+    }
+
+    static void APIENTRY colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+    {
+        active()->states++;
+        originals().colorMask(red, green, blue, alpha);
+    }
+
+    static void APIENTRY beginQuery(GLenum target, GLuint id)
+    {
+        active()->queries++;
+        originals().beginQuery(target, id);
+    }
+
+    static void APIENTRY queryCounter(GLuint id, GLenum target)
+    {
+        active()->queries++;
+        originals().queryCounter(id, target);
+    }
+};
+#endif
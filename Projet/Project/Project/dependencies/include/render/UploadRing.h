@@ -0,0 +1,195 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+// frames the GPU can be behind the writes, each has its own region of the buffer
+const unsigned int UPLOAD_RING_FRAMES = 3;
+// bytes of a region, what the uploads of one frame can use at most
+const size_t UPLOAD_RING_FRAME_SIZE = 256 * 1024;
+
+// part of the ring holding one upload, size is 0 when the region of the frame was full
+struct UploadRange {
+    void* data;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+// Ring buffer for the data the CPU writes every frame for the GPU (per frame and per draw uniform blocks).
+// The buffer has one region per frame in flight; a frame writes its data in its region, then binds the parts with
+// glBindBufferRange, and a fence after its last draw tells when the GPU is done with the region so it can be reused
+// three frames later. With GL 4.4 or GL_ARB_buffer_storage the buffer is mapped once, persistent and coherent, and
+// the writes go straight to the memory the GPU reads. On GL 3.3 the region of the frame is mapped with
+// GL_MAP_UNSYNCHRONIZED_BIT, the fences already ensure the GPU no longer reads it, and must be unmapped before the
+// draws, so all the writes of a frame come before its draws.
+class UploadRing
+{
+public:
+    UploadRing() : target(GL_UNIFORM_BUFFER), buffer(0), frameSize(0), alignment(256), persistent(false), mapped(NULL),
+        region(0), used(0), peak(0), stalls(0), overflows(0)
+    {
+        for (unsigned int i = 0; i < UPLOAD_RING_FRAMES; i++)
+            fences[i] = 0;
+    }
+
+    // needs a current GL context, the thread that renders
+    void init(GLenum _target = GL_UNIFORM_BUFFER, size_t _frameSize = UPLOAD_RING_FRAME_SIZE)
+    {
+        target = _target;
+        GLint offsetAlignment = 0;
+        glGetIntegerv(target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT : GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        alignment = std::max(16, (int)offsetAlignment);
+        frameSize = (_frameSize + alignment - 1) / alignment * alignment;
+        GLsizeiptr total = (GLsizeiptr)(frameSize * UPLOAD_RING_FRAMES);
+
+        // glad only loads glBufferStorage for GL 4.4, the extension gives it on older versions
+        if (!glad_glBufferStorage && glfwExtensionSupported("GL_ARB_buffer_storage"))
+            glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+        persistent = glad_glBufferStorage != NULL;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, total, NULL, flags);
+            mapped = (char*)glMapBufferRange(target, 0, total, flags);
+            if (!mapped)
+            {
+                std::cout << "ERROR::UPLOAD_RING:: Persistent mapping failed, mapping every frame instead" << std::endl;
+                glDeleteBuffers(1, &buffer);
+                glGenBuffers(1, &buffer);
+                glBindBuffer(target, buffer);
+                persistent = false;
+            }
+        }
+        if (!persistent)
+            glBufferData(target, total, NULL, GL_STREAM_DRAW);
+        glBindBuffer(target, 0);
+    }
+
+    // before the GL context is destroyed
+    void release()
+    {
+        for (unsigned int i = 0; i < UPLOAD_RING_FRAMES; i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        if (!buffer)
+            return;
+        if (mapped)
+        {
+            glBindBuffer(target, buffer);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        mapped = NULL;
+    }
+
+    // moves to the region of the next frame, waiting for the GPU to be done with it
+    void beginFrame()
+    {
+        region = (region + 1) % UPLOAD_RING_FRAMES;
+        used = 0;
+        if (fences[region])
+        {
+            GLenum status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+            {
+                stalls++;
+                while (status == GL_TIMEOUT_EXPIRED)
+                    status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+        if (!persistent)
+        {
+            glBindBuffer(target, buffer);
+            char* regionData = (char*)glMapBufferRange(target, region * frameSize, frameSize,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            mapped = regionData ? regionData - region * frameSize : NULL;
+            glBindBuffer(target, 0);
+        }
+    }
+
+    // room for size bytes in the region of the frame
+    UploadRange allocate(size_t size)
+    {
+        UploadRange range = { NULL, 0, 0 };
+        size_t aligned = (used + alignment - 1) / alignment * alignment;
+        if (aligned + size > frameSize || !mapped)
+        {
+            overflows++;
+            return range;
+        }
+        used = aligned + size;
+        peak = std::max(peak, used);
+        range.offset = (GLintptr)(region * frameSize + aligned);
+        range.data = mapped + range.offset;
+        range.size = (GLsizeiptr)size;
+        return range;
+    }
+
+    UploadRange push(const void* data, size_t size)
+    {
+        UploadRange range = allocate(size);
+        if (range.data)
+            std::memcpy(range.data, data, size);
+        return range;
+    }
+
+    // after the writes of the frame, before its draws
+    void endWrites()
+    {
+        if (persistent || !mapped)
+            return;
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        glBindBuffer(target, 0);
+        mapped = NULL;
+    }
+
+    void bind(GLuint index, const UploadRange& range)
+    {
+        if (range.size > 0)
+            glBindBufferRange(target, index, buffer, range.offset, range.size);
+    }
+
+    // after the last draw reading the region of the frame
+    void endFrame()
+    {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void report() const
+    {
+        std::cout << "Upload ring (" << (persistent ? "persistent mapping" : "mapped every frame") << "): peak " << peak
+            << " of " << frameSize << " bytes per frame, " << stalls << " waits for the GPU";
+        if (overflows > 0)
+            std::cout << ", " << overflows << " uploads did not fit";
+        std::cout << std::endl;
+    }
+
+private:
+    GLenum target;
+    GLuint buffer;
+    size_t frameSize;
+    size_t alignment;
+    bool persistent;
+    char* mapped; // start of the buffer, as if it were all mapped
+    GLsync fences[UPLOAD_RING_FRAMES];
+    unsigned int region;
+    size_t used, peak;
+    unsigned int stalls, overflows;
+};
+#endif
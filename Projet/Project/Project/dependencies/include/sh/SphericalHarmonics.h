@@ -0,0 +1,206 @@
+#ifndef SPHERICAL_HARMONICS_H
+#define SPHERICAL_HARMONICS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <shader/shader_s.h>
+#include <jobs/JobSystem.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+const float SH_PI = 3.14159265f;
+const int SH_FILE_VERSION = 1;
+
+// 9 coefficient (order 2) spherical harmonics of a cubemap, already convolved with the clamped cosine lobe,
+// divided by pi and premultiplied by the basis constants: the diffuse ambient of a normal n is
+// c0 + c1 y + c2 z + c3 x + c4 xy + c5 yz + c6 (3z^2 - 1) + c7 xz + c8 (x^2 - y^2)
+struct SH9 {
+    glm::vec3 coeffs[9];
+
+    SH9()
+    {
+        for (int i = 0; i < 9; i++)
+            coeffs[i] = glm::vec3(0.0f);
+    }
+
+    glm::vec3 evaluate(glm::vec3 n) const
+    {
+        return coeffs[0] + coeffs[1] * n.y + coeffs[2] * n.z + coeffs[3] * n.x
+            + coeffs[4] * (n.x * n.y) + coeffs[5] * (n.y * n.z) + coeffs[6] * (3.0f * n.z * n.z - 1.0f)
+            + coeffs[7] * (n.x * n.z) + coeffs[8] * (n.x * n.x - n.y * n.y);
+    }
+
+    void upload(const Shader& shader, const char* name) const
+    {
+        glUniform3fv(glGetUniformLocation(shader.ID, name), 9, &coeffs[0][0]);
+    }
+};
+
+// Face of a cubemap as loaded by stb_image, in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+struct SHFace {
+    const unsigned char* data;
+    int width, height, channels;
+};
+
+class SphericalHarmonics
+{
+public:
+    // projects the six faces, each face is reduced by several jobs that only share the final sum
+    static SH9 project(const SHFace faces[6])
+    {
+        // 9 basis functions x 3 channels, plus the total solid angle for normalisation
+        double sums[28] = { 0.0 };
+        JobSystem& jobs = JobSystem::instance();
+        for (int face = 0; face < 6; face++)
+        {
+            if (!faces[face].data)
+                continue;
+            // one partial sum per job, added in order so the result does not depend on the scheduling
+            unsigned int rows = faces[face].height;
+            unsigned int chunk = std::max(1u, (rows + jobs.workerCount()) / (jobs.workerCount() + 1));
+            std::vector<std::vector<double> > partials((rows + chunk - 1) / chunk);
+            const SHFace& f = faces[face];
+            jobs.parallelFor(rows, chunk, [&f, face, chunk, &partials](unsigned int begin, unsigned int end) {
+                partials[begin / chunk] = projectRows(f, face, (int)begin, (int)end);
+            }, "SH projection");
+            for (unsigned int k = 0; k < partials.size(); k++)
+                for (int i = 0; i < 28; i++)
+                    sums[i] += partials[k][i];
+        }
+
+        SH9 sh;
+        if (sums[27] <= 0.0)
+            return sh;
+        // the faces cover the sphere exactly, renormalise the discrete solid angle to 4 pi
+        double norm = 4.0 * SH_PI / sums[27];
+        // basis constants K and cosine lobe A / pi folded together
+        const float K[9] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+        const float A[9] = { SH_PI, 2.0f * SH_PI / 3.0f, 2.0f * SH_PI / 3.0f, 2.0f * SH_PI / 3.0f,
+            SH_PI / 4.0f, SH_PI / 4.0f, SH_PI / 4.0f, SH_PI / 4.0f, SH_PI / 4.0f };
+        for (int i = 0; i < 9; i++)
+        {
+            float scale = (float)norm * K[i] * K[i] * A[i] / SH_PI;
+            sh.coeffs[i] = glm::vec3((float)sums[i * 3], (float)sums[i * 3 + 1], (float)sums[i * 3 + 2]) * scale;
+        }
+        return sh;
+    }
+
+    // coefficients are cached as text beside the faces, keyed on the face sizes
+    static bool load(const std::string& path, const std::string& key, SH9& sh)
+    {
+        std::ifstream file(path.c_str());
+        if (!file)
+            return false;
+        int version;
+        std::string fileKey;
+        file >> version >> fileKey;
+        if (!file || version != SH_FILE_VERSION || fileKey != key)
+            return false;
+        for (int i = 0; i < 9; i++)
+            file >> sh.coeffs[i].r >> sh.coeffs[i].g >> sh.coeffs[i].b;
+        return (bool)file;
+    }
+
+    static void save(const std::string& path, const std::string& key, const SH9& sh)
+    {
+        std::ofstream file(path.c_str());
+        if (!file)
+            return;
+        file << SH_FILE_VERSION << " " << key << "\n";
+        for (int i = 0; i < 9; i++)
+            file << sh.coeffs[i].r << " " << sh.coeffs[i].g << " " << sh.coeffs[i].b << "\n";
+    }
+
+    // identifies the face files: their byte size and the face resolution
+    static std::string faceKey(const std::vector<std::string>& faces, int width, int height)
+    {
+        std::string key = std::to_string(width) + "x" + std::to_string(height);
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            std::ifstream file(faces[i].c_str(), std::ios::binary | std::ios::ate);
+            key += "_" + std::to_string(file ? (long long)file.tellg() : -1ll);
+        }
+        return key;
+    }
+
+    static std::string cachePath(const std::vector<std::string>& faces)
+    {
+        std::string directory = faces.empty() ? std::string(".") : faces[0].substr(0, faces[0].find_last_of('/'));
+        return directory + "/sh9.txt";
+    }
+
+private:
+    // GL cubemap convention: direction of the texel (u, v) in [-1, 1] of a face
+    static glm::vec3 faceDirection(int face, float u, float v)
+    {
+        switch (face)
+        {
+        case 0: return glm::vec3(1.0f, -v, -u);
+        case 1: return glm::vec3(-1.0f, -v, u);
+        case 2: return glm::vec3(u, 1.0f, v);
+        case 3: return glm::vec3(u, -1.0f, -v);
+        case 4: return glm::vec3(u, -v, 1.0f);
+        default: return glm::vec3(-u, -v, -1.0f);
+        }
+    }
+
+    static std::vector<double> projectRows(SHFace f, int face, int begin, int end)
+    {
+        std::vector<double> sums(28, 0.0);
+        int w = f.width;
+        // one row is first expanded into structure-of-arrays so the accumulation loop is plain multiply-adds
+        std::vector<float> x(w), y(w), z(w), weight(w), r(w), g(w), b(w);
+        float basis[9];
+        for (int row = begin; row < end; row++)
+        {
+            float v = 2.0f * (row + 0.5f) / f.height - 1.0f;
+            for (int col = 0; col < w; col++)
+            {
+                float u = 2.0f * (col + 0.5f) / w - 1.0f;
+                glm::vec3 d = faceDirection(face, u, v);
+                float len2 = glm::dot(d, d);
+                float invLen = 1.0f / std::sqrt(len2);
+                x[col] = d.x * invLen;
+                y[col] = d.y * invLen;
+                z[col] = d.z * invLen;
+                // solid angle of the texel, up to the constant (2 / size)^2 removed by the renormalisation
+                weight[col] = invLen * invLen * invLen;
+                const unsigned char* texel = f.data + ((size_t)row * w + col) * f.channels;
+                r[col] = texel[0] / 255.0f;
+                g[col] = texel[f.channels > 1 ? 1 : 0] / 255.0f;
+                b[col] = texel[f.channels > 2 ? 2 : 0] / 255.0f;
+            }
+            float rowSums[28] = { 0.0f };
+            for (int col = 0; col < w; col++)
+            {
+                float wx = x[col], wy = y[col], wz = z[col], dw = weight[col];
+                basis[0] = 1.0f;
+                basis[1] = wy;
+                basis[2] = wz;
+                basis[3] = wx;
+                basis[4] = wx * wy;
+                basis[5] = wy * wz;
+                basis[6] = 3.0f * wz * wz - 1.0f;
+                basis[7] = wx * wz;
+                basis[8] = wx * wx - wy * wy;
+                for (int i = 0; i < 9; i++)
+                {
+                    float bw = basis[i] * dw;
+                    rowSums[i * 3] += bw * r[col];
+                    rowSums[i * 3 + 1] += bw * g[col];
+                    rowSums[i * 3 + 2] += bw * b[col];
+                }
+                rowSums[27] += dw;
+            }
+            for (int i = 0; i < 28; i++)
+                sums[i] += rowSums[i];
+        }
+        return sums;
+    }
+};
+#endif
@@ -0,0 +1,59 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <cmath>
+
+// rate of the simulation, independent of the frame rate
+const float SIMULATION_STEP = 1.0f / 60.0f;
+// a frame longer than this many steps is simulated as this many, the simulation slows down instead of spiraling
+const unsigned int SIMULATION_MAX_STEPS = 8;
+// a frame of exactly n steps may accumulate slightly less than n steps in floats
+const float SIMULATION_STEP_TOLERANCE = 1e-4f;
+
+// Fixed timestep clock (accumulator).
+// Every frame adds its real duration and runs as many whole steps as fit in the accumulated time; what is left,
+// as a fraction of a step, is how far rendering is between the last two simulated states. The simulation then
+// behaves the same at any frame rate and only touches the simulated state, so it could run on its own thread.
+class FixedTimestep
+{
+public:
+    float step;
+
+    FixedTimestep(float _step = SIMULATION_STEP, unsigned int _maxSteps = SIMULATION_MAX_STEPS)
+        : step(_step), maxSteps(_maxSteps), accumulator(0.0f), steps(0)
+    {
+    }
+
+    // adds the duration of a frame, returns the number of steps to simulate
+    unsigned int advance(float frameDelta)
+    {
+        accumulator += std::fmin(std::fmax(frameDelta, 0.0f), step * maxSteps);
+        unsigned int n = (unsigned int)std::floor(accumulator / step + SIMULATION_STEP_TOLERANCE);
+        accumulator = std::fmax(accumulator - n * step, 0.0f);
+        steps += n;
+        return n;
+    }
+
+    // position of the frame between the previous and the last step, in [0, 1)
+    float alpha() const
+    {
+        return std::fmin(accumulator / step, 1.0f);
+    }
+
+    // simulated time at the last step
+    double time() const
+    {
+        return (double)steps * step;
+    }
+
+    unsigned long long stepCount() const
+    {
+        return steps;
+    }
+
+private:
+    unsigned int maxSteps;
+    float accumulator;
+    unsigned long long steps;
+};
+#endif
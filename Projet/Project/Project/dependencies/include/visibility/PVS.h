@@ -0,0 +1,322 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <glm/glm.hpp>
+
+#include <mesh/mesh.h>
+#include <bvh/BVH.h>
+#include <lightmap/LightmapBaker.h>
+#include <jobs/JobSystem.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+
+// rays cast between a view cell and a target before it is declared hidden from that cell
+const unsigned int PVS_RAYS_PER_PAIR = 128;
+// rays stop this far before entering the target box so its own triangles never hide it
+const float PVS_RAY_EPSILON = 1e-3f;
+const uint32_t PVS_FILE_MAGIC = 0x30535650; // "PVS0"
+const uint32_t PVS_FILE_VERSION = 1;
+
+// Potentially visible set of a static level.
+// The level box is voxelized into view cells. For every cell and every target (static object or light influence
+// box) rays are cast from points of the cell to points of the target against the occluder triangles; one ray
+// that gets through is enough to mark the target visible from the cell. Each cell stores one bit per target.
+// The sets are baked once and saved zero-run compressed; at runtime the camera cell is found by dividing its
+// position by the cell size and its bitset prefilters every other culling stage.
+class PotentiallyVisibleSet
+{
+public:
+    PotentiallyVisibleSet() : cellSize(1.0f), resolution(0), words(0), bakedCells(0)
+    {
+    }
+
+    // box split into cells of size, targets outside of it are still tested from its cells
+    void setLevel(glm::vec3 min, glm::vec3 max, float size)
+    {
+        levelMin = min;
+        cellSize = size;
+        resolution = glm::max(glm::ivec3(1), glm::ivec3(glm::ceil((max - min) / size)));
+    }
+
+    void addOccluder(const BakeTriangle& triangle)
+    {
+        occluders.push_back(triangle);
+    }
+
+    // adds every triangle of an indexed mesh transformed by model
+    template <typename VertexT>
+    void addOccluderMesh(const std::vector<VertexT>& vertices, const std::vector<unsigned int>& indices, const glm::mat4& model)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            BakeTriangle t;
+            t.v0 = glm::vec3(model * glm::vec4(vertices[indices[i]].Position, 1.0f));
+            t.v1 = glm::vec3(model * glm::vec4(vertices[indices[i + 1]].Position, 1.0f));
+            t.v2 = glm::vec3(model * glm::vec4(vertices[indices[i + 2]].Position, 1.0f));
+            occluders.push_back(t);
+        }
+    }
+
+    // the unit quad of the scene (-0.5..0.5 in x and y) transformed by model
+    void addOccluderQuad(const glm::mat4& model)
+    {
+        glm::vec3 c[4];
+        for (int k = 0; k < 4; k++)
+            c[k] = glm::vec3(model * glm::vec4(k == 1 || k == 2 ? 0.5f : -0.5f, k >= 2 ? 0.5f : -0.5f, 0.0f, 1.0f));
+        BakeTriangle a = { c[0], c[1], c[2] };
+        BakeTriangle b = { c[0], c[2], c[3] };
+        occluders.push_back(a);
+        occluders.push_back(b);
+    }
+
+    // adds a target, returns its bit index
+    unsigned int addTarget(glm::vec3 min, glm::vec3 max)
+    {
+        BVHBox box = { min, max };
+        targets.push_back(box);
+        return (unsigned int)targets.size() - 1;
+    }
+
+    unsigned int addTarget(const Bounds& bounds)
+    {
+        return addTarget(bounds.min, bounds.max);
+    }
+
+    // loads the sets from cachePath when they were baked from the same level, bakes and saves them otherwise
+    void bake(const std::string& cachePath)
+    {
+        words = ((unsigned int)targets.size() + 63) / 64;
+        uint64_t key = levelKey();
+        if (load(cachePath, key))
+        {
+            std::cout << "PVS loaded from " << cachePath << std::endl;
+            return;
+        }
+        bvh.build(occluders);
+        unsigned int cells = cellCount();
+        bits.assign((size_t)cells * words, 0);
+        // cells are independent, split them across the job system
+        JobSystem::instance().parallelFor(cells, 1, [this](unsigned int begin, unsigned int end) {
+            for (unsigned int cell = begin; cell < end; cell++)
+                bakeCell(cell);
+        }, "PVS bake");
+        bakedCells = cells;
+        size_t compressed = save(cachePath, key);
+        std::cout << "PVS baked: " << resolution.x << "x" << resolution.y << "x" << resolution.z << " cells, "
+            << targets.size() << " targets, " << occluders.size() << " occluders, " << compressed << " bytes" << std::endl;
+    }
+
+    // bitset of the cell containing p, NULL outside the level or before bake()
+    const uint64_t* lookup(glm::vec3 p) const
+    {
+        if (bakedCells == 0)
+            return NULL;
+        glm::ivec3 c = glm::ivec3(glm::floor((p - levelMin) / cellSize));
+        if (glm::any(glm::lessThan(c, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(c, resolution)))
+            return NULL;
+        return &bits[(size_t)((c.z * resolution.y + c.y) * resolution.x + c.x) * words];
+    }
+
+    // a NULL set (camera outside of the level) sees everything
+    static bool isVisible(const uint64_t* set, unsigned int target)
+    {
+        return set == NULL || ((set[target >> 6] >> (target & 63)) & 1) != 0;
+    }
+
+    unsigned int cellCount() const
+    {
+        return (unsigned int)(resolution.x * resolution.y * resolution.z);
+    }
+
+    unsigned int targetCount() const
+    {
+        return (unsigned int)targets.size();
+    }
+
+private:
+    glm::vec3 levelMin;
+    float cellSize;
+    glm::ivec3 resolution;
+    unsigned int words;       // 64 bit words per cell
+    unsigned int bakedCells;
+
+    std::vector<BakeTriangle> occluders;
+    std::vector<BVHBox> targets;
+    std::vector<uint64_t> bits; // cell after cell
+    TriangleBVH bvh;
+
+    glm::vec3 cellMin(unsigned int cell) const
+    {
+        glm::ivec3 c(cell % resolution.x, (cell / resolution.x) % resolution.y, cell / (resolution.x * resolution.y));
+        return levelMin + glm::vec3(c) * cellSize;
+    }
+
+    // corners and center first so small cells and targets are covered without luck, random points after
+    static glm::vec3 samplePoint(glm::vec3 min, glm::vec3 max, unsigned int k, std::mt19937& rng)
+    {
+        if (k < 8)
+            return glm::vec3(k & 1 ? max.x : min.x, k & 2 ? max.y : min.y, k & 4 ? max.z : min.z);
+        if (k == 8)
+            return (min + max) * 0.5f;
+        std::uniform_real_distribution<float> u(0.0f, 1.0f);
+        return min + (max - min) * glm::vec3(u(rng), u(rng), u(rng));
+    }
+
+    void bakeCell(unsigned int cell)
+    {
+        glm::vec3 cmin = cellMin(cell);
+        glm::vec3 cmax = cmin + glm::vec3(cellSize);
+        // seeded by the cell so a bake does not depend on the thread count
+        std::mt19937 rng(cell * 2654435761u + 1);
+        uint64_t* out = &bits[(size_t)cell * words];
+        for (unsigned int t = 0; t < targets.size(); t++)
+        {
+            const BVHBox& target = targets[t];
+            bool overlaps = glm::all(glm::lessThanEqual(cmin, target.max)) && glm::all(glm::lessThanEqual(target.min, cmax));
+            bool seen = overlaps;
+            for (unsigned int k = 0; k < PVS_RAYS_PER_PAIR && !seen; k++)
+            {
+                // the 81 pairs of fixed points first, then random pairs
+                glm::vec3 from = samplePoint(cmin, cmax, k < 81 ? k / 9 : k, rng);
+                glm::vec3 to = samplePoint(target.min, target.max, k < 81 ? k % 9 : k, rng);
+                seen = rayReaches(from, to, target);
+            }
+            if (seen)
+                out[t >> 6] |= 1ull << (t & 63);
+        }
+    }
+
+    // true when nothing blocks the segment before it enters the target box
+    bool rayReaches(glm::vec3 from, glm::vec3 to, const BVHBox& target) const
+    {
+        glm::vec3 d = to - from;
+        float length = glm::length(d);
+        if (length < PVS_RAY_EPSILON)
+            return true;
+        glm::vec3 dir = d / length;
+        // slab test for the entry distance, a zero thickness box enters where the segment crosses it
+        float enter = 0.0f, exit = length;
+        for (int a = 0; a < 3; a++)
+        {
+            if (std::fabs(dir[a]) < 1e-8f)
+                continue;
+            float t0 = (target.min[a] - from[a]) / dir[a];
+            float t1 = (target.max[a] - from[a]) / dir[a];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+        }
+        float tMax = std::min(enter, exit) - PVS_RAY_EPSILON;
+        return tMax <= 0.0f || !bvh.occluded(from, dir, tMax);
+    }
+
+    // FNV-1a over everything the bake depends on
+    uint64_t levelKey() const
+    {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const void* data, size_t size) {
+            const unsigned char* bytes = (const unsigned char*)data;
+            for (size_t k = 0; k < size; k++)
+                h = (h ^ bytes[k]) * 1099511628211ull;
+        };
+        mix(&PVS_RAYS_PER_PAIR, sizeof(unsigned int));
+        mix(&levelMin, sizeof(glm::vec3));
+        mix(&cellSize, sizeof(float));
+        mix(&resolution, sizeof(glm::ivec3));
+        if (!targets.empty())
+            mix(targets.data(), targets.size() * sizeof(BVHBox));
+        if (!occluders.empty())
+            mix(occluders.data(), occluders.size() * sizeof(BakeTriangle));
+        return h;
+    }
+
+    // zero bytes are stored as a 0 followed by the length of the run (1 to 255), most cells see few targets
+    static void compress(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+    {
+        for (size_t i = 0; i < size; )
+        {
+            if (data[i] != 0)
+            {
+                out.push_back(data[i++]);
+                continue;
+            }
+            unsigned char run = 0;
+            while (i < size && data[i] == 0 && run < 255)
+            {
+                run++;
+                i++;
+            }
+            out.push_back(0);
+            out.push_back(run);
+        }
+    }
+
+    static bool decompress(const std::vector<unsigned char>& in, unsigned char* data, size_t size)
+    {
+        size_t o = 0;
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            if (in[i] != 0)
+            {
+                if (o >= size)
+                    return false;
+                data[o++] = in[i];
+                continue;
+            }
+            if (++i >= in.size() || o + in[i] > size)
+                return false;
+            for (unsigned char k = 0; k < in[i]; k++)
+                data[o++] = 0;
+        }
+        return o == size;
+    }
+
+    bool load(const std::string& path, uint64_t key)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file)
+            return false;
+        uint32_t header[5];
+        uint64_t fileKey;
+        file.read((char*)header, sizeof(header));
+        file.read((char*)&fileKey, sizeof(fileKey));
+        if (!file || header[0] != PVS_FILE_MAGIC || header[1] != PVS_FILE_VERSION || fileKey != key
+            || header[2] != cellCount() || header[3] != targets.size())
+            return false;
+        std::vector<unsigned char> compressed(header[4]);
+        file.read((char*)compressed.data(), compressed.size());
+        if (!file)
+            return false;
+        bits.assign((size_t)cellCount() * words, 0);
+        if (!decompress(compressed, (unsigned char*)bits.data(), bits.size() * sizeof(uint64_t)))
+            return false;
+        bakedCells = cellCount();
+        return true;
+    }
+
+    // returns the size of the compressed sets
+    size_t save(const std::string& path, uint64_t key) const
+    {
+        std::vector<unsigned char> compressed;
+        compress((const unsigned char*)bits.data(), bits.size() * sizeof(uint64_t), compressed);
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            std::cout << "PVS could not be written to " << path << std::endl;
+            return compressed.size();
+        }
+        uint32_t header[5] = { PVS_FILE_MAGIC, PVS_FILE_VERSION, cellCount(), (uint32_t)targets.size(), (uint32_t)compressed.size() };
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)&key, sizeof(key));
+        file.write((const char*)compressed.data(), compressed.size());
+        return compressed.size();
+    }
+};
+#endif
@@ -0,0 +1,280 @@
+#ifndef PORTALS_H
+#define PORTALS_H
+
+#include <glm/glm.hpp>
+
+#include <memory/FrameArena.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// recursion limit of the traversal, also bounds the cost of a frame
+const int PORTAL_MAX_DEPTH = 16;
+// a portal closer than this to the eye is crossed with the frustum unchanged
+const float PORTAL_EPSILON = 1e-3f;
+const unsigned int PORTAL_NO_CELL = 0xffffffffu;
+
+// planes of a frustum, normals pointing inside
+typedef FrameVector<glm::vec4> PortalPlanes;
+
+// a room: its box and the portals on its walls
+struct PortalCell {
+    glm::vec3 min, max;
+    std::vector<unsigned int> portals;
+};
+
+// a door between two cells, a convex polygon given as a quad
+struct Portal {
+    glm::vec3 corners[4];
+    unsigned int cells[2];
+    bool open;
+};
+
+// Cell and portal visibility.
+// Rooms are cells and doors are portals. Each frame the camera frustum starts in the cell of the camera and is
+// clipped by every open portal it sees; the planes through the eye and the edges of the clipped portal form the
+// narrower frustum the neighbor cell is entered with. Only the cells reached this way are visible, so the cost
+// of a frame depends on what can be seen, not on the size of the level.
+class PortalSystem
+{
+public:
+    PortalSystem() : cameraCell(PORTAL_NO_CELL), arena(NULL)
+    {
+    }
+
+    unsigned int addCell(glm::vec3 min, glm::vec3 max)
+    {
+        PortalCell cell;
+        cell.min = min;
+        cell.max = max;
+        cells.push_back(cell);
+        visible.push_back(0);
+        frusta.push_back(std::vector<PortalPlanes>());
+        visibleCells.reserve(cells.size());
+        return (unsigned int)cells.size() - 1;
+    }
+
+    // corners in order around the polygon
+    unsigned int addPortal(unsigned int cellA, unsigned int cellB, const glm::vec3 corners[4], bool open = true)
+    {
+        Portal portal;
+        for (int k = 0; k < 4; k++)
+            portal.corners[k] = corners[k];
+        portal.cells[0] = cellA;
+        portal.cells[1] = cellB;
+        portal.open = open;
+        unsigned int id = (unsigned int)portals.size();
+        portals.push_back(portal);
+        cells[cellA].portals.push_back(id);
+        cells[cellB].portals.push_back(id);
+        // a cell is usually reached once per portal around it, or as the cell of the camera
+        frusta[cellA].reserve(cells[cellA].portals.size() + 1);
+        frusta[cellB].reserve(cells[cellB].portals.size() + 1);
+        return id;
+    }
+
+    void setOpen(unsigned int portal, bool open)
+    {
+        portals[portal].open = open;
+    }
+
+    // cell containing p. Looks in the cell of the last call and its neighbors first, the whole level only when lost.
+    unsigned int locate(glm::vec3 p)
+    {
+        if (cameraCell != PORTAL_NO_CELL)
+        {
+            if (contains(cameraCell, p))
+                return cameraCell;
+            const std::vector<unsigned int>& around = cells[cameraCell].portals;
+            for (unsigned int k = 0; k < around.size(); k++)
+            {
+                unsigned int other = neighbor(around[k], cameraCell);
+                if (contains(other, p))
+                    return other;
+            }
+        }
+        for (unsigned int c = 0; c < cells.size(); c++)
+            if (contains(c, p))
+                return c;
+        return PORTAL_NO_CELL;
+    }
+
+    // finds the visible cells from the eye with the camera frustum planes (normals pointing inside, far plane last).
+    // With a frame arena, the clipped polygons and the frusta are allocated from it and stay valid until it is reset.
+    void update(glm::vec3 eye, const glm::vec4 frustum[6], FrameArena* frameArena = NULL)
+    {
+        arena = frameArena;
+        for (unsigned int k = 0; k < visibleCells.size(); k++)
+        {
+            visible[visibleCells[k]] = 0;
+            frusta[visibleCells[k]].clear();
+        }
+        visibleCells.clear();
+
+        cameraCell = locate(eye);
+        PortalPlanes planes(frustum, frustum + 6, FrameAllocator<glm::vec4>(arena));
+        if (cameraCell == PORTAL_NO_CELL)
+        {
+            // outside the level: every cell can be seen
+            for (unsigned int c = 0; c < cells.size(); c++)
+                markVisible(c, planes);
+            return;
+        }
+        FrameVector<unsigned int> path = FrameVector<unsigned int>(FrameAllocator<unsigned int>(arena));
+        traverse(cameraCell, eye, planes, frustum[5], path);
+    }
+
+    bool isCellVisible(unsigned int cell) const
+    {
+        return cell < visible.size() && visible[cell] != 0;
+    }
+
+    const std::vector<unsigned int>& getVisibleCells() const
+    {
+        return visibleCells;
+    }
+
+    unsigned int getCameraCell() const
+    {
+        return cameraCell;
+    }
+
+    // true when the sphere can be seen through the frusta a cell was reached with
+    bool isSphereVisible(unsigned int cell, glm::vec3 center, float radius) const
+    {
+        if (!isCellVisible(cell))
+            return false;
+        const std::vector<PortalPlanes>& list = frusta[cell];
+        for (unsigned int f = 0; f < list.size(); f++)
+        {
+            bool inside = true;
+            for (unsigned int p = 0; p < list[f].size() && inside; p++)
+                inside = glm::dot(glm::vec3(list[f][p]), center) + list[f][p].w >= -radius;
+            if (inside)
+                return true;
+        }
+        return false;
+    }
+
+    // true when the sphere overlaps a visible cell, e.g. a light that can reach what is seen
+    bool touchesVisibleCell(glm::vec3 center, float radius) const
+    {
+        for (unsigned int k = 0; k < visibleCells.size(); k++)
+        {
+            const PortalCell& cell = cells[visibleCells[k]];
+            glm::vec3 d = center - glm::clamp(center, cell.min, cell.max);
+            if (glm::dot(d, d) <= radius * radius)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    std::vector<PortalCell> cells;
+    std::vector<Portal> portals;
+    std::vector<unsigned char> visible;
+    std::vector<unsigned int> visibleCells;
+    // the frusta each visible cell was reached with this frame
+    std::vector<std::vector<PortalPlanes> > frusta;
+    unsigned int cameraCell;
+    FrameArena* arena; // of the current update, NULL for the heap
+
+    bool contains(unsigned int c, glm::vec3 p) const
+    {
+        return glm::all(glm::greaterThanEqual(p, cells[c].min)) && glm::all(glm::lessThanEqual(p, cells[c].max));
+    }
+
+    unsigned int neighbor(unsigned int portal, unsigned int cell) const
+    {
+        return portals[portal].cells[0] == cell ? portals[portal].cells[1] : portals[portal].cells[0];
+    }
+
+    void markVisible(unsigned int cell, const PortalPlanes& planes)
+    {
+        if (!visible[cell])
+        {
+            visible[cell] = 1;
+            visibleCells.push_back(cell);
+        }
+        frusta[cell].push_back(planes);
+    }
+
+    void traverse(unsigned int cell, glm::vec3 eye, const PortalPlanes& planes, glm::vec4 farPlane, FrameVector<unsigned int>& path)
+    {
+        markVisible(cell, planes);
+        if ((int)path.size() >= PORTAL_MAX_DEPTH)
+            return;
+        path.push_back(cell);
+        const std::vector<unsigned int>& around = cells[cell].portals;
+        for (unsigned int k = 0; k < around.size(); k++)
+        {
+            const Portal& portal = portals[around[k]];
+            unsigned int next = neighbor(around[k], cell);
+            if (!portal.open || std::find(path.begin(), path.end(), next) != path.end())
+                continue;
+
+            FrameVector<glm::vec3> polygon(portal.corners, portal.corners + 4, FrameAllocator<glm::vec3>(arena));
+            for (unsigned int p = 0; p < planes.size() && polygon.size() >= 3; p++)
+                polygon = clip(polygon, planes[p]);
+            if (polygon.size() < 3)
+                continue;
+
+            glm::vec3 normal = glm::normalize(glm::cross(portal.corners[1] - portal.corners[0], portal.corners[2] - portal.corners[0]));
+            float distance = glm::dot(normal, eye - portal.corners[0]);
+            if (std::fabs(distance) < PORTAL_EPSILON)
+            {
+                // standing in the doorway
+                traverse(next, eye, planes, farPlane, path);
+                continue;
+            }
+            traverse(next, eye, narrow(eye, polygon, normal, distance, farPlane), farPlane, path);
+        }
+        path.pop_back();
+    }
+
+    // frustum through the clipped portal: one plane per edge, the portal plane as near plane, the camera far plane
+    PortalPlanes narrow(glm::vec3 eye, const FrameVector<glm::vec3>& polygon, glm::vec3 normal, float distance, glm::vec4 farPlane) const
+    {
+        PortalPlanes result = PortalPlanes(FrameAllocator<glm::vec4>(arena));
+        glm::vec3 centroid(0.0f);
+        for (unsigned int i = 0; i < polygon.size(); i++)
+            centroid += polygon[i];
+        centroid /= (float)polygon.size();
+        for (unsigned int i = 0; i < polygon.size(); i++)
+        {
+            glm::vec3 a = polygon[i], b = polygon[(i + 1) % polygon.size()];
+            glm::vec3 n = glm::cross(a - eye, b - eye);
+            float length = glm::length(n);
+            if (length < 1e-8f)
+                continue;
+            n /= length;
+            if (glm::dot(n, centroid - eye) < 0.0f)
+                n = -n;
+            result.push_back(glm::vec4(n, -glm::dot(n, eye)));
+        }
+        // beyond the portal: the side away from the eye
+        glm::vec3 away = distance > 0.0f ? -normal : normal;
+        result.push_back(glm::vec4(away, -glm::dot(away, polygon[0])));
+        result.push_back(farPlane);
+        return result;
+    }
+
+    // Sutherland-Hodgman, keeps the part on the positive side of the plane
+    FrameVector<glm::vec3> clip(const FrameVector<glm::vec3>& polygon, glm::vec4 plane) const
+    {
+        FrameVector<glm::vec3> result = FrameVector<glm::vec3>(FrameAllocator<glm::vec3>(arena));
+        for (unsigned int i = 0; i < polygon.size(); i++)
+        {
+            glm::vec3 a = polygon[i], b = polygon[(i + 1) % polygon.size()];
+            float da = glm::dot(glm::vec3(plane), a) + plane.w;
+            float db = glm::dot(glm::vec3(plane), b) + plane.w;
+            if (da >= 0.0f)
+                result.push_back(a);
+            if ((da >= 0.0f) != (db >= 0.0f))
+                result.push_back(a + (b - a) * (da / (da - db)));
+        }
+        return result;
+    }
+};
+#endif
@@ -4,9 +4,14 @@ layout (location = 1) in vec3 aNormal;
 
 out vec3 Normal;
 
+// per frame, from the upload ring
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
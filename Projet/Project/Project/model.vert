@@ -5,9 +5,18 @@ layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per frame, from the upload ring
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+// per draw, from the upload ring
+layout (std140, binding = 1) uniform Object
+{
+    mat4 model;
+};
 
 void main()
 {
@@ -3,12 +3,18 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TextCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// per frame, from the upload ring
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
 void main()
 {
 	TextCoords = aPos;
-	vec4 pos = projection * view * vec4(aPos, 1.0);
+	// rotation only, the skybox follows the camera
+	vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
 	gl_Position = pos.xyww;
 }
\ No newline at end of file